@@ -1,9 +1,47 @@
 #include "DataFrame.h"
+#include "mappedColumns.h"
+#include <cmath>
+
+std::vector<column_view> make_column_views(
+  const std::vector< std::vector<double> > &featureData
+) {
+  std::vector<column_view> featureColumns;
+  featureColumns.reserve(featureData.size());
+  for (size_t j = 0; j < featureData.size(); j++) {
+    featureColumns.push_back(column_view(featureData[j]));
+  }
+  return featureColumns;
+}
+
+std::vector<column_view> make_float_column_views(
+  const std::vector<column_view> &columns,
+  std::vector< std::vector<float> > &floatData
+) {
+  floatData.assign(columns.size(), std::vector<float>());
+  std::vector<column_view> floatColumns(columns);
+  for (size_t j = 0; j < columns.size(); j++) {
+    if (columns[j].isFloat()) {
+      continue;
+    }
+    floatData[j].resize(columns[j].size());
+    for (size_t i = 0; i < columns[j].size(); i++) {
+      floatData[j][i] = (float) columns[j][i];
+    }
+    floatColumns[j] = column_view(floatData[j]);
+  }
+  return floatColumns;
+}
 
 DataFrame::DataFrame():
-  _featureData(nullptr), _outcomeData(nullptr), _rowNumbers(nullptr),
+  _featureColumns(nullptr), _featureDataOwner(nullptr),
+  _floatFeatures(nullptr), _mappedColumns(nullptr), _outcomeData(nullptr),
+  _rowNumbers(nullptr),
   _categoricalFeatureCols(nullptr), _numericalFeatureCols(nullptr),
-  _linearFeatureCols(nullptr), _numRows(0), _numColumns(0),
+  _linearFeatureCols(nullptr), _sortedRowIndex(nullptr),
+  _sortedRowIndexBuilt(nullptr), _keepSortedRowIndex(false),
+  _histogramBins(nullptr), _histogramBinLower(nullptr),
+  _histogramBinUpper(nullptr), _histogramBinsBuilt(nullptr),
+  _numRows(0), _numColumns(0),
   _featureWeights(nullptr), _featureWeightsVariables(nullptr),  _deepFeatureWeights(nullptr),
   _deepFeatureWeightsVariables(nullptr), _observationWeights(nullptr),
   _monotonicConstraints(nullptr), _groupMemberships(nullptr){}
@@ -24,9 +62,78 @@ DataFrame::DataFrame(
   std::unique_ptr< std::vector<double> > observationWeights,
   std::shared_ptr< std::vector<int> > monotonicConstraints,
   std::unique_ptr< std::vector<size_t> > groupMemberships,
-  bool monotoneAvg
+  bool monotoneAvg,
+  bool float32Features
+): DataFrame(
+    std::unique_ptr< std::vector<column_view> >(
+      new std::vector<column_view>(make_column_views(*featureData))
+    ),
+    featureData,
+    std::move(outcomeData),
+    std::move(categoricalFeatureCols),
+    std::move(linearFeatureCols),
+    numRows,
+    numColumns,
+    std::move(featureWeights),
+    std::move(featureWeightsVariables),
+    std::move(deepFeatureWeights),
+    std::move(deepFeatureWeightsVariables),
+    std::move(observationWeights),
+    std::move(monotonicConstraints),
+    std::move(groupMemberships),
+    monotoneAvg,
+    true,
+    float32Features
+) {}
+
+DataFrame::DataFrame(
+  std::unique_ptr< std::vector<column_view> > featureColumns,
+  std::shared_ptr<void> featureDataOwner,
+  std::unique_ptr< std::vector<double> > outcomeData,
+  std::unique_ptr< std::vector<size_t> > categoricalFeatureCols,
+  std::unique_ptr< std::vector<size_t> > linearFeatureCols,
+  std::size_t numRows,
+  std::size_t numColumns,
+  std::unique_ptr<std::vector<double>> featureWeights,
+  std::unique_ptr<std::vector<size_t>> featureWeightsVariables,
+  std::unique_ptr<std::vector<double>> deepFeatureWeights,
+  std::unique_ptr<std::vector<size_t>> deepFeatureWeightsVariables,
+  std::unique_ptr< std::vector<double> > observationWeights,
+  std::shared_ptr< std::vector<int> > monotonicConstraints,
+  std::unique_ptr< std::vector<size_t> > groupMemberships,
+  bool monotoneAvg,
+  bool keepSortedRowIndex,
+  bool float32Features
 ) {
-  this->_featureData = std::move(featureData);
+  this->_featureColumns = std::move(featureColumns);
+  this->_featureDataOwner = std::move(featureDataOwner);
+
+  // Compact forests read the features as floats, which halves the memory the
+  // split search streams through. The double columns are no longer held once
+  // all of them are copied.
+  if (float32Features) {
+    this->_floatFeatures = std::unique_ptr< std::vector< std::vector<float> > >(
+      new std::vector< std::vector<float> >(_featureColumns->size())
+    );
+    bool copiedAll = true;
+    for (size_t j = 0; j < _featureColumns->size(); j++) {
+      column_view& column = (*_featureColumns)[j];
+      if (column.isFloat()) {
+        copiedAll = false;
+        continue;
+      }
+      std::vector<float>& floatColumn = (*_floatFeatures)[j];
+      floatColumn.resize(column.size());
+      for (size_t i = 0; i < column.size(); i++) {
+        floatColumn[i] = (float) column[i];
+      }
+      column = column_view(floatColumn);
+    }
+    if (copiedAll) {
+      this->_featureDataOwner.reset();
+    }
+  }
+
   this->_outcomeData = std::move(outcomeData);
   this->_categoricalFeatureCols = std::move(categoricalFeatureCols);
   this->_linearFeatureCols = std::move(linearFeatureCols);
@@ -41,6 +148,21 @@ DataFrame::DataFrame(
   this->_groupMemberships = std::move(groupMemberships);
   this->_monotoneAvg = (bool) monotoneAvg;
 
+  // Build the sampling tables of the feature weights once, rather than at
+  // every node a feature set is drawn for
+  if (getfeatureWeights() && !getfeatureWeights()->empty()) {
+    this->_featureWeightsTable = feature_sampling_table(
+      getfeatureWeights()->begin(),
+      getfeatureWeights()->end()
+    );
+  }
+  if (getdeepFeatureWeights() && !getdeepFeatureWeights()->empty()) {
+    this->_deepFeatureWeightsTable = feature_sampling_table(
+      getdeepFeatureWeights()->begin(),
+      getdeepFeatureWeights()->end()
+    );
+  }
+
   // define the row numbers to be the numbers from 1 to nrow:
   std::vector<size_t> rowNumberss;
   for(size_t j=0; j<numRows; j++){
@@ -50,12 +172,19 @@ DataFrame::DataFrame(
       new std::vector<size_t>(rowNumberss));
   this->_rowNumbers = std::move(rowNumbers);
 
+  // Mark the categorical features so they can be looked up in constant time
+  this->_isCategoricalFeature.assign(numColumns, 0);
+  for (auto j : *getCatCols()) {
+    if (j < numColumns) {
+      this->_isCategoricalFeature[j] = 1;
+    }
+  }
+
   // Add numericalFeatures
   std::vector<size_t> numericalFeatureColss;
-  std::vector<size_t>* catCols = this->getCatCols();
 
   for (size_t i = 0; i < numColumns; i++) {
-    if (std::find(catCols->begin(), catCols->end(), i) == catCols->end()) {
+    if (!isCategorical(i)) {
       numericalFeatureColss.push_back(i);
     }
   }
@@ -63,6 +192,69 @@ DataFrame::DataFrame(
   std::unique_ptr< std::vector<size_t> > numericalFeatureCols (
       new std::vector<size_t>(numericalFeatureColss));
   this->_numericalFeatureCols = std::move(numericalFeatureCols);
+
+  std::unique_ptr< std::vector< std::vector<size_t> > > sortedRowIndex (
+      new std::vector< std::vector<size_t> >(numColumns));
+  std::unique_ptr< std::vector< std::vector<unsigned char> > > histogramBins (
+      new std::vector< std::vector<unsigned char> >(numColumns));
+  std::unique_ptr< std::vector< std::vector<double> > > histogramBinLower (
+      new std::vector< std::vector<double> >(numColumns));
+  std::unique_ptr< std::vector< std::vector<double> > > histogramBinUpper (
+      new std::vector< std::vector<double> >(numColumns));
+
+  // The sorted row order of the features takes as much memory as the features
+  // and the histogram bins a byte per row, so both are only built for the
+  // features the split search asks for
+  this->_keepSortedRowIndex = keepSortedRowIndex;
+  this->_sortedRowIndexBuilt = std::unique_ptr< std::once_flag[] >(
+    new std::once_flag[numColumns]
+  );
+  this->_histogramBinsBuilt = std::unique_ptr< std::once_flag[] >(
+    new std::once_flag[numColumns]
+  );
+  this->_sortedRowIndex = std::move(sortedRowIndex);
+  this->_histogramBins = std::move(histogramBins);
+  this->_histogramBinLower = std::move(histogramBinLower);
+  this->_histogramBinUpper = std::move(histogramBinUpper);
+}
+
+DataFrame::DataFrame(
+  std::shared_ptr< mappedColumns > featureColumns,
+  std::unique_ptr< std::vector<double> > outcomeData,
+  std::unique_ptr< std::vector<size_t> > categoricalFeatureCols,
+  std::unique_ptr< std::vector<size_t> > linearFeatureCols,
+  std::unique_ptr<std::vector<double>> featureWeights,
+  std::unique_ptr<std::vector<size_t>> featureWeightsVariables,
+  std::unique_ptr<std::vector<double>> deepFeatureWeights,
+  std::unique_ptr<std::vector<size_t>> deepFeatureWeightsVariables,
+  std::unique_ptr< std::vector<double> > observationWeights,
+  std::shared_ptr< std::vector<int> > monotonicConstraints,
+  std::unique_ptr< std::vector<size_t> > groupMemberships,
+  bool monotoneAvg
+): DataFrame(
+    std::unique_ptr< std::vector<column_view> >(
+      new std::vector<column_view>(featureColumns->getColumns())
+    ),
+    featureColumns,
+    std::move(outcomeData),
+    std::move(categoricalFeatureCols),
+    std::move(linearFeatureCols),
+    featureColumns->getNumRows(),
+    featureColumns->getNumColumns(),
+    std::move(featureWeights),
+    std::move(featureWeightsVariables),
+    std::move(deepFeatureWeights),
+    std::move(deepFeatureWeightsVariables),
+    std::move(observationWeights),
+    std::move(monotonicConstraints),
+    std::move(groupMemberships),
+    monotoneAvg,
+    false
+) {
+  if (getOutcomeData()->size() != getNumRows()) {
+    throw std::runtime_error("The outcome must have one value per row of the column file.");
+  }
+  this->_mappedColumns = featureColumns;
 }
 
 double DataFrame::getPoint(size_t rowIndex, size_t colIndex) {
@@ -83,7 +275,7 @@ double DataFrame::getOutcomePoint(size_t rowIndex) {
   }
 }
 
-std::vector<double>* DataFrame::getFeatureData(
+column_view* DataFrame::getFeatureData(
   size_t colIndex
 ) {
   if (colIndex < getNumColumns()) {
@@ -93,6 +285,147 @@ std::vector<double>* DataFrame::getFeatureData(
   }
 }
 
+void DataFrame::prefetchFeature(
+  size_t colIndex
+) {
+  if (_mappedColumns) {
+    _mappedColumns->prefetchColumn(colIndex);
+  }
+}
+
+void DataFrame::sortFeatureRows(
+  size_t colIndex,
+  std::vector<size_t> &order
+) {
+  // Sorts the row indices by the values of the feature. Missing values are
+  // left out of the order and ties are kept in row order.
+  column_view* featureCol = &(*getAllFeatureData())[colIndex];
+  order.clear();
+  order.reserve(getNumRows());
+  for (size_t i = 0; i < getNumRows(); i++) {
+    if (!std::isnan((*featureCol)[i])) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(
+    order.begin(),
+    order.end(),
+    [&](size_t lhs, size_t rhs) {
+      return (*featureCol)[lhs] < (*featureCol)[rhs];
+    }
+  );
+}
+
+void DataFrame::binFeature(
+  size_t colIndex
+) {
+  // Quantizes the numerical feature colIndex into at most 256 bins for
+  // histogram splitting. Each bin holds a run of consecutive sorted values and
+  // equal values never span two bins, so a feature with at most 256 distinct
+  // values gets one bin per value. For each bin we keep the smallest and
+  // largest feature value to place split values between neighboring bins.
+  // Features with missing values are not binned, nor are memory mapped
+  // features, whose bins would take a byte per row in memory.
+  const size_t maxHistogramBins = 256;
+  size_t numRows = getNumRows();
+  if (isCategorical(colIndex) || numRows == 0 || isMapped()) {
+    return;
+  }
+
+  // The sorted order is only held while the feature is binned
+  column_view* featureCol = &(*getAllFeatureData())[colIndex];
+  std::vector<size_t> order;
+  sortFeatureRows(colIndex, order);
+  if (order.size() != numRows) {
+    return;
+  }
+
+  size_t numDistinct = 1;
+  for (size_t i = 1; i < numRows; i++) {
+    if ((*featureCol)[order[i]] != (*featureCol)[order[i - 1]]) {
+      numDistinct++;
+    }
+  }
+  size_t targetBinSize = numDistinct <= maxHistogramBins ?
+    1 : (numRows + maxHistogramBins - 1) / maxHistogramBins;
+
+  std::vector<unsigned char>& bins = (*_histogramBins)[colIndex];
+  std::vector<double>& lower = (*_histogramBinLower)[colIndex];
+  std::vector<double>& upper = (*_histogramBinUpper)[colIndex];
+  bins.resize(numRows);
+
+  size_t currentBinSize = 0;
+  for (size_t i = 0; i < numRows; i++) {
+    double currentValue = (*featureCol)[order[i]];
+    if (i == 0 ||
+        (currentBinSize >= targetBinSize &&
+         currentValue != (*featureCol)[order[i - 1]])) {
+      lower.push_back(currentValue);
+      upper.push_back(currentValue);
+      currentBinSize = 0;
+    }
+    bins[order[i]] = (unsigned char) (lower.size() - 1);
+    upper.back() = currentValue;
+    currentBinSize++;
+  }
+}
+
+std::vector<size_t>* DataFrame::getSortedRowIndex(
+  size_t colIndex
+) {
+  if (colIndex < getNumColumns()) {
+    if (_keepSortedRowIndex) {
+      std::call_once(_sortedRowIndexBuilt[colIndex], [&]() {
+        if (!isCategorical(colIndex)) {
+          sortFeatureRows(colIndex, (*_sortedRowIndex)[colIndex]);
+        }
+      });
+    }
+    return &(*_sortedRowIndex)[colIndex];
+  } else {
+    throw std::runtime_error("Invalid colIndex.");
+  }
+}
+
+std::vector<unsigned char>* DataFrame::getHistogramBins(
+  size_t colIndex
+) {
+  if (colIndex < getNumColumns()) {
+    std::call_once(_histogramBinsBuilt[colIndex], [&]() {
+      binFeature(colIndex);
+    });
+    return &(*_histogramBins)[colIndex];
+  } else {
+    throw std::runtime_error("Invalid colIndex.");
+  }
+}
+
+std::vector<double>* DataFrame::getHistogramBinLower(
+  size_t colIndex
+) {
+  if (colIndex < getNumColumns()) {
+    std::call_once(_histogramBinsBuilt[colIndex], [&]() {
+      binFeature(colIndex);
+    });
+    return &(*_histogramBinLower)[colIndex];
+  } else {
+    throw std::runtime_error("Invalid colIndex.");
+  }
+}
+
+std::vector<double>* DataFrame::getHistogramBinUpper(
+  size_t colIndex
+) {
+  if (colIndex < getNumColumns()) {
+    std::call_once(_histogramBinsBuilt[colIndex], [&]() {
+      binFeature(colIndex);
+    });
+    return &(*_histogramBinUpper)[colIndex];
+  } else {
+    throw std::runtime_error("Invalid colIndex.");
+  }
+}
+
 std::vector<double> DataFrame::getLinObsData(
   size_t rowIndex
 ) {
@@ -107,6 +440,20 @@ std::vector<double> DataFrame::getLinObsData(
   }
 }
 
+void DataFrame::getLinObsData(
+  double* linObsData,
+  size_t rowIndex
+) {
+  if (rowIndex < getNumRows()) {
+    std::vector<size_t>* linCols = getLinCols();
+    for (size_t i = 0; i < linCols->size(); i++) {
+      linObsData[i] = getPoint(rowIndex, (*linCols)[i]);
+    }
+  } else {
+    throw std::runtime_error("Invalid rowIndex");
+  }
+}
+
 void DataFrame::getObservationData(
   std::vector<double> &rowData,
   size_t rowIndex
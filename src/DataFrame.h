@@ -6,6 +6,65 @@
 #include <string>
 #include <algorithm>
 #include <memory>
+#include <random>
+#include <mutex>
+
+// A non-owning view of one column of feature values. It lets the training data
+// and the observations to predict point straight at memory held elsewhere,
+// such as the numeric vectors of an R data frame, instead of copying them.
+// The values are stored either as doubles or as floats, which are widened
+// when they are read.
+struct column_view {
+  const double* values;
+  const float* floatValues;
+  size_t numValues;
+
+  column_view(): values(nullptr), floatValues(nullptr), numValues(0) {};
+
+  column_view(const double* data, size_t size):
+    values(data), floatValues(nullptr), numValues(size) {};
+
+  column_view(const float* data, size_t size):
+    values(nullptr), floatValues(data), numValues(size) {};
+
+  column_view(const std::vector<double> &column):
+    values(column.data()), floatValues(nullptr), numValues(column.size()) {};
+
+  column_view(const std::vector<float> &column):
+    values(nullptr), floatValues(column.data()), numValues(column.size()) {};
+
+  double operator[](size_t i) const {
+    return floatValues ? (double) floatValues[i] : values[i];
+  }
+
+  size_t size() const {
+    return numValues;
+  }
+
+  // Returns whether the values are stored as floats
+  bool isFloat() const {
+    return floatValues != nullptr;
+  }
+};
+
+// The cumulative probabilities of a set of feature weights, from which a
+// feature is drawn by a binary search
+typedef std::discrete_distribution<size_t>::param_type feature_sampling_table;
+
+// Returns views over the columns of featureData, which has to outlive them
+std::vector<column_view> make_column_views(
+  const std::vector< std::vector<double> > &featureData
+);
+
+// Returns views over the columns rounded to floats, as the features of compact
+// forests are. The rounded columns are kept in floatData, which has to outlive
+// the views, while the columns already held as floats are viewed directly.
+std::vector<column_view> make_float_column_views(
+  const std::vector<column_view> &columns,
+  std::vector< std::vector<float> > &floatData
+);
+
+class mappedColumns;
 
 class DataFrame {
 
@@ -27,6 +86,53 @@ public:
     std::unique_ptr< std::vector<double> > observationWeights,
     std::shared_ptr< std::vector<int> > monotonicConstraints,
     std::unique_ptr< std::vector<size_t> > groupMemberships,
+    bool monotoneAvg,
+    bool float32Features = false
+  );
+
+  // Builds the data frame over columns which are not copied. featureDataOwner
+  // keeps the memory the columns point into alive as long as the data frame.
+  // Unless keepSortedRowIndex is set, the sorted row order of the features is
+  // never kept for the split search. With float32Features the features are
+  // copied to floats once, as for compact forests, and featureDataOwner is
+  // released.
+  DataFrame(
+    std::unique_ptr< std::vector<column_view> > featureColumns,
+    std::shared_ptr<void> featureDataOwner,
+    std::unique_ptr< std::vector<double> > outcomeData,
+    std::unique_ptr< std::vector<size_t> > categoricalFeatureCols,
+    std::unique_ptr< std::vector<size_t> > linearCols,
+    std::size_t numRows,
+    std::size_t numColumns,
+    std::unique_ptr< std::vector<double> > featureWeights,
+    std::unique_ptr< std::vector<size_t> > featureWeightsVariables,
+    std::unique_ptr< std::vector<double> > deepFeatureWeights,
+    std::unique_ptr< std::vector<size_t> > deepFeatureWeightsVariables,
+    std::unique_ptr< std::vector<double> > observationWeights,
+    std::shared_ptr< std::vector<int> > monotonicConstraints,
+    std::unique_ptr< std::vector<size_t> > groupMemberships,
+    bool monotoneAvg,
+    bool keepSortedRowIndex = true,
+    bool float32Features = false
+  );
+
+  // Builds the data frame over the columns of a memory mapped column file.
+  // Neither the sorted row order of the features nor the histogram bins are
+  // kept, so the memory used grows with the number of rows but not with the
+  // number of features, and histogram splitting falls back to the exact
+  // split search.
+  DataFrame(
+    std::shared_ptr< mappedColumns > featureColumns,
+    std::unique_ptr< std::vector<double> > outcomeData,
+    std::unique_ptr< std::vector<size_t> > categoricalFeatureCols,
+    std::unique_ptr< std::vector<size_t> > linearCols,
+    std::unique_ptr< std::vector<double> > featureWeights,
+    std::unique_ptr< std::vector<size_t> > featureWeightsVariables,
+    std::unique_ptr< std::vector<double> > deepFeatureWeights,
+    std::unique_ptr< std::vector<size_t> > deepFeatureWeightsVariables,
+    std::unique_ptr< std::vector<double> > observationWeights,
+    std::shared_ptr< std::vector<int> > monotonicConstraints,
+    std::unique_ptr< std::vector<size_t> > groupMemberships,
     bool monotoneAvg
   );
 
@@ -34,10 +140,37 @@ public:
 
   double getOutcomePoint(size_t rowIndex);
 
-  std::vector<double>* getFeatureData(size_t colIndex);
+  column_view* getFeatureData(size_t colIndex);
+
+  // Starts reading the feature colIndex into memory in the background when
+  // the features are memory mapped, and does nothing otherwise
+  void prefetchFeature(size_t colIndex);
+
+  // Returns whether the features are read from a memory mapped column file
+  bool isMapped() {
+    return _mappedColumns != nullptr;
+  }
+
+  // Returns the rows without missing values of the feature colIndex sorted by
+  // its values. The order is built the first time it is asked for, and is
+  // empty for categorical features and when it is not kept.
+  std::vector<size_t>* getSortedRowIndex(size_t colIndex);
+
+  // Return the histogram bin of every row of the feature colIndex and the
+  // smallest and largest value of each bin. The bins are built the first time
+  // they are asked for, and are empty for features which are not binned and
+  // for memory mapped features.
+  std::vector<unsigned char>* getHistogramBins(size_t colIndex);
+
+  std::vector<double>* getHistogramBinLower(size_t colIndex);
+
+  std::vector<double>* getHistogramBinUpper(size_t colIndex);
 
   std::vector<double> getLinObsData(size_t rowIndex);
 
+  // Writes the linear features of rowIndex to linObsData
+  void getLinObsData(double* linObsData, size_t rowIndex);
+
   void getObservationData(std::vector<double> &rowData, size_t rowIndex);
 
   void getShuffledObservationData(std::vector<double> &rowData, size_t rowIndex,
@@ -45,8 +178,8 @@ public:
 
   double partitionMean(std::vector<size_t>* sampleIndex);
 
-  std::vector< std::vector<double> >* getAllFeatureData() {
-    return _featureData.get();
+  std::vector<column_view>* getAllFeatureData() {
+    return _featureColumns.get();
   }
 
   std::vector<double>* getOutcomeData() {
@@ -65,6 +198,11 @@ public:
     return _categoricalFeatureCols.get();
   }
 
+  // Returns whether the feature colIndex is one of the categorical features
+  bool isCategorical(size_t colIndex) {
+    return _isCategoricalFeature[colIndex] != 0;
+  }
+
   std::vector<size_t>* getNumCols() {
     return _numericalFeatureCols.get();
   }
@@ -89,6 +227,16 @@ public:
     return _deepFeatureWeightsVariables.get();
   }
 
+  // The sampling tables of the feature weights and the deep feature weights,
+  // which are built once when the data frame is created
+  const feature_sampling_table& getfeatureWeightsTable() {
+    return _featureWeightsTable;
+  }
+
+  const feature_sampling_table& getdeepFeatureWeightsTable() {
+    return _deepFeatureWeightsTable;
+  }
+
   std::vector<double>* getobservationWeights() {
     return _observationWeights.get();
   }
@@ -116,18 +264,35 @@ public:
   void setOutcomeData(std::vector<double> outcomeData);
 
 private:
-  std::shared_ptr< std::vector< std::vector<double> > > _featureData;
+  void sortFeatureRows(size_t colIndex, std::vector<size_t> &order);
+
+  void binFeature(size_t colIndex);
+
+  std::unique_ptr< std::vector<column_view> > _featureColumns;
+  std::shared_ptr<void> _featureDataOwner;
+  std::unique_ptr< std::vector< std::vector<float> > > _floatFeatures;
+  std::shared_ptr< mappedColumns > _mappedColumns;
   std::unique_ptr< std::vector<double> > _outcomeData;
   std::unique_ptr< std::vector<size_t> > _rowNumbers;
   std::unique_ptr< std::vector<size_t> > _categoricalFeatureCols;
   std::unique_ptr< std::vector<size_t> > _numericalFeatureCols;
+  std::vector<char> _isCategoricalFeature;
   std::unique_ptr< std::vector<size_t> > _linearFeatureCols;
+  std::unique_ptr< std::vector< std::vector<size_t> > > _sortedRowIndex;
+  std::unique_ptr< std::once_flag[] > _sortedRowIndexBuilt;
+  bool _keepSortedRowIndex;
+  std::unique_ptr< std::vector< std::vector<unsigned char> > > _histogramBins;
+  std::unique_ptr< std::vector< std::vector<double> > > _histogramBinLower;
+  std::unique_ptr< std::vector< std::vector<double> > > _histogramBinUpper;
+  std::unique_ptr< std::once_flag[] > _histogramBinsBuilt;
   std::size_t _numRows;
   std::size_t _numColumns;
   std::unique_ptr< std::vector<double> > _featureWeights;
   std::unique_ptr< std::vector<size_t> > _featureWeightsVariables;
   std::unique_ptr< std::vector<double> > _deepFeatureWeights;
   std::unique_ptr< std::vector<size_t> > _deepFeatureWeightsVariables;
+  feature_sampling_table _featureWeightsTable;
+  feature_sampling_table _deepFeatureWeightsTable;
   std::unique_ptr< std::vector<double> > _observationWeights;
   std::shared_ptr< std::vector<int> > _monotonicConstraints;
   std::unique_ptr< std::vector<size_t> > _groupMemberships;
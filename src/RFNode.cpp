@@ -3,12 +3,9 @@
 #include "RFNode.h"
 #include <armadillo>
 #include <RcppThread.h>
-#include <mutex>
 #include <thread>
 #include "utils.h"
 
-std::mutex mutex_weightMatrix;
-
 
 RFNode::RFNode():
   _splitFeature(0), _splitValue(0), _predictWeight(std::numeric_limits<double>::quiet_NaN()),
@@ -94,9 +91,11 @@ void RFNode::setRidgeCoefficients(
     arma::Mat<double> y(outcomePoints.size(),
                         1);
     y.col(0) = arma::conv_to<arma::Col<double> >::from(outcomePoints);
-    // Compute XtX + lambda * I * Y = C
-    arma::Mat<double> coefficients = (x.t() * x +
-                                      identity * lambda).i() * x.t() * y;
+    // Solve (XtX + lambda * I) * C = XtY
+    arma::Mat<double> coefficients = solveRidgeSystem(
+      x.t() * x + identity * lambda,
+      x.t() * y
+    );
 
     this->_ridgeCoefficients = coefficients;
 }
@@ -105,50 +104,46 @@ void RFNode::ridgePredict(
   std::vector<double> &outputPrediction,
   std::vector< std::vector<double> > &outputCoefficients,
   std::vector<size_t>* updateIndex,
-  std::vector< std::vector<double> >* xNew,
+  std::vector<column_view>* xNew,
   DataFrame* trainingData,
   double lambda
 ) {
 
-  //Number of linear features in training data
-  size_t dimension = (trainingData->getLinObsData(0)).size();
+  // The linear features of the training data, which the coefficients follow
+  std::vector<size_t>* linCols = trainingData->getLinCols();
+  size_t dimension = linCols->size();
+  size_t numRows = updateIndex->size();
   // Pull the ridge regression coefficients
-  arma::Mat<double> coefficients = getRidgeCoefficients();
-
-  //Map xNew into Eigen matrix
-  arma::Mat<double> xn(updateIndex->size(),
-                       dimension + 1);
-
-  size_t index = 0;
-  for (std::vector<size_t>::iterator it = updateIndex->begin();
-       it != updateIndex->end();
-       ++it) {
-
-    std::vector<double> newObservation;
-    for (size_t i = 0; i < dimension; i++) {
-      newObservation.push_back((*xNew)[i][*it]);
+  const arma::Mat<double> &coefficients = getRidgeCoefficients();
+
+  // Gather the linear features of the rows reaching the leaf column by column,
+  // followed by the intercept column
+  arma::Mat<double> xn(numRows, dimension + 1);
+  for (size_t j = 0; j < dimension; j++) {
+    const column_view &column = (*xNew)[(*linCols)[j]];
+    double* xnColumn = xn.colptr(j);
+    for (size_t k = 0; k < numRows; k++) {
+      xnColumn[k] = column[(*updateIndex)[k]];
     }
-    newObservation.push_back(1.0);
-
-    xn.row(index) = arma::conv_to<arma::Row<double> >::from(newObservation);
-    index++;
   }
+  xn.col(dimension).ones();
 
   // Multiply xNew * coefficients = result
   arma::Mat<double> predictions = xn * coefficients;
 
-  for (size_t i = 0; i < updateIndex->size(); i++) {
-    outputPrediction[(*updateIndex)[i]] = predictions(i, 0);
+  for (size_t k = 0; k < numRows; k++) {
+    outputPrediction[(*updateIndex)[k]] = predictions(k, 0);
   }
 
-  // Want coefficients vector
-  std::vector<double> c_vector =
-    arma::conv_to< std::vector<double> >::from(coefficients.col(0));
-
-  // If we want to update coefficients, update the vector as well
+  // If we want to update coefficients, every row of the leaf gets the leaf
+  // coefficients, copied into the space its vector already holds
   if (!(outputCoefficients.empty())) {
-    for (size_t k = 0; k < updateIndex->size(); k++) {
-      outputCoefficients[(*updateIndex)[k]] = c_vector;
+    const double* leafCoefficients = coefficients.colptr(0);
+    for (size_t k = 0; k < numRows; k++) {
+      outputCoefficients[(*updateIndex)[k]].assign(
+        leafCoefficients,
+        leafCoefficients + coefficients.n_rows
+      );
     }
   }
 }
@@ -159,9 +154,9 @@ void RFNode::predict(
   std::vector< std::vector<double> > &outputCoefficients,
   std::vector<size_t>* updateIndex,
   std::vector<size_t>* predictionAveragingIndices,
-  std::vector< std::vector<double> >* xNew,
+  std::vector<column_view>* xNew,
   DataFrame* trainingData,
-  arma::Mat<double>* weightMatrix,
+  comembership_info* comembership,
   bool linear,
   bool naDirection,
   double lambda,
@@ -203,15 +198,22 @@ void RFNode::predict(
         }
     }
 
-    if (weightMatrix){
-      // If weightMatrix is not a NULL pointer, then we want to update it,
-      // because we have choosen aggregation = "weightmatrix".
+    if (comembership){
+      // If comembership is not a NULL pointer, then we record the leaf of
+      // every observation, because we have choosen aggregation = "weightmatrix".
+      // The weight matrix rows are built from these records once all trees
+      // have predicted, so nothing here is shared between threads.
       std::vector<size_t> idx_in_leaf =
                 (*trainingData).get_all_row_idx(predictionAveragingIndices);
 
+      size_t leafPosition = comembership->leafTrainRows.size();
+      comembership->leafTrainRows.push_back(std::vector<size_t>());
+      std::vector<size_t> &leafTrainRows = comembership->leafTrainRows.back();
+      leafTrainRows.reserve(idx_in_leaf.size());
+      for (size_t i = 0; i<idx_in_leaf.size(); i++) {
+        leafTrainRows.push_back(idx_in_leaf[i] - 1);
+      }
 
-        // The following will lock the access to weightMatrix
-      std::lock_guard<std::mutex> lock(mutex_weightMatrix);
       for (
           std::vector<size_t>::iterator it = (*updateIndex).begin();
           it != (*updateIndex).end();
@@ -221,11 +223,7 @@ void RFNode::predict(
         if (OOBIndex) {
           idx = (*OOBIndex)[*it];
         }
-
-        for (size_t i = 0; i<idx_in_leaf.size(); i++) {
-          (*weightMatrix)(idx, idx_in_leaf[i] - 1) +=
-          (double) 1.0 / ((double) idx_in_leaf.size());
-        }
+        comembership->leafOfRow[idx] = leafPosition;
       }
     }
 
@@ -255,10 +253,7 @@ void RFNode::predict(
     size_t naRightCount = getNaRightCount();
 
     // Test if the splitting feature is categorical
-    std::vector<size_t> categorialCols = *(*trainingData).getCatCols();
-    bool categorical_split = (std::find(categorialCols.begin(),
-                                       categorialCols.end(),
-                                       getSplitFeature()) != categorialCols.end());
+    bool categorical_split = (*trainingData).isCategorical(getSplitFeature());
 
     // Initialize vectors of ratios in which we sample randomly to send
     // observations with NA values
@@ -393,7 +388,7 @@ void RFNode::predict(
       // If we need to return the weightmatrix, do the same thing for the training data
       std::vector<size_t>* leftPartitionAveragingIndex = nullptr;
       std::vector<size_t>* rightPartitionAveragingIndex = nullptr;
-      if (weightMatrix) {
+      if (comembership) {
 
           leftPartitionAveragingIndex = new std::vector<size_t>();
           rightPartitionAveragingIndex = new std::vector<size_t>();
@@ -492,7 +487,7 @@ void RFNode::predict(
           leftPartitionAveragingIndex,
           xNew,
           trainingData,
-          weightMatrix,
+          comembership,
           linear,
           naDirection,
           lambda,
@@ -511,7 +506,7 @@ void RFNode::predict(
           rightPartitionAveragingIndex,
           xNew,
           trainingData,
-          weightMatrix,
+          comembership,
           linear,
           naDirection,
           lambda,
@@ -523,7 +518,7 @@ void RFNode::predict(
 
     delete(leftPartitionIndex);
     delete(rightPartitionIndex);
-    if (weightMatrix) {
+    if (comembership) {
         delete(leftPartitionAveragingIndex);
         delete(rightPartitionAveragingIndex);
     }
@@ -542,10 +537,7 @@ void RFNode::getPath(
     path.push_back(currentNode->getNodeId());
     path[0]++;
     size_t splitFeature = currentNode->getSplitFeature();
-    std::vector<size_t> categorialCols = *(*trainingData).getCatCols();
-    bool categorical_split = (std::find(categorialCols.begin(),
-                                        categorialCols.end(),
-                                        splitFeature) != categorialCols.end());
+    bool categorical_split = (*trainingData).isCategorical(splitFeature);
     size_t naLeftCount = currentNode->getNaLeftCount();
     size_t naRightCount = currentNode->getNaRightCount();
 
@@ -705,3 +697,47 @@ void RFNode::write_node_info(
   }
   return;
 }
+
+size_t RFNode::write_node_table(
+    node_table &nodeTable,
+    std::vector<size_t>* categoricalCols
+){
+  // Reserve the slot of this node before the children are appended after it
+  size_t position = nodeTable.splitFeature.size();
+  nodeTable.splitFeature.push_back(-1);
+  nodeTable.splitValue.push_back(0);
+  nodeTable.rightChild.push_back(0);
+  nodeTable.categoricalSplit.push_back(0);
+  nodeTable.naDefaultDirection.push_back(0);
+  nodeTable.naLeftCount.push_back(0);
+  nodeTable.naRightCount.push_back(0);
+  nodeTable.averageCount.push_back(0);
+  nodeTable.nodeId.push_back(0);
+
+  if (is_leaf()) {
+    nodeTable.splitValue[position] = getPredictWeight();
+    nodeTable.averageCount[position] = getAverageCount();
+    nodeTable.nodeId[position] = getNodeId();
+    return getAverageCount();
+  }
+
+  nodeTable.splitFeature[position] = (int) getSplitFeature();
+  nodeTable.splitValue[position] = getSplitValue();
+  nodeTable.categoricalSplit[position] = (char) (
+    std::find(categoricalCols->begin(),
+              categoricalCols->end(),
+              getSplitFeature()) != categoricalCols->end()
+  );
+  nodeTable.naDefaultDirection[position] = getNaDefaultDirection();
+  nodeTable.naLeftCount[position] = getNaLeftCount();
+  nodeTable.naRightCount[position] = getNaRightCount();
+
+  size_t averageCount =
+    getLeftChild()->write_node_table(nodeTable, categoricalCols);
+  nodeTable.rightChild[position] = nodeTable.splitFeature.size();
+  averageCount +=
+    getRightChild()->write_node_table(nodeTable, categoricalCols);
+
+  nodeTable.averageCount[position] = averageCount;
+  return averageCount;
+}
@@ -43,7 +43,7 @@ public:
       std::vector<double> &outputPrediction,
       std::vector< std::vector<double> > &outputCoefficients,
       std::vector<size_t>* updateIndex,
-      std::vector< std::vector<double> >* xNew,
+      std::vector<column_view>* xNew,
       DataFrame* trainingData,
       double lambda
   );
@@ -54,9 +54,9 @@ public:
     std::vector< std::vector<double> > &outputCoefficients,
     std::vector<size_t>* updateIndex,
     std::vector<size_t>* predictionAveragingIndices,
-    std::vector< std::vector<double> >* xNew,
+    std::vector<column_view>* xNew,
     DataFrame* trainingData,
-    arma::Mat<double>* weightMatrix,
+    comembership_info* comembership,
     bool linear,
     bool naDirection,
     double lambda,
@@ -77,6 +77,11 @@ public:
     DataFrame* trainingData
   );
 
+  size_t write_node_table(
+    node_table &nodeTable,
+    std::vector<size_t>* categoricalCols
+  );
+
   bool is_leaf();
 
   void printSubtree(int indentSpace=0);
@@ -139,6 +144,10 @@ public:
     return _nodeId;
   }
 
+  void setNodeId(size_t nodeId) {
+    _nodeId = nodeId;
+  }
+
   std::vector<size_t>* getAveragingIndex() {
     return _averagingSampleIndex.get();
   }
@@ -151,7 +160,7 @@ public:
       return _predictWeight;
   }
 
-  arma::Mat<double> getRidgeCoefficients() {
+  const arma::Mat<double>& getRidgeCoefficients() {
       return _ridgeCoefficients;
   }
 
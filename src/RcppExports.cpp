@@ -13,8 +13,8 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // rcpp_cppDataFrameInterface
-SEXP rcpp_cppDataFrameInterface(Rcpp::List x, Rcpp::NumericVector y, Rcpp::NumericVector catCols, Rcpp::NumericVector linCols, int numRows, int numColumns, Rcpp::NumericVector featureWeights, Rcpp::NumericVector featureWeightsVariables, Rcpp::NumericVector deepFeatureWeights, Rcpp::NumericVector deepFeatureWeightsVariables, Rcpp::NumericVector observationWeights, Rcpp::NumericVector monotonicConstraints, Rcpp::NumericVector groupMemberships, bool monotoneAvg);
-RcppExport SEXP _Rforestry_rcpp_cppDataFrameInterface(SEXP xSEXP, SEXP ySEXP, SEXP catColsSEXP, SEXP linColsSEXP, SEXP numRowsSEXP, SEXP numColumnsSEXP, SEXP featureWeightsSEXP, SEXP featureWeightsVariablesSEXP, SEXP deepFeatureWeightsSEXP, SEXP deepFeatureWeightsVariablesSEXP, SEXP observationWeightsSEXP, SEXP monotonicConstraintsSEXP, SEXP groupMembershipsSEXP, SEXP monotoneAvgSEXP) {
+SEXP rcpp_cppDataFrameInterface(Rcpp::List x, Rcpp::NumericVector y, Rcpp::NumericVector catCols, Rcpp::NumericVector linCols, int numRows, int numColumns, Rcpp::NumericVector featureWeights, Rcpp::NumericVector featureWeightsVariables, Rcpp::NumericVector deepFeatureWeights, Rcpp::NumericVector deepFeatureWeightsVariables, Rcpp::NumericVector observationWeights, Rcpp::NumericVector monotonicConstraints, Rcpp::NumericVector groupMemberships, bool monotoneAvg, bool float32Features);
+RcppExport SEXP _Rforestry_rcpp_cppDataFrameInterface(SEXP xSEXP, SEXP ySEXP, SEXP catColsSEXP, SEXP linColsSEXP, SEXP numRowsSEXP, SEXP numColumnsSEXP, SEXP featureWeightsSEXP, SEXP featureWeightsVariablesSEXP, SEXP deepFeatureWeightsSEXP, SEXP deepFeatureWeightsVariablesSEXP, SEXP observationWeightsSEXP, SEXP monotonicConstraintsSEXP, SEXP groupMembershipsSEXP, SEXP monotoneAvgSEXP, SEXP float32FeaturesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -32,13 +32,59 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type monotonicConstraints(monotonicConstraintsSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type groupMemberships(groupMembershipsSEXP);
     Rcpp::traits::input_parameter< bool >::type monotoneAvg(monotoneAvgSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_cppDataFrameInterface(x, y, catCols, linCols, numRows, numColumns, featureWeights, featureWeightsVariables, deepFeatureWeights, deepFeatureWeightsVariables, observationWeights, monotonicConstraints, groupMemberships, monotoneAvg));
+    Rcpp::traits::input_parameter< bool >::type float32Features(float32FeaturesSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppDataFrameInterface(x, y, catCols, linCols, numRows, numColumns, featureWeights, featureWeightsVariables, deepFeatureWeights, deepFeatureWeightsVariables, observationWeights, monotonicConstraints, groupMemberships, monotoneAvg, float32Features));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_cppMappedDataFrameInterface
+SEXP rcpp_cppMappedDataFrameInterface(std::string filename, Rcpp::NumericVector y, Rcpp::NumericVector catCols, Rcpp::NumericVector linCols, Rcpp::NumericVector featureWeights, Rcpp::NumericVector featureWeightsVariables, Rcpp::NumericVector deepFeatureWeights, Rcpp::NumericVector deepFeatureWeightsVariables, Rcpp::NumericVector observationWeights, Rcpp::NumericVector monotonicConstraints, Rcpp::NumericVector groupMemberships, bool monotoneAvg);
+RcppExport SEXP _Rforestry_rcpp_cppMappedDataFrameInterface(SEXP filenameSEXP, SEXP ySEXP, SEXP catColsSEXP, SEXP linColsSEXP, SEXP featureWeightsSEXP, SEXP featureWeightsVariablesSEXP, SEXP deepFeatureWeightsSEXP, SEXP deepFeatureWeightsVariablesSEXP, SEXP observationWeightsSEXP, SEXP monotonicConstraintsSEXP, SEXP groupMembershipsSEXP, SEXP monotoneAvgSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type catCols(catColsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type linCols(linColsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type featureWeights(featureWeightsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type featureWeightsVariables(featureWeightsVariablesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type deepFeatureWeights(deepFeatureWeightsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type deepFeatureWeightsVariables(deepFeatureWeightsVariablesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type observationWeights(observationWeightsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type monotonicConstraints(monotonicConstraintsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type groupMemberships(groupMembershipsSEXP);
+    Rcpp::traits::input_parameter< bool >::type monotoneAvg(monotoneAvgSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppMappedDataFrameInterface(filename, y, catCols, linCols, featureWeights, featureWeightsVariables, deepFeatureWeights, deepFeatureWeightsVariables, observationWeights, monotonicConstraints, groupMemberships, monotoneAvg));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_writeColumnFileInterface
+void rcpp_writeColumnFileInterface(Rcpp::List x, std::string filename, bool float32);
+RcppExport SEXP _Rforestry_rcpp_writeColumnFileInterface(SEXP xSEXP, SEXP filenameSEXP, SEXP float32SEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< bool >::type float32(float32SEXP);
+    rcpp_writeColumnFileInterface(x, filename, float32);
+    return R_NilValue;
+END_RCPP
+}
+// rcpp_readColumnFileInterface
+Rcpp::List rcpp_readColumnFileInterface(std::string filename);
+RcppExport SEXP _Rforestry_rcpp_readColumnFileInterface(SEXP filenameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_readColumnFileInterface(filename));
     return rcpp_result_gen;
 END_RCPP
 }
 // rcpp_cppBuildInterface
-SEXP rcpp_cppBuildInterface(Rcpp::List x, Rcpp::NumericVector y, Rcpp::NumericVector catCols, Rcpp::NumericVector linCols, int numRows, int numColumns, int ntree, bool replace, int sampsize, int mtry, double splitratio, bool OOBhonest, bool doubleBootstrap, int nodesizeSpl, int nodesizeAvg, int nodesizeStrictSpl, int nodesizeStrictAvg, double minSplitGain, int maxDepth, int interactionDepth, int seed, int nthread, bool verbose, bool middleSplit, int maxObs, Rcpp::NumericVector featureWeights, Rcpp::NumericVector featureWeightsVariables, Rcpp::NumericVector deepFeatureWeights, Rcpp::NumericVector deepFeatureWeightsVariables, Rcpp::NumericVector observationWeights, Rcpp::NumericVector monotonicConstraints, Rcpp::NumericVector groupMemberships, int minTreesPerFold, int foldSize, bool monotoneAvg, bool hasNas, bool naDirection, bool linear, double overfitPenalty, bool doubleTree, bool existing_dataframe_flag, SEXP existing_dataframe);
-RcppExport SEXP _Rforestry_rcpp_cppBuildInterface(SEXP xSEXP, SEXP ySEXP, SEXP catColsSEXP, SEXP linColsSEXP, SEXP numRowsSEXP, SEXP numColumnsSEXP, SEXP ntreeSEXP, SEXP replaceSEXP, SEXP sampsizeSEXP, SEXP mtrySEXP, SEXP splitratioSEXP, SEXP OOBhonestSEXP, SEXP doubleBootstrapSEXP, SEXP nodesizeSplSEXP, SEXP nodesizeAvgSEXP, SEXP nodesizeStrictSplSEXP, SEXP nodesizeStrictAvgSEXP, SEXP minSplitGainSEXP, SEXP maxDepthSEXP, SEXP interactionDepthSEXP, SEXP seedSEXP, SEXP nthreadSEXP, SEXP verboseSEXP, SEXP middleSplitSEXP, SEXP maxObsSEXP, SEXP featureWeightsSEXP, SEXP featureWeightsVariablesSEXP, SEXP deepFeatureWeightsSEXP, SEXP deepFeatureWeightsVariablesSEXP, SEXP observationWeightsSEXP, SEXP monotonicConstraintsSEXP, SEXP groupMembershipsSEXP, SEXP minTreesPerFoldSEXP, SEXP foldSizeSEXP, SEXP monotoneAvgSEXP, SEXP hasNasSEXP, SEXP naDirectionSEXP, SEXP linearSEXP, SEXP overfitPenaltySEXP, SEXP doubleTreeSEXP, SEXP existing_dataframe_flagSEXP, SEXP existing_dataframeSEXP) {
+SEXP rcpp_cppBuildInterface(Rcpp::List x, Rcpp::NumericVector y, Rcpp::NumericVector catCols, Rcpp::NumericVector linCols, int numRows, int numColumns, int ntree, bool replace, int sampsize, int mtry, double splitratio, bool OOBhonest, bool doubleBootstrap, int nodesizeSpl, int nodesizeAvg, int nodesizeStrictSpl, int nodesizeStrictAvg, double minSplitGain, int maxDepth, int interactionDepth, int seed, int nthread, bool verbose, bool middleSplit, int maxObs, Rcpp::NumericVector featureWeights, Rcpp::NumericVector featureWeightsVariables, Rcpp::NumericVector deepFeatureWeights, Rcpp::NumericVector deepFeatureWeightsVariables, Rcpp::NumericVector observationWeights, Rcpp::NumericVector monotonicConstraints, Rcpp::NumericVector groupMemberships, int minTreesPerFold, int foldSize, bool monotoneAvg, bool hasNas, bool naDirection, bool linear, double overfitPenalty, bool doubleTree, bool histogramSplit, int nodeParallelSize, bool compactSplits, bool inBagCounts, int firstTree, bool existing_dataframe_flag, SEXP existing_dataframe);
+RcppExport SEXP _Rforestry_rcpp_cppBuildInterface(SEXP xSEXP, SEXP ySEXP, SEXP catColsSEXP, SEXP linColsSEXP, SEXP numRowsSEXP, SEXP numColumnsSEXP, SEXP ntreeSEXP, SEXP replaceSEXP, SEXP sampsizeSEXP, SEXP mtrySEXP, SEXP splitratioSEXP, SEXP OOBhonestSEXP, SEXP doubleBootstrapSEXP, SEXP nodesizeSplSEXP, SEXP nodesizeAvgSEXP, SEXP nodesizeStrictSplSEXP, SEXP nodesizeStrictAvgSEXP, SEXP minSplitGainSEXP, SEXP maxDepthSEXP, SEXP interactionDepthSEXP, SEXP seedSEXP, SEXP nthreadSEXP, SEXP verboseSEXP, SEXP middleSplitSEXP, SEXP maxObsSEXP, SEXP featureWeightsSEXP, SEXP featureWeightsVariablesSEXP, SEXP deepFeatureWeightsSEXP, SEXP deepFeatureWeightsVariablesSEXP, SEXP observationWeightsSEXP, SEXP monotonicConstraintsSEXP, SEXP groupMembershipsSEXP, SEXP minTreesPerFoldSEXP, SEXP foldSizeSEXP, SEXP monotoneAvgSEXP, SEXP hasNasSEXP, SEXP naDirectionSEXP, SEXP linearSEXP, SEXP overfitPenaltySEXP, SEXP doubleTreeSEXP, SEXP histogramSplitSEXP, SEXP nodeParallelSizeSEXP, SEXP compactSplitsSEXP, SEXP inBagCountsSEXP, SEXP firstTreeSEXP, SEXP existing_dataframe_flagSEXP, SEXP existing_dataframeSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -82,15 +128,20 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type linear(linearSEXP);
     Rcpp::traits::input_parameter< double >::type overfitPenalty(overfitPenaltySEXP);
     Rcpp::traits::input_parameter< bool >::type doubleTree(doubleTreeSEXP);
+    Rcpp::traits::input_parameter< bool >::type histogramSplit(histogramSplitSEXP);
+    Rcpp::traits::input_parameter< int >::type nodeParallelSize(nodeParallelSizeSEXP);
+    Rcpp::traits::input_parameter< bool >::type compactSplits(compactSplitsSEXP);
+    Rcpp::traits::input_parameter< bool >::type inBagCounts(inBagCountsSEXP);
+    Rcpp::traits::input_parameter< int >::type firstTree(firstTreeSEXP);
     Rcpp::traits::input_parameter< bool >::type existing_dataframe_flag(existing_dataframe_flagSEXP);
     Rcpp::traits::input_parameter< SEXP >::type existing_dataframe(existing_dataframeSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_cppBuildInterface(x, y, catCols, linCols, numRows, numColumns, ntree, replace, sampsize, mtry, splitratio, OOBhonest, doubleBootstrap, nodesizeSpl, nodesizeAvg, nodesizeStrictSpl, nodesizeStrictAvg, minSplitGain, maxDepth, interactionDepth, seed, nthread, verbose, middleSplit, maxObs, featureWeights, featureWeightsVariables, deepFeatureWeights, deepFeatureWeightsVariables, observationWeights, monotonicConstraints, groupMemberships, minTreesPerFold, foldSize, monotoneAvg, hasNas, naDirection, linear, overfitPenalty, doubleTree, existing_dataframe_flag, existing_dataframe));
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppBuildInterface(x, y, catCols, linCols, numRows, numColumns, ntree, replace, sampsize, mtry, splitratio, OOBhonest, doubleBootstrap, nodesizeSpl, nodesizeAvg, nodesizeStrictSpl, nodesizeStrictAvg, minSplitGain, maxDepth, interactionDepth, seed, nthread, verbose, middleSplit, maxObs, featureWeights, featureWeightsVariables, deepFeatureWeights, deepFeatureWeightsVariables, observationWeights, monotonicConstraints, groupMemberships, minTreesPerFold, foldSize, monotoneAvg, hasNas, naDirection, linear, overfitPenalty, doubleTree, histogramSplit, nodeParallelSize, compactSplits, inBagCounts, firstTree, existing_dataframe_flag, existing_dataframe));
     return rcpp_result_gen;
 END_RCPP
 }
 // rcpp_cppPredictInterface
-Rcpp::List rcpp_cppPredictInterface(SEXP forest, Rcpp::List x, std::string aggregation, int seed, int nthread, bool exact, bool returnWeightMatrix, bool use_weights, bool use_hold_out_idx, Rcpp::NumericVector tree_weights, Rcpp::IntegerVector hold_out_idx);
-RcppExport SEXP _Rforestry_rcpp_cppPredictInterface(SEXP forestSEXP, SEXP xSEXP, SEXP aggregationSEXP, SEXP seedSEXP, SEXP nthreadSEXP, SEXP exactSEXP, SEXP returnWeightMatrixSEXP, SEXP use_weightsSEXP, SEXP use_hold_out_idxSEXP, SEXP tree_weightsSEXP, SEXP hold_out_idxSEXP) {
+Rcpp::List rcpp_cppPredictInterface(SEXP forest, Rcpp::List x, std::string aggregation, int seed, int nthread, bool exact, bool returnWeightMatrix, bool sparseWeightMatrix, bool use_weights, bool use_hold_out_idx, Rcpp::NumericVector tree_weights, Rcpp::IntegerVector hold_out_idx);
+RcppExport SEXP _Rforestry_rcpp_cppPredictInterface(SEXP forestSEXP, SEXP xSEXP, SEXP aggregationSEXP, SEXP seedSEXP, SEXP nthreadSEXP, SEXP exactSEXP, SEXP returnWeightMatrixSEXP, SEXP sparseWeightMatrixSEXP, SEXP use_weightsSEXP, SEXP use_hold_out_idxSEXP, SEXP tree_weightsSEXP, SEXP hold_out_idxSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -101,11 +152,78 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type nthread(nthreadSEXP);
     Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
     Rcpp::traits::input_parameter< bool >::type returnWeightMatrix(returnWeightMatrixSEXP);
+    Rcpp::traits::input_parameter< bool >::type sparseWeightMatrix(sparseWeightMatrixSEXP);
     Rcpp::traits::input_parameter< bool >::type use_weights(use_weightsSEXP);
     Rcpp::traits::input_parameter< bool >::type use_hold_out_idx(use_hold_out_idxSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type tree_weights(tree_weightsSEXP);
     Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type hold_out_idx(hold_out_idxSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_cppPredictInterface(forest, x, aggregation, seed, nthread, exact, returnWeightMatrix, use_weights, use_hold_out_idx, tree_weights, hold_out_idx));
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppPredictInterface(forest, x, aggregation, seed, nthread, exact, returnWeightMatrix, sparseWeightMatrix, use_weights, use_hold_out_idx, tree_weights, hold_out_idx));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_cppPredictRowInterface
+double rcpp_cppPredictRowInterface(SEXP forest, Rcpp::NumericVector x, int seed);
+RcppExport SEXP _Rforestry_rcpp_cppPredictRowInterface(SEXP forestSEXP, SEXP xSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppPredictRowInterface(forest, x, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_cppLpDistanceInterface
+Rcpp::NumericVector rcpp_cppLpDistanceInterface(SEXP forest, Rcpp::List x, Rcpp::NumericVector newFeature, Rcpp::NumericVector trainFeature, bool categorical, double p, int seed, bool OOB, bool doubleOOB, bool use_training_idx, Rcpp::IntegerVector training_idx);
+RcppExport SEXP _Rforestry_rcpp_cppLpDistanceInterface(SEXP forestSEXP, SEXP xSEXP, SEXP newFeatureSEXP, SEXP trainFeatureSEXP, SEXP categoricalSEXP, SEXP pSEXP, SEXP seedSEXP, SEXP OOBSEXP, SEXP doubleOOBSEXP, SEXP use_training_idxSEXP, SEXP training_idxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type newFeature(newFeatureSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type trainFeature(trainFeatureSEXP);
+    Rcpp::traits::input_parameter< bool >::type categorical(categoricalSEXP);
+    Rcpp::traits::input_parameter< double >::type p(pSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< bool >::type OOB(OOBSEXP);
+    Rcpp::traits::input_parameter< bool >::type doubleOOB(doubleOOBSEXP);
+    Rcpp::traits::input_parameter< bool >::type use_training_idx(use_training_idxSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type training_idx(training_idxSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppLpDistanceInterface(forest, x, newFeature, trainFeature, categorical, p, seed, OOB, doubleOOB, use_training_idx, training_idx));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_cppAssignLeavesInterface
+SEXP rcpp_cppAssignLeavesInterface(SEXP forest, Rcpp::List x, int seed, int nthread, bool keepWeightMatrix);
+RcppExport SEXP _Rforestry_rcpp_cppAssignLeavesInterface(SEXP forestSEXP, SEXP xSEXP, SEXP seedSEXP, SEXP nthreadSEXP, SEXP keepWeightMatrixSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< int >::type nthread(nthreadSEXP);
+    Rcpp::traits::input_parameter< bool >::type keepWeightMatrix(keepWeightMatrixSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppAssignLeavesInterface(forest, x, seed, nthread, keepWeightMatrix));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_cppPredictLeavesInterface
+Rcpp::List rcpp_cppPredictLeavesInterface(SEXP forest, SEXP leaves, int nthread, bool returnWeightMatrix, bool sparseWeightMatrix, bool use_weights, Rcpp::NumericVector tree_weights);
+RcppExport SEXP _Rforestry_rcpp_cppPredictLeavesInterface(SEXP forestSEXP, SEXP leavesSEXP, SEXP nthreadSEXP, SEXP returnWeightMatrixSEXP, SEXP sparseWeightMatrixSEXP, SEXP use_weightsSEXP, SEXP tree_weightsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type leaves(leavesSEXP);
+    Rcpp::traits::input_parameter< int >::type nthread(nthreadSEXP);
+    Rcpp::traits::input_parameter< bool >::type returnWeightMatrix(returnWeightMatrixSEXP);
+    Rcpp::traits::input_parameter< bool >::type sparseWeightMatrix(sparseWeightMatrixSEXP);
+    Rcpp::traits::input_parameter< bool >::type use_weights(use_weightsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type tree_weights(tree_weightsSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_cppPredictLeavesInterface(forest, leaves, nthread, returnWeightMatrix, sparseWeightMatrix, use_weights, tree_weights));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -120,9 +238,32 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// rcpp_getRunningOOBInterface
+double rcpp_getRunningOOBInterface(SEXP forest);
+RcppExport SEXP _Rforestry_rcpp_getRunningOOBInterface(SEXP forestSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_getRunningOOBInterface(forest));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_getVIInterface
+Rcpp::NumericVector rcpp_getVIInterface(SEXP forest, int seed);
+RcppExport SEXP _Rforestry_rcpp_getVIInterface(SEXP forestSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_getVIInterface(forest, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
 // rcpp_OBBPredictionsInterface
-Rcpp::List rcpp_OBBPredictionsInterface(SEXP forest, Rcpp::List x, bool existing_df, bool doubleOOB, bool returnWeightMatrix, bool exact, bool use_training_idx, Rcpp::IntegerVector training_idx);
-RcppExport SEXP _Rforestry_rcpp_OBBPredictionsInterface(SEXP forestSEXP, SEXP xSEXP, SEXP existing_dfSEXP, SEXP doubleOOBSEXP, SEXP returnWeightMatrixSEXP, SEXP exactSEXP, SEXP use_training_idxSEXP, SEXP training_idxSEXP) {
+Rcpp::List rcpp_OBBPredictionsInterface(SEXP forest, Rcpp::List x, bool existing_df, bool doubleOOB, bool returnWeightMatrix, bool sparseWeightMatrix, bool exact, bool use_training_idx, Rcpp::IntegerVector training_idx);
+RcppExport SEXP _Rforestry_rcpp_OBBPredictionsInterface(SEXP forestSEXP, SEXP xSEXP, SEXP existing_dfSEXP, SEXP doubleOOBSEXP, SEXP returnWeightMatrixSEXP, SEXP sparseWeightMatrixSEXP, SEXP exactSEXP, SEXP use_training_idxSEXP, SEXP training_idxSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -131,10 +272,11 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type existing_df(existing_dfSEXP);
     Rcpp::traits::input_parameter< bool >::type doubleOOB(doubleOOBSEXP);
     Rcpp::traits::input_parameter< bool >::type returnWeightMatrix(returnWeightMatrixSEXP);
+    Rcpp::traits::input_parameter< bool >::type sparseWeightMatrix(sparseWeightMatrixSEXP);
     Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
     Rcpp::traits::input_parameter< bool >::type use_training_idx(use_training_idxSEXP);
     Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type training_idx(training_idxSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_OBBPredictionsInterface(forest, x, existing_df, doubleOOB, returnWeightMatrix, exact, use_training_idx, training_idx));
+    rcpp_result_gen = Rcpp::wrap(rcpp_OBBPredictionsInterface(forest, x, existing_df, doubleOOB, returnWeightMatrix, sparseWeightMatrix, exact, use_training_idx, training_idx));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -160,6 +302,60 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// rcpp_mergeForestsInterface
+void rcpp_mergeForestsInterface(SEXP forest, Rcpp::List shards);
+RcppExport SEXP _Rforestry_rcpp_mergeForestsInterface(SEXP forestSEXP, SEXP shardsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type shards(shardsSEXP);
+    rcpp_mergeForestsInterface(forest, shards);
+    return R_NilValue;
+END_RCPP
+}
+// rcpp_slimForestInterface
+void rcpp_slimForestInterface(SEXP forest);
+RcppExport SEXP _Rforestry_rcpp_slimForestInterface(SEXP forestSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    rcpp_slimForestInterface(forest);
+    return R_NilValue;
+END_RCPP
+}
+// rcpp_getMemoryUsageInterface
+double rcpp_getMemoryUsageInterface(SEXP forest);
+RcppExport SEXP _Rforestry_rcpp_getMemoryUsageInterface(SEXP forestSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_getMemoryUsageInterface(forest));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_setInstrumentationInterface
+void rcpp_setInstrumentationInterface(bool enabled);
+RcppExport SEXP _Rforestry_rcpp_setInstrumentationInterface(SEXP enabledSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type enabled(enabledSEXP);
+    rcpp_setInstrumentationInterface(enabled);
+    return R_NilValue;
+END_RCPP
+}
+// rcpp_getInstrumentationInterface
+Rcpp::List rcpp_getInstrumentationInterface(SEXP forest, bool reset);
+RcppExport SEXP _Rforestry_rcpp_getInstrumentationInterface(SEXP forestSEXP, SEXP resetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< bool >::type reset(resetSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_getInstrumentationInterface(forest, reset));
+    return rcpp_result_gen;
+END_RCPP
+}
 // rcpp_CppToR_translator
 Rcpp::List rcpp_CppToR_translator(SEXP forest);
 RcppExport SEXP _Rforestry_rcpp_CppToR_translator(SEXP forestSEXP) {
@@ -172,8 +368,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // rcpp_reconstructree
-Rcpp::List rcpp_reconstructree(Rcpp::List x, Rcpp::NumericVector y, Rcpp::NumericVector catCols, Rcpp::NumericVector linCols, int numRows, int numColumns, Rcpp::List R_forest, bool replace, int sampsize, double splitratio, bool OOBhonest, bool doubleBootstrap, int mtry, int nodesizeSpl, int nodesizeAvg, int nodesizeStrictSpl, int nodesizeStrictAvg, double minSplitGain, int maxDepth, int interactionDepth, int seed, int nthread, bool verbose, bool middleSplit, int maxObs, int minTreesPerFold, Rcpp::NumericVector featureWeights, Rcpp::NumericVector featureWeightsVariables, Rcpp::NumericVector deepFeatureWeights, Rcpp::NumericVector deepFeatureWeightsVariables, Rcpp::NumericVector observationWeights, Rcpp::NumericVector monotonicConstraints, Rcpp::NumericVector groupMemberships, bool monotoneAvg, bool hasNas, bool naDirection, bool linear, double overfitPenalty, bool doubleTree);
-RcppExport SEXP _Rforestry_rcpp_reconstructree(SEXP xSEXP, SEXP ySEXP, SEXP catColsSEXP, SEXP linColsSEXP, SEXP numRowsSEXP, SEXP numColumnsSEXP, SEXP R_forestSEXP, SEXP replaceSEXP, SEXP sampsizeSEXP, SEXP splitratioSEXP, SEXP OOBhonestSEXP, SEXP doubleBootstrapSEXP, SEXP mtrySEXP, SEXP nodesizeSplSEXP, SEXP nodesizeAvgSEXP, SEXP nodesizeStrictSplSEXP, SEXP nodesizeStrictAvgSEXP, SEXP minSplitGainSEXP, SEXP maxDepthSEXP, SEXP interactionDepthSEXP, SEXP seedSEXP, SEXP nthreadSEXP, SEXP verboseSEXP, SEXP middleSplitSEXP, SEXP maxObsSEXP, SEXP minTreesPerFoldSEXP, SEXP featureWeightsSEXP, SEXP featureWeightsVariablesSEXP, SEXP deepFeatureWeightsSEXP, SEXP deepFeatureWeightsVariablesSEXP, SEXP observationWeightsSEXP, SEXP monotonicConstraintsSEXP, SEXP groupMembershipsSEXP, SEXP monotoneAvgSEXP, SEXP hasNasSEXP, SEXP naDirectionSEXP, SEXP linearSEXP, SEXP overfitPenaltySEXP, SEXP doubleTreeSEXP) {
+Rcpp::List rcpp_reconstructree(Rcpp::List x, Rcpp::NumericVector y, Rcpp::NumericVector catCols, Rcpp::NumericVector linCols, int numRows, int numColumns, Rcpp::List R_forest, bool replace, int sampsize, double splitratio, bool OOBhonest, bool doubleBootstrap, int mtry, int nodesizeSpl, int nodesizeAvg, int nodesizeStrictSpl, int nodesizeStrictAvg, double minSplitGain, int maxDepth, int interactionDepth, int seed, int nthread, bool verbose, bool middleSplit, int maxObs, int minTreesPerFold, int foldSize, Rcpp::NumericVector featureWeights, Rcpp::NumericVector featureWeightsVariables, Rcpp::NumericVector deepFeatureWeights, Rcpp::NumericVector deepFeatureWeightsVariables, Rcpp::NumericVector observationWeights, Rcpp::NumericVector monotonicConstraints, Rcpp::NumericVector groupMemberships, bool monotoneAvg, bool hasNas, bool naDirection, bool linear, double overfitPenalty, bool doubleTree, bool histogramSplit, int nodeParallelSize, bool compactSplits, bool inBagCounts);
+RcppExport SEXP _Rforestry_rcpp_reconstructree(SEXP xSEXP, SEXP ySEXP, SEXP catColsSEXP, SEXP linColsSEXP, SEXP numRowsSEXP, SEXP numColumnsSEXP, SEXP R_forestSEXP, SEXP replaceSEXP, SEXP sampsizeSEXP, SEXP splitratioSEXP, SEXP OOBhonestSEXP, SEXP doubleBootstrapSEXP, SEXP mtrySEXP, SEXP nodesizeSplSEXP, SEXP nodesizeAvgSEXP, SEXP nodesizeStrictSplSEXP, SEXP nodesizeStrictAvgSEXP, SEXP minSplitGainSEXP, SEXP maxDepthSEXP, SEXP interactionDepthSEXP, SEXP seedSEXP, SEXP nthreadSEXP, SEXP verboseSEXP, SEXP middleSplitSEXP, SEXP maxObsSEXP, SEXP minTreesPerFoldSEXP, SEXP foldSizeSEXP, SEXP featureWeightsSEXP, SEXP featureWeightsVariablesSEXP, SEXP deepFeatureWeightsSEXP, SEXP deepFeatureWeightsVariablesSEXP, SEXP observationWeightsSEXP, SEXP monotonicConstraintsSEXP, SEXP groupMembershipsSEXP, SEXP monotoneAvgSEXP, SEXP hasNasSEXP, SEXP naDirectionSEXP, SEXP linearSEXP, SEXP overfitPenaltySEXP, SEXP doubleTreeSEXP, SEXP histogramSplitSEXP, SEXP nodeParallelSizeSEXP, SEXP compactSplitsSEXP, SEXP inBagCountsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -203,6 +399,7 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type middleSplit(middleSplitSEXP);
     Rcpp::traits::input_parameter< int >::type maxObs(maxObsSEXP);
     Rcpp::traits::input_parameter< int >::type minTreesPerFold(minTreesPerFoldSEXP);
+    Rcpp::traits::input_parameter< int >::type foldSize(foldSizeSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type featureWeights(featureWeightsSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type featureWeightsVariables(featureWeightsVariablesSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type deepFeatureWeights(deepFeatureWeightsSEXP);
@@ -216,10 +413,48 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type linear(linearSEXP);
     Rcpp::traits::input_parameter< double >::type overfitPenalty(overfitPenaltySEXP);
     Rcpp::traits::input_parameter< bool >::type doubleTree(doubleTreeSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_reconstructree(x, y, catCols, linCols, numRows, numColumns, R_forest, replace, sampsize, splitratio, OOBhonest, doubleBootstrap, mtry, nodesizeSpl, nodesizeAvg, nodesizeStrictSpl, nodesizeStrictAvg, minSplitGain, maxDepth, interactionDepth, seed, nthread, verbose, middleSplit, maxObs, minTreesPerFold, featureWeights, featureWeightsVariables, deepFeatureWeights, deepFeatureWeightsVariables, observationWeights, monotonicConstraints, groupMemberships, monotoneAvg, hasNas, naDirection, linear, overfitPenalty, doubleTree));
+    Rcpp::traits::input_parameter< bool >::type histogramSplit(histogramSplitSEXP);
+    Rcpp::traits::input_parameter< int >::type nodeParallelSize(nodeParallelSizeSEXP);
+    Rcpp::traits::input_parameter< bool >::type compactSplits(compactSplitsSEXP);
+    Rcpp::traits::input_parameter< bool >::type inBagCounts(inBagCountsSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_reconstructree(x, y, catCols, linCols, numRows, numColumns, R_forest, replace, sampsize, splitratio, OOBhonest, doubleBootstrap, mtry, nodesizeSpl, nodesizeAvg, nodesizeStrictSpl, nodesizeStrictAvg, minSplitGain, maxDepth, interactionDepth, seed, nthread, verbose, middleSplit, maxObs, minTreesPerFold, foldSize, featureWeights, featureWeightsVariables, deepFeatureWeights, deepFeatureWeightsVariables, observationWeights, monotonicConstraints, groupMemberships, monotoneAvg, hasNas, naDirection, linear, overfitPenalty, doubleTree, histogramSplit, nodeParallelSize, compactSplits, inBagCounts));
     return rcpp_result_gen;
 END_RCPP
 }
+// rcpp_saveForestBinary
+void rcpp_saveForestBinary(SEXP forest, std::string filename, Rcpp::RawVector metadata);
+RcppExport SEXP _Rforestry_rcpp_saveForestBinary(SEXP forestSEXP, SEXP filenameSEXP, SEXP metadataSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< Rcpp::RawVector >::type metadata(metadataSEXP);
+    rcpp_saveForestBinary(forest, filename, metadata);
+    return R_NilValue;
+END_RCPP
+}
+// rcpp_readForestBinaryMetadata
+Rcpp::RawVector rcpp_readForestBinaryMetadata(std::string filename);
+RcppExport SEXP _Rforestry_rcpp_readForestBinaryMetadata(SEXP filenameSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_readForestBinaryMetadata(filename));
+    return rcpp_result_gen;
+END_RCPP
+}
+// rcpp_loadForestBinary
+void rcpp_loadForestBinary(SEXP forest, std::string filename);
+RcppExport SEXP _Rforestry_rcpp_loadForestBinary(SEXP forestSEXP, SEXP filenameSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type forest(forestSEXP);
+    Rcpp::traits::input_parameter< std::string >::type filename(filenameSEXP);
+    rcpp_loadForestBinary(forest, filename);
+    return R_NilValue;
+END_RCPP
+}
 // rcpp_cppImputeInterface
 std::vector< std::vector<double> > rcpp_cppImputeInterface(SEXP forest, Rcpp::List x, int seed);
 RcppExport SEXP _Rforestry_rcpp_cppImputeInterface(SEXP forestSEXP, SEXP xSEXP, SEXP seedSEXP) {
@@ -235,15 +470,32 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_Rforestry_rcpp_cppDataFrameInterface", (DL_FUNC) &_Rforestry_rcpp_cppDataFrameInterface, 14},
-    {"_Rforestry_rcpp_cppBuildInterface", (DL_FUNC) &_Rforestry_rcpp_cppBuildInterface, 42},
-    {"_Rforestry_rcpp_cppPredictInterface", (DL_FUNC) &_Rforestry_rcpp_cppPredictInterface, 11},
+    {"_Rforestry_rcpp_cppDataFrameInterface", (DL_FUNC) &_Rforestry_rcpp_cppDataFrameInterface, 15},
+    {"_Rforestry_rcpp_cppMappedDataFrameInterface", (DL_FUNC) &_Rforestry_rcpp_cppMappedDataFrameInterface, 12},
+    {"_Rforestry_rcpp_writeColumnFileInterface", (DL_FUNC) &_Rforestry_rcpp_writeColumnFileInterface, 3},
+    {"_Rforestry_rcpp_readColumnFileInterface", (DL_FUNC) &_Rforestry_rcpp_readColumnFileInterface, 1},
+    {"_Rforestry_rcpp_cppBuildInterface", (DL_FUNC) &_Rforestry_rcpp_cppBuildInterface, 47},
+    {"_Rforestry_rcpp_cppPredictInterface", (DL_FUNC) &_Rforestry_rcpp_cppPredictInterface, 12},
+    {"_Rforestry_rcpp_cppPredictRowInterface", (DL_FUNC) &_Rforestry_rcpp_cppPredictRowInterface, 3},
+    {"_Rforestry_rcpp_cppLpDistanceInterface", (DL_FUNC) &_Rforestry_rcpp_cppLpDistanceInterface, 11},
+    {"_Rforestry_rcpp_cppAssignLeavesInterface", (DL_FUNC) &_Rforestry_rcpp_cppAssignLeavesInterface, 5},
+    {"_Rforestry_rcpp_cppPredictLeavesInterface", (DL_FUNC) &_Rforestry_rcpp_cppPredictLeavesInterface, 7},
     {"_Rforestry_rcpp_OBBPredictInterface", (DL_FUNC) &_Rforestry_rcpp_OBBPredictInterface, 1},
-    {"_Rforestry_rcpp_OBBPredictionsInterface", (DL_FUNC) &_Rforestry_rcpp_OBBPredictionsInterface, 8},
+    {"_Rforestry_rcpp_getRunningOOBInterface", (DL_FUNC) &_Rforestry_rcpp_getRunningOOBInterface, 1},
+    {"_Rforestry_rcpp_getVIInterface", (DL_FUNC) &_Rforestry_rcpp_getVIInterface, 2},
+    {"_Rforestry_rcpp_OBBPredictionsInterface", (DL_FUNC) &_Rforestry_rcpp_OBBPredictionsInterface, 9},
     {"_Rforestry_rcpp_getObservationSizeInterface", (DL_FUNC) &_Rforestry_rcpp_getObservationSizeInterface, 1},
     {"_Rforestry_rcpp_AddTreeInterface", (DL_FUNC) &_Rforestry_rcpp_AddTreeInterface, 2},
+    {"_Rforestry_rcpp_mergeForestsInterface", (DL_FUNC) &_Rforestry_rcpp_mergeForestsInterface, 2},
+    {"_Rforestry_rcpp_slimForestInterface", (DL_FUNC) &_Rforestry_rcpp_slimForestInterface, 1},
+    {"_Rforestry_rcpp_getMemoryUsageInterface", (DL_FUNC) &_Rforestry_rcpp_getMemoryUsageInterface, 1},
+    {"_Rforestry_rcpp_setInstrumentationInterface", (DL_FUNC) &_Rforestry_rcpp_setInstrumentationInterface, 1},
+    {"_Rforestry_rcpp_getInstrumentationInterface", (DL_FUNC) &_Rforestry_rcpp_getInstrumentationInterface, 2},
     {"_Rforestry_rcpp_CppToR_translator", (DL_FUNC) &_Rforestry_rcpp_CppToR_translator, 1},
-    {"_Rforestry_rcpp_reconstructree", (DL_FUNC) &_Rforestry_rcpp_reconstructree, 39},
+    {"_Rforestry_rcpp_reconstructree", (DL_FUNC) &_Rforestry_rcpp_reconstructree, 44},
+    {"_Rforestry_rcpp_saveForestBinary", (DL_FUNC) &_Rforestry_rcpp_saveForestBinary, 3},
+    {"_Rforestry_rcpp_readForestBinaryMetadata", (DL_FUNC) &_Rforestry_rcpp_readForestBinaryMetadata, 1},
+    {"_Rforestry_rcpp_loadForestBinary", (DL_FUNC) &_Rforestry_rcpp_loadForestBinary, 2},
     {"_Rforestry_rcpp_cppImputeInterface", (DL_FUNC) &_Rforestry_rcpp_cppImputeInterface, 3},
     {NULL, NULL, 0}
 };
@@ -0,0 +1,568 @@
+// Benchmark of the C++ forest, which runs without R on synthetic data and
+// prints the time of each stage as CSV, together with the instrumentation the
+// forests collect. The files in this directory are not part of the package.
+//
+// Build from the root of the repository with the full Armadillo library, the
+// R interface files are left out:
+//
+//   g++ -std=c++11 -O2 -pthread -Isrc/benchmark/shim -Isrc
+//     $(ls src/*.cpp | grep -v -e RcppExports -e rcpp_)
+//     src/benchmark/benchmark.cpp -larmadillo -o forestry_benchmark
+//
+// Every combination of the comma separated lists is run, for example:
+//
+//   ./forestry_benchmark --rows 1000,10000 --cols 10 --threads 1,4 --histogram
+//
+// Options:
+//   --rows n,...       numbers of training rows (default 10000)
+//   --cols p,...       numbers of features (default 10)
+//   --trees n,...      numbers of trees (default 100)
+//   --threads n,...    numbers of threads, 0 uses all cores (default 1)
+//   --mtry n           features sampled at each node, 0 uses a third (default 0)
+//   --repeat n         repetitions of each stage, the fastest is kept (default 3)
+//   --weightRows n     observations the weight matrix is built for (default 1000)
+//   --file name        scratch file of the binary forest (default forestry_benchmark.bin)
+//   --histogram        grow the trees with histogram splits
+//   --splitMiddle      place the split values midway between two observations
+//                      instead of drawing them uniformly between them
+//   --compactSplits    store the features and split values as float32 and
+//                      the sample indices as uint32
+//   --inBagCounts      keep the sampled rows of the trees as uint8/uint16
+//                      in bag counts
+//   --nodeParallel n   grow the nodes with at least n observations in parallel
+//   --columnFile name  train on the features written to a memory mapped column file
+//   --float32Columns   store the features of the column file as float32
+
+#include "DataFrame.h"
+#include "forestry.h"
+#include "instrumentation.h"
+#include "mappedColumns.h"
+#include "treeSplitting.h"
+#include "utils.h"
+#include <armadillo>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct benchmark_options {
+  std::vector<size_t> rows;
+  std::vector<size_t> cols;
+  std::vector<size_t> trees;
+  std::vector<size_t> threads;
+  size_t mtry;
+  size_t repetitions;
+  size_t weightRows;
+  std::string filename;
+  bool histogramSplit;
+  bool splitMiddle;
+  bool compactSplits;
+  bool inBagCounts;
+  size_t nodeParallelSize;
+  std::string columnFile;
+  bool float32Columns;
+
+  benchmark_options() {
+    rows.push_back(10000);
+    cols.push_back(10);
+    trees.push_back(100);
+    threads.push_back(1);
+    mtry = 0;
+    repetitions = 3;
+    weightRows = 1000;
+    filename = "forestry_benchmark.bin";
+    histogramSplit = false;
+    splitMiddle = false;
+    compactSplits = false;
+    inBagCounts = false;
+    nodeParallelSize = 0;
+    float32Columns = false;
+  }
+};
+
+static std::vector<size_t> parseSizes(const std::string &list) {
+  std::vector<size_t> sizes;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string entry = list.substr(start, end - start);
+    if (entry.empty() || entry.find_first_not_of("0123456789") != std::string::npos) {
+      throw std::runtime_error("Cannot read the list " + list + ".");
+    }
+    sizes.push_back((size_t) std::strtoull(entry.c_str(), NULL, 10));
+    start = end + 1;
+  }
+  return sizes;
+}
+
+static benchmark_options parseOptions(int argc, char* argv[]) {
+  benchmark_options options;
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    if (option == "--histogram") {
+      options.histogramSplit = true;
+    } else if (option == "--splitMiddle") {
+      options.splitMiddle = true;
+    } else if (option == "--compactSplits") {
+      options.compactSplits = true;
+    } else if (option == "--inBagCounts") {
+      options.inBagCounts = true;
+    } else if (option == "--float32Columns") {
+      options.float32Columns = true;
+    } else {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("The option " + option + " needs a value.");
+      }
+      std::string value = argv[++i];
+      if (option == "--rows") {
+        options.rows = parseSizes(value);
+      } else if (option == "--cols") {
+        options.cols = parseSizes(value);
+      } else if (option == "--trees") {
+        options.trees = parseSizes(value);
+      } else if (option == "--threads") {
+        options.threads = parseSizes(value);
+      } else if (option == "--mtry") {
+        options.mtry = parseSizes(value)[0];
+      } else if (option == "--repeat") {
+        options.repetitions = std::max((size_t) 1, parseSizes(value)[0]);
+      } else if (option == "--weightRows") {
+        options.weightRows = parseSizes(value)[0];
+      } else if (option == "--file") {
+        options.filename = value;
+      } else if (option == "--nodeParallel") {
+        options.nodeParallelSize = parseSizes(value)[0];
+      } else if (option == "--columnFile") {
+        options.columnFile = value;
+      } else {
+        throw std::runtime_error("Unknown option " + option + ".");
+      }
+    }
+  }
+  return options;
+}
+
+// Contains synthetic features stored by column and an outcome which depends
+// on the first features, some of them nonlinearly
+struct synthetic_data {
+  std::vector< std::vector<double> > features;
+  std::vector<double> outcome;
+};
+
+static synthetic_data generateData(
+  size_t numRows,
+  size_t numColumns,
+  unsigned int seed
+) {
+  std::mt19937_64 generator(seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 0.3);
+
+  synthetic_data data;
+  data.features.assign(numColumns, std::vector<double>(numRows));
+  data.outcome.resize(numRows);
+  for (size_t i = 0; i < numRows; i++) {
+    for (size_t j = 0; j < numColumns; j++) {
+      data.features[j][i] = uniform(generator);
+    }
+    // The second feature has ties, as rounded measurements have
+    if (numColumns > 1) {
+      data.features[1][i] = std::round(data.features[1][i] * 20) / 20;
+    }
+    double signal = 3 * data.features[0][i];
+    if (numColumns > 1) {
+      signal += std::sin(6 * data.features[1][i]);
+    }
+    if (numColumns > 2) {
+      signal += data.features[2][i] * data.features[2][i];
+    }
+    data.outcome[i] = signal + noise(generator);
+  }
+  return data;
+}
+
+static DataFrame* makeTrainingData(
+  const synthetic_data &data,
+  const benchmark_options &options
+) {
+  size_t numRows = data.outcome.size();
+  size_t numColumns = data.features.size();
+  std::vector<size_t> featureVariables(numColumns);
+  for (size_t j = 0; j < numColumns; j++) {
+    featureVariables[j] = j;
+  }
+
+  if (!options.columnFile.empty()) {
+    mappedColumns::write(options.columnFile,
+                         make_column_views(data.features),
+                         options.float32Columns);
+    return new DataFrame(
+      std::make_shared< mappedColumns >(options.columnFile),
+      std::unique_ptr< std::vector<double> >(
+        new std::vector<double>(data.outcome)),
+      std::unique_ptr< std::vector<size_t> >(new std::vector<size_t>()),
+      std::unique_ptr< std::vector<size_t> >(new std::vector<size_t>()),
+      std::unique_ptr< std::vector<double> >(new std::vector<double>()),
+      std::unique_ptr< std::vector<size_t> >(
+        new std::vector<size_t>(featureVariables)),
+      std::unique_ptr< std::vector<double> >(new std::vector<double>()),
+      std::unique_ptr< std::vector<size_t> >(
+        new std::vector<size_t>(featureVariables)),
+      std::unique_ptr< std::vector<double> >(
+        new std::vector<double>(numRows, 1.0 / numRows)),
+      std::make_shared< std::vector<int> >(numColumns, 0),
+      std::unique_ptr< std::vector<size_t> >(new std::vector<size_t>(numRows, 0)),
+      false
+    );
+  }
+
+  return new DataFrame(
+    std::make_shared< std::vector< std::vector<double> > >(data.features),
+    std::unique_ptr< std::vector<double> >(
+      new std::vector<double>(data.outcome)),
+    std::unique_ptr< std::vector<size_t> >(new std::vector<size_t>()),
+    std::unique_ptr< std::vector<size_t> >(new std::vector<size_t>()),
+    numRows,
+    numColumns,
+    std::unique_ptr< std::vector<double> >(new std::vector<double>()),
+    std::unique_ptr< std::vector<size_t> >(
+      new std::vector<size_t>(featureVariables)),
+    std::unique_ptr< std::vector<double> >(new std::vector<double>()),
+    std::unique_ptr< std::vector<size_t> >(
+      new std::vector<size_t>(featureVariables)),
+    std::unique_ptr< std::vector<double> >(
+      new std::vector<double>(numRows, 1.0 / numRows)),
+    std::make_shared< std::vector<int> >(numColumns, 0),
+    std::unique_ptr< std::vector<size_t> >(new std::vector<size_t>(numRows, 0)),
+    false,
+    options.compactSplits
+  );
+}
+
+// Trains ntree trees with the default parameters of forestry() in R
+static forestry* trainForest(
+  DataFrame* trainingData,
+  size_t ntree,
+  size_t nthread,
+  const benchmark_options &options
+) {
+  size_t numRows = trainingData->getNumRows();
+  size_t numColumns = trainingData->getNumColumns();
+  size_t mtry = options.mtry > 0 ?
+    std::min(options.mtry, numColumns) :
+    std::max((size_t) 1, numColumns / 3);
+
+  return new forestry(
+    trainingData,
+    ntree,
+    true,
+    numRows,
+    1.0,
+    false,
+    false,
+    mtry,
+    5,
+    5,
+    10,
+    10,
+    0.0,
+    99,
+    99,
+    2,
+    nthread,
+    false,
+    options.splitMiddle,
+    numRows,
+    0,
+    1,
+    false,
+    false,
+    false,
+    1.0,
+    false,
+    options.histogramSplit,
+    options.nodeParallelSize,
+    options.compactSplits,
+    options.inBagCounts,
+    0
+  );
+}
+
+// Returns the fastest of the repetitions of stage in seconds
+static double timeStage(size_t repetitions, const std::function<void()> &stage) {
+  double fastest = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < repetitions; i++) {
+    std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    stage();
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    fastest = std::min(fastest, elapsed.count());
+  }
+  return fastest;
+}
+
+static void printRow(
+  const std::string &configuration,
+  const std::string &measurement,
+  double value,
+  const std::string &unit
+) {
+  std::printf("%s,%s,%.9g,%s\n", configuration.c_str(), measurement.c_str(),
+              value, unit.c_str());
+}
+
+static void printInstrumentation(
+  const std::string &configuration,
+  const std::string &stage,
+  forestry* forest
+) {
+  forestry_instrumentation* stats = forest->getInstrumentation();
+  for (size_t i = 0; i < NUM_INSTRUMENTED_PHASES; i++) {
+    if (stats->phaseCalls[i] > 0) {
+      printRow(configuration, stage + "." + instrumentedPhaseName(i),
+               (double) stats->phaseNanoseconds[i] / 1e9, "thread seconds");
+      printRow(configuration, stage + "." + instrumentedPhaseName(i) + ".calls",
+               (double) stats->phaseCalls[i], "calls");
+    }
+  }
+  if (stats->treesGrown > 0) {
+    printRow(configuration, stage + ".trees", (double) stats->treesGrown, "trees");
+    printRow(configuration, stage + ".nodes", (double) stats->nodesGrown, "leaves");
+    printRow(configuration, stage + ".featuresEvaluated",
+             (double) stats->featuresEvaluated, "features");
+  }
+  if (stats->rowsPredicted > 0) {
+    printRow(configuration, stage + ".rowsPredicted",
+             (double) stats->rowsPredicted, "rows");
+  }
+  if (stats->bytesAllocated > 0) {
+    printRow(configuration, stage + ".bytesAllocated",
+             (double) stats->bytesAllocated, "bytes");
+  }
+  stats->reset();
+}
+
+static void runConfiguration(
+  size_t numRows,
+  size_t numColumns,
+  size_t ntree,
+  size_t nthread,
+  const benchmark_options &options
+) {
+  std::string configuration =
+    std::to_string(numRows) + "," + std::to_string(numColumns) + "," +
+    std::to_string(ntree) + "," + std::to_string(nthread) + "," +
+    (options.histogramSplit ? "1" : "0") + "," +
+    (options.splitMiddle ? "1" : "0") + "," +
+    (options.compactSplits ? "1" : "0") + "," +
+    (options.inBagCounts ? "1" : "0");
+
+  synthetic_data training = generateData(numRows, numColumns, 1);
+  synthetic_data test = generateData(numRows, numColumns, 2);
+  std::unique_ptr< DataFrame > trainingData(
+    makeTrainingData(training, options)
+  );
+  std::vector<column_view> testFeatures = make_column_views(test.features);
+
+  // The forest is trained in its constructor, the last repetition is kept for
+  // the other stages
+  std::unique_ptr< forestry > forest;
+  setInstrumentationEnabled(true);
+  double trainSeconds = timeStage(options.repetitions, [&]() {
+    forest.reset(trainForest(trainingData.get(), ntree, nthread, options));
+  });
+  setInstrumentationEnabled(false);
+  printRow(configuration, "train", trainSeconds, "seconds");
+  printInstrumentation(configuration, "train", forest.get());
+  printRow(configuration, "treeBytes", (double) forest->getTotalMemoryUsage(),
+           "bytes");
+
+  // Runs the split search of the root node once on every feature
+  std::vector<size_t> rootIndex(numRows);
+  for (size_t i = 0; i < numRows; i++) {
+    rootIndex[i] = i;
+  }
+  monotonic_info monotone_details;
+  monotone_details.monotonic_constraints =
+    trainingData->getMonotonicConstraints();
+  monotone_details.upper_bound = std::numeric_limits<double>::max();
+  monotone_details.lower_bound = -std::numeric_limits<double>::max();
+  std::mt19937_64 splitGenerator(3);
+  objectArena< presort_counts > presortCounts;
+  double splitSeconds = timeStage(options.repetitions, [&]() {
+    for (size_t j = 0; j < numColumns; j++) {
+      double bestSplitLoss = -std::numeric_limits<double>::infinity();
+      double bestSplitValue = std::numeric_limits<double>::quiet_NaN();
+      size_t bestSplitFeature = 0;
+      size_t bestSplitCount = 0;
+      findBestSplitValueNonCategorical(
+        &rootIndex,
+        &rootIndex,
+        nullptr,
+        nullptr,
+        0,
+        j,
+        &bestSplitLoss,
+        &bestSplitValue,
+        &bestSplitFeature,
+        &bestSplitCount,
+        trainingData.get(),
+        10,
+        10,
+        splitGenerator,
+        options.splitMiddle,
+        numRows,
+        false,
+        monotone_details,
+        &presortCounts
+      );
+    }
+  });
+  printRow(configuration, "rootSplitSearch", splitSeconds, "seconds");
+
+  setInstrumentationEnabled(true);
+  double predictSeconds = timeStage(options.repetitions, [&]() {
+    forest->predict(&testFeatures, NULL, NULL, NULL, 4, nthread, false, false,
+                    NULL);
+  });
+  printRow(configuration, "predict", predictSeconds, "seconds");
+
+  double exactSeconds = timeStage(options.repetitions, [&]() {
+    forest->predict(&testFeatures, NULL, NULL, NULL, 4, nthread, true, false,
+                    NULL);
+  });
+  printRow(configuration, "predictExact", exactSeconds, "seconds");
+
+  std::vector<size_t> treeCounts(numRows);
+  std::vector<size_t> trainingIndex;
+  std::vector<column_view>* trainingFeatures =
+    trainingData->getAllFeatureData();
+  double OOBSeconds = timeStage(options.repetitions, [&]() {
+    forest->predictOOB(trainingFeatures, NULL, &treeCounts, false, false,
+                       trainingIndex);
+  });
+  printRow(configuration, "predictOOB", OOBSeconds, "seconds");
+
+  // The rows of the weight matrix are only counted, so it is never held
+  size_t weightRows = std::min(options.weightRows, numRows);
+  std::vector< std::vector<double> > weightFeatures(numColumns);
+  for (size_t j = 0; j < numColumns; j++) {
+    weightFeatures[j].assign(test.features[j].begin(),
+                             test.features[j].begin() + weightRows);
+  }
+  std::vector<column_view> weightColumns = make_column_views(weightFeatures);
+  std::vector<size_t> weightEntries(weightRows);
+  weight_row_consumer countWeightRows = [&](
+    size_t row,
+    const std::vector<size_t> &columns,
+    const std::vector<double> & /* weights */
+  ) {
+    weightEntries[row] = columns.size();
+  };
+  double weightSeconds = timeStage(options.repetitions, [&]() {
+    forest->predict(&weightColumns, NULL, NULL, NULL, 4, nthread, false, false,
+                    NULL, &countWeightRows);
+  });
+  printRow(configuration, "weightMatrix", weightSeconds, "seconds");
+  size_t totalEntries = 0;
+  for (size_t i = 0; i < weightRows; i++) {
+    totalEntries += weightEntries[i];
+  }
+  printRow(configuration, "weightMatrix.entries", (double) totalEntries,
+           "entries");
+  setInstrumentationEnabled(false);
+  printInstrumentation(configuration, "predict", forest.get());
+
+  // Translates the trees as for saving them in R, and reconstructs them in an
+  // empty forest as when they are loaded
+  setInstrumentationEnabled(true);
+  std::unique_ptr< std::vector<tree_info> > forestArrays;
+  double translateSeconds = timeStage(options.repetitions, [&]() {
+    forestArrays.reset(new std::vector<tree_info>);
+    forest->fillinTreeInfo(forestArrays);
+  });
+  printRow(configuration, "translate", translateSeconds, "seconds");
+  printInstrumentation(configuration, "translate", forest.get());
+
+  std::unique_ptr< forestry > reconstructed;
+  double reconstructSeconds = timeStage(options.repetitions, [&]() {
+    std::vector< tree_info_view > treeArrays;
+    for (size_t i = 0; i < forestArrays->size(); i++) {
+      const tree_info &tree = (*forestArrays)[i];
+      tree_info_view treeView;
+      treeView.var_id = tree.var_id.data();
+      treeView.numVarIds = tree.var_id.size();
+      treeView.split_val = tree.split_val.data();
+      treeView.naLeftCount = tree.naLeftCount.data();
+      treeView.naRightCount = tree.naRightCount.data();
+      treeView.naDefaultDirection = tree.naDefaultDirection.data();
+      treeView.numSplitVals = tree.split_val.size();
+      treeView.values = tree.values.data();
+      treeView.numValues = tree.values.size();
+      treeView.averagingSampleIndex = tree.averagingSampleIndex.data();
+      treeView.numAveraging = tree.averagingSampleIndex.size();
+      treeView.splittingSampleIndex = tree.splittingSampleIndex.data();
+      treeView.numSplitting = tree.splittingSampleIndex.size();
+      treeView.seed = tree.seed;
+      treeArrays.push_back(treeView);
+    }
+    std::unique_ptr< std::vector<size_t> > categoricalCols(
+      new std::vector<size_t>()
+    );
+    reconstructed.reset(trainForest(trainingData.get(), 0, nthread, options));
+    reconstructed->reconstructTrees(categoricalCols, treeArrays);
+  });
+  printRow(configuration, "reconstruct", reconstructSeconds, "seconds");
+  printInstrumentation(configuration, "reconstruct", reconstructed.get());
+
+  double saveSeconds = timeStage(options.repetitions, [&]() {
+    forest->saveBinaryForest(options.filename, NULL, 0);
+  });
+  printRow(configuration, "saveBinary", saveSeconds, "seconds");
+
+  std::unique_ptr< forestry > loaded;
+  double loadSeconds = timeStage(options.repetitions, [&]() {
+    loaded.reset(trainForest(trainingData.get(), 0, nthread, options));
+    loaded->loadBinaryForest(options.filename);
+  });
+  setInstrumentationEnabled(false);
+  std::remove(options.filename.c_str());
+  printRow(configuration, "loadBinary", loadSeconds, "seconds");
+  printInstrumentation(configuration, "save", forest.get());
+  printInstrumentation(configuration, "load", loaded.get());
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    benchmark_options options = parseOptions(argc, argv);
+    std::printf("rows,cols,trees,threads,histogram,splitMiddle,compactSplits,"
+                "inBagCounts,measurement,value,unit\n");
+    for (size_t r = 0; r < options.rows.size(); r++) {
+      for (size_t c = 0; c < options.cols.size(); c++) {
+        for (size_t t = 0; t < options.trees.size(); t++) {
+          for (size_t n = 0; n < options.threads.size(); n++) {
+            runConfiguration(options.rows[r], options.cols[c],
+                             options.trees[t], options.threads[n], options);
+          }
+        }
+      }
+    }
+  } catch (std::exception const& err) {
+    std::cerr << err.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef FORESTRYCPP_BENCHMARK_RCPP_H
+#define FORESTRYCPP_BENCHMARK_RCPP_H
+
+// Stands in for the parts of Rcpp the forest uses outside of the R interface,
+// so the benchmark can be built without R. Output goes to the console.
+#include <iostream>
+
+namespace Rcpp {
+  static std::ostream& Rcout = std::cout;
+  static std::ostream& Rcerr = std::cerr;
+}
+
+inline void R_FlushConsole() {
+  std::cout.flush();
+}
+
+inline void R_ProcessEvents() {}
+
+inline void R_CheckUserInterrupt() {}
+
+#endif //FORESTRYCPP_BENCHMARK_RCPP_H
@@ -0,0 +1,12 @@
+#ifndef FORESTRYCPP_BENCHMARK_RCPPTHREAD_H
+#define FORESTRYCPP_BENCHMARK_RCPPTHREAD_H
+
+// Stands in for the console output of RcppThread when building the benchmark
+// without R
+#include "Rcpp.h"
+
+namespace RcppThread {
+  static std::ostream& Rcout = std::cout;
+}
+
+#endif //FORESTRYCPP_BENCHMARK_RCPPTHREAD_H
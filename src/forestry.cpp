@@ -3,12 +3,20 @@
 #include "forestry.h"
 #include "utils.h"
 #include "sampling.h"
+#include "threadPool.h"
+#include "mappedFile.h"
 #include <RcppThread.h>
 #include <random>
 #include <algorithm>
 #include <thread>
 #include <mutex>
 #include <armadillo>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <set>
 #define DOPARELLEL true
 
 
@@ -17,7 +25,9 @@ forestry::forestry():
   _splitRatio(0),_OOBhonest(0),_mtry(0), _minNodeSizeSpt(0), _minNodeSizeAvg(0),
   _minNodeSizeToSplitSpt(0), _minNodeSizeToSplitAvg(0), _minSplitGain(0),
   _maxDepth(0), _interactionDepth(0), _forest(nullptr), _seed(0), _verbose(0),
-  _nthread(0), _OOBError(0), _splitMiddle(0),_minTreesPerFold(0), _doubleTree(0){};
+  _nthread(0), _OOBError(0), _splitMiddle(0),_minTreesPerFold(0), _doubleTree(0),
+  _histogramSplit(0), _nodeParallelSize(0), _compactSplits(0), _inBagCounts(0),
+  _slim(0){};
 
 forestry::~forestry(){};
 
@@ -48,7 +58,12 @@ forestry::forestry(
   bool naDirection,
   bool linear,
   double overfitPenalty,
-  bool doubleTree
+  bool doubleTree,
+  bool histogramSplit,
+  size_t nodeParallelSize,
+  bool compactSplits,
+  bool inBagCounts,
+  size_t firstTree
 ){
   this->_trainingData = trainingData;
   this->_ntree = 0;
@@ -75,6 +90,11 @@ forestry::forestry(
   this->_linear = linear;
   this->_overfitPenalty = overfitPenalty;
   this->_doubleTree = doubleTree;
+  this->_histogramSplit = histogramSplit;
+  this->_nodeParallelSize = nodeParallelSize;
+  this->_compactSplits = compactSplits;
+  this->_inBagCounts = inBagCounts;
+  this->_slim = false;
   this->_naDirection = naDirection;
   this->_minTreesPerFold = minTreesPerFold;
   this->_foldSize = foldSize;
@@ -115,8 +135,12 @@ forestry::forestry(
   );
   this->_forest = std::move(forest);
 
-  // Create initial trees
-  addTrees(ntree);
+  // Create initial trees, a shard of a forest starts at its first tree
+  if (firstTree == 0) {
+    addTrees(ntree);
+  } else {
+    addTreeRange(firstTree, ntree);
+  }
 
   // Try sorting the forest by seed, this way we should do predict in the same order
   std::vector< std::unique_ptr< forestryTree > >* curr_forest;
@@ -131,9 +155,37 @@ forestry::forestry(
 
 }
 
+// Adds the OOB predictions a tree left in scratch to the running OOB sums
+static void addRunningOOB(
+    const oob_scratch &scratch,
+    std::vector<double> &runningOOBSums,
+    std::vector<size_t> &runningOOBCounts
+) {
+  for (size_t k = 0; k < scratch.OOBIndex.size(); k++) {
+    runningOOBSums[scratch.OOBIndex[k]] += scratch.OOBPrediction[k];
+    runningOOBCounts[scratch.OOBIndex[k]] += 1;
+  }
+}
+
 void forestry::addTrees(size_t ntree) {
+  growTrees(getNtree(), ntree, true);
+}
+
+void forestry::addTreeRange(size_t firstTree, size_t ntree) {
+  if (firstTree + ntree < firstTree ||
+      firstTree + ntree > (size_t) std::numeric_limits<unsigned int>::max()) {
+    throw std::runtime_error("The tree numbers are too large.");
+  }
+  growTrees(firstTree, ntree, false);
+}
+
+void forestry::growTrees(size_t firstTree, size_t ntree, bool growFoldTrees) {
+
+  if (isSlim() && ntree > 0) {
+    throw std::runtime_error("Trees cannot be added to slim forests.");
+  }
 
-  const unsigned int newStartingTreeNumber = (unsigned int) getNtree();
+  const unsigned int newStartingTreeNumber = (unsigned int) firstTree;
   unsigned int newEndingTreeNumber;
   size_t numToGrow, groupToGrow;
 
@@ -153,7 +205,7 @@ void forestry::addTrees(size_t ntree) {
     numToGrow = (unsigned int) getminTreesPerFold() * (numFolds);
     // Want to grow max(ntree, |groups|*minTreePerGroup) total trees
     groupToGrow = numToGrow;
-    numToGrow = std::max(numToGrow, ntree);
+    numToGrow = growFoldTrees ? std::max(numToGrow, ntree) : ntree;
 
     std::mt19937_64 group_assign_rng;
     group_assign_rng.seed(getSeed());
@@ -187,6 +239,14 @@ void forestry::addTrees(size_t ntree) {
   }
   const unsigned int see = this->getSeed();
 
+  // While the running OOB error is followed, each thread predicts the OOB
+  // observations of the trees it trains, one scratch space per tree of a pair
+  // when growing double trees, and adds them to the running sums
+  bool updateRunningOOB = !_runningOOBCounts.empty();
+  std::vector< oob_scratch > slotScratch(
+    updateRunningOOB ? 2 * std::max(nthreadToUse, 1u) : 0
+  );
+
   #if DOPARELLEL
   if (isVerbose()) {
     RcppThread::Rcout << "Training parallel using " << nthreadToUse << " threads"
@@ -196,19 +256,15 @@ void forestry::addTrees(size_t ntree) {
     R_CheckUserInterrupt();
   }
 
-  std::vector<std::thread> allThreads(nthreadToUse);
   std::mutex threadLock;
 
-  // For each thread, assign a sequence of tree numbers that the thread
-  // is responsible for handling
-  for (unsigned int t = 0; t < nthreadToUse; t++) {
-    auto dummyThread = std::bind(
-      [&](const unsigned int iStart, const unsigned int iEnd, const unsigned int t_) {
-
-        // loop over al assigned trees, iStart is the starting tree number
-        // and iEnd is the ending tree number
-
-        for (unsigned int i = iStart; i < iEnd; i++) {
+  // Trees are handed out one at a time by the shared thread pool, so threads
+  // which finish their trees early keep pulling the next one
+  getThreadPool().parallelFor(
+    newStartingTreeNumber,
+    newEndingTreeNumber,
+    nthreadToUse,
+    [&](const unsigned int i) {
   #else
   // For non-parallel version, just simply iterate all trees serially
   for (unsigned int i=newStartingTreeNumber; i<newEndingTreeNumber; i++) {
@@ -230,6 +286,8 @@ void forestry::addTrees(size_t ntree) {
           std::vector<size_t> splitIndicesFill;
           std::vector<size_t> avgIndicesFill;
 
+          phaseTimer samplingTimer(&_instrumentation, PHASE_SAMPLING);
+
           // Generate the splitting and averaging indices for the ith tree
           generate_sample_indices(
                   splitIndicesFill,
@@ -267,8 +325,12 @@ void forestry::addTrees(size_t ntree) {
                 );
           }
 
+          samplingTimer.stop();
+
           try{
 
+            phaseTimer growingTimer(&_instrumentation, PHASE_GROWING);
+
             forestryTree *oneTree(
               new forestryTree(
                 getTrainingData(),
@@ -289,7 +351,12 @@ void forestry::addTrees(size_t ntree) {
                 getNaDirection(),
                 getlinear(),
                 getOverfitPenalty(),
-                myseed
+                myseed,
+                getHistogramSplit(),
+                getNodeParallelSize(),
+                getCompactSplits(),
+                getInBagCounts(),
+                nthreadToUse
               )
             );
 
@@ -315,10 +382,45 @@ void forestry::addTrees(size_t ntree) {
                     getNaDirection(),
                     getlinear(),
                     getOverfitPenalty(),
-                    myseed
+                    myseed,
+                    getHistogramSplit(),
+                    getNodeParallelSize(),
+                    getCompactSplits(),
+                    getInBagCounts(),
+                    nthreadToUse
                  );
             }
 
+            growingTimer.stop();
+
+            oob_scratch* scratch = nullptr;
+            if (updateRunningOOB) {
+              phaseTimer runningOOBTimer(&_instrumentation, PHASE_RUNNING_OOB);
+              scratch = &slotScratch[2 * forestryThreadPool::getSlot()];
+              oneTree->getOOBPrediction(
+                scratch[0],
+                getTrainingData(),
+                getOOBhonest(),
+                false,
+                getMinNodeSizeToSplitAvg(),
+                nullptr,
+                nullptr,
+                std::vector<size_t>()
+              );
+              if (_doubleTree) {
+                anotherTree->getOOBPrediction(
+                  scratch[1],
+                  getTrainingData(),
+                  getOOBhonest(),
+                  false,
+                  getMinNodeSizeToSplitAvg(),
+                  nullptr,
+                  nullptr,
+                  std::vector<size_t>()
+                );
+              }
+            }
+
             #if DOPARELLEL
             std::lock_guard<std::mutex> lock(threadLock);
             #endif
@@ -327,6 +429,28 @@ void forestry::addTrees(size_t ntree) {
               std::cout << "Finish training tree # " << (i + 1) << std::endl;
             }
 
+            if (scratch) {
+              addRunningOOB(scratch[0], _runningOOBSums, _runningOOBCounts);
+              if (_doubleTree) {
+                addRunningOOB(scratch[1], _runningOOBSums, _runningOOBCounts);
+              }
+            }
+
+            if (isInstrumentationEnabled()) {
+              _instrumentation.treesGrown += _doubleTree ? 2 : 1;
+              _instrumentation.nodesGrown += oneTree->getNodeCount();
+              _instrumentation.featuresEvaluated +=
+                oneTree->getFeaturesEvaluated();
+              _instrumentation.bytesAllocated += oneTree->getMemoryUsage();
+              if (_doubleTree) {
+                _instrumentation.nodesGrown += anotherTree->getNodeCount();
+                _instrumentation.featuresEvaluated +=
+                  anotherTree->getFeaturesEvaluated();
+                _instrumentation.bytesAllocated +=
+                  anotherTree->getMemoryUsage();
+              }
+            }
+
             (*getForest()).emplace_back(oneTree);
             _ntree = _ntree + 1;
             if (_doubleTree) {
@@ -341,27 +465,170 @@ void forestry::addTrees(size_t ntree) {
 
         }
   #if DOPARELLEL
-      },
-      newStartingTreeNumber + t * numToGrow / nthreadToUse,
-      (t + 1) == nthreadToUse ?
-        (unsigned int) newEndingTreeNumber :
-           newStartingTreeNumber + (t + 1) * numToGrow / nthreadToUse,
-           t
-    );
+  );
+  #endif
+}
 
-    allThreads[t] = std::thread(dummyThread);
+// Whether two data frames hold the same feature values, where missing values
+// are equal to each other
+static bool sameFeatureData(DataFrame* data, DataFrame* otherData) {
+  if (data == otherData) {
+    return true;
+  }
+  if (data->getNumRows() != otherData->getNumRows() ||
+      data->getNumColumns() != otherData->getNumColumns()) {
+    return false;
+  }
+  for (size_t j = 0; j < data->getNumColumns(); j++) {
+    const column_view* column = data->getFeatureData(j);
+    const column_view* otherColumn = otherData->getFeatureData(j);
+    for (size_t i = 0; i < data->getNumRows(); i++) {
+      double value = (*column)[i];
+      double otherValue = (*otherColumn)[i];
+      if (value != otherValue &&
+          !(std::isnan(value) && std::isnan(otherValue))) {
+        return false;
+      }
+    }
   }
+  return true;
+}
 
-  std::for_each(
-    allThreads.begin(),
-    allThreads.end(),
-    [](std::thread& x){x.join();}
-  );
-  #endif
+bool forestry::sameGrowthParameters(forestry* other) {
+  DataFrame* data = getTrainingData();
+  DataFrame* otherData = other->getTrainingData();
+  return other->_seed == _seed &&
+    other->_replace == _replace &&
+    other->_sampSize == _sampSize &&
+    other->_splitRatio == _splitRatio &&
+    other->_OOBhonest == _OOBhonest &&
+    other->_doubleBootstrap == _doubleBootstrap &&
+    other->_mtry == _mtry &&
+    other->_minNodeSizeSpt == _minNodeSizeSpt &&
+    other->_minNodeSizeAvg == _minNodeSizeAvg &&
+    other->_minNodeSizeToSplitSpt == _minNodeSizeToSplitSpt &&
+    other->_minNodeSizeToSplitAvg == _minNodeSizeToSplitAvg &&
+    other->_minSplitGain == _minSplitGain &&
+    other->_maxDepth == _maxDepth &&
+    other->_interactionDepth == _interactionDepth &&
+    other->_splitMiddle == _splitMiddle &&
+    other->_maxObs == _maxObs &&
+    other->_minTreesPerFold == _minTreesPerFold &&
+    other->_foldSize == _foldSize &&
+    other->_hasNas == _hasNas &&
+    other->_naDirection == _naDirection &&
+    other->_linear == _linear &&
+    other->_overfitPenalty == _overfitPenalty &&
+    other->_doubleTree == _doubleTree &&
+    other->_histogramSplit == _histogramSplit &&
+    other->_nodeParallelSize == _nodeParallelSize &&
+    other->_compactSplits == _compactSplits &&
+    other->_inBagCounts == _inBagCounts &&
+    other->_slim == _slim &&
+    *(otherData->getCatCols()) == *(data->getCatCols()) &&
+    *(otherData->getLinCols()) == *(data->getLinCols()) &&
+    *(otherData->getfeatureWeights()) == *(data->getfeatureWeights()) &&
+    *(otherData->getfeatureWeightsVariables()) ==
+      *(data->getfeatureWeightsVariables()) &&
+    *(otherData->getdeepFeatureWeights()) == *(data->getdeepFeatureWeights()) &&
+    *(otherData->getdeepFeatureWeightsVariables()) ==
+      *(data->getdeepFeatureWeightsVariables()) &&
+    *(otherData->getobservationWeights()) == *(data->getobservationWeights()) &&
+    *(otherData->getMonotonicConstraints()) ==
+      *(data->getMonotonicConstraints()) &&
+    otherData->getMonotoneAvg() == data->getMonotoneAvg() &&
+    *(otherData->getGroups()) == *(data->getGroups());
+}
+
+void forestry::mergeForests(const std::vector< forestry* > &shards) {
+
+  // Check every shard before moving any tree, so a failed merge leaves all
+  // forests as they were
+  std::set<unsigned int> treeSeeds;
+  for (size_t i = 0; i < getNtree(); i++) {
+    treeSeeds.insert((*getForest())[i]->getSeed());
+  }
+
+  bool mergeRunningOOB = !_runningOOBCounts.empty();
+  for (size_t s = 0; s < shards.size(); s++) {
+    forestry* shard = shards[s];
+    if (shard == this ||
+        std::find(shards.begin(), shards.begin() + s, shard) !=
+          shards.begin() + s) {
+      throw std::runtime_error("A forest cannot be merged more than once.");
+    }
+    if (shard->getNtrain() != getNtrain() ||
+        shard->getTrainingData()->getNumColumns() !=
+          getTrainingData()->getNumColumns() ||
+        *(shard->getTrainingData()->getOutcomeData()) !=
+          *(getTrainingData()->getOutcomeData()) ||
+        !sameFeatureData(shard->getTrainingData(), getTrainingData())) {
+      throw std::runtime_error("The forests were not trained on the same data.");
+    }
+    if (!sameGrowthParameters(shard)) {
+      throw std::runtime_error("The forests were not grown with the same seed and parameters.");
+    }
+
+    // Both trees of a double tree carry the seed of their tree number
+    std::set<unsigned int> shardSeeds;
+    for (size_t i = 0; i < shard->getNtree(); i++) {
+      shardSeeds.insert((*shard->getForest())[i]->getSeed());
+    }
+    for (std::set<unsigned int>::iterator seed = shardSeeds.begin();
+         seed != shardSeeds.end();
+         ++seed) {
+      if (!treeSeeds.insert(*seed).second) {
+        throw std::runtime_error("The forests contain the same trees.");
+      }
+    }
+
+    mergeRunningOOB = mergeRunningOOB && !shard->_runningOOBCounts.empty();
+  }
+
+  // The running OOB sums are sums over the trees, so those of the shards are
+  // added when every forest has them and summed again later otherwise
+  if (mergeRunningOOB) {
+    for (size_t s = 0; s < shards.size(); s++) {
+      for (size_t j = 0; j < _runningOOBCounts.size(); j++) {
+        _runningOOBSums[j] += shards[s]->_runningOOBSums[j];
+        _runningOOBCounts[j] += shards[s]->_runningOOBCounts[j];
+      }
+    }
+  } else {
+    std::vector<double>().swap(_runningOOBSums);
+    std::vector<size_t>().swap(_runningOOBCounts);
+  }
+
+  for (size_t s = 0; s < shards.size(); s++) {
+    forestry* shard = shards[s];
+    std::vector< std::unique_ptr< forestryTree > >* shardForest =
+      shard->getForest();
+    for (size_t i = 0; i < shardForest->size(); i++) {
+      (*getForest()).push_back(std::move((*shardForest)[i]));
+      _ntree = _ntree + 1;
+    }
+    shardForest->clear();
+    shard->_ntree = 0;
+    std::vector<double>().swap(shard->_runningOOBSums);
+    std::vector<size_t>().swap(shard->_runningOOBCounts);
+    shard->_OOBError = 0;
+  }
+
+  // The OOB error of the trees before the merge is stale and is calculated
+  // again over all trees when it is next asked for
+  _OOBError = 0;
+
+  // Keep the trees sorted by seed as after training
+  std::vector< std::unique_ptr< forestryTree > >* curr_forest;
+  curr_forest = this->getForest();
+  std::stable_sort(curr_forest->begin(), curr_forest->end(), [](const std::unique_ptr< forestryTree >& a,
+                                                                const std::unique_ptr< forestryTree >& b) {
+    return a.get()->getSeed() > b.get()->getSeed();
+  });
 }
 
 std::unique_ptr< std::vector<double> > forestry::predict(
-  std::vector< std::vector<double> >* xNew,
+  std::vector<column_view>* xNew,
   arma::Mat<double>* weightMatrix,
   arma::Mat<double>* coefficients,
   arma::Mat<int>* terminalNodes,
@@ -369,11 +636,34 @@ std::unique_ptr< std::vector<double> > forestry::predict(
   size_t nthread,
   bool exact,
   bool use_weights,
-  std::vector<size_t>* tree_weights
+  std::vector<size_t>* tree_weights,
+  const weight_row_consumer* weightRows
 ){
 
+  if (isSlim() && (weightMatrix || weightRows)) {
+    throw std::runtime_error("The weightMatrix is not available for slim forests.");
+  }
+
+  phaseTimer predictTimer(
+    &_instrumentation,
+    (weightMatrix || weightRows) ? PHASE_WEIGHT_MATRIX : PHASE_PREDICT
+  );
+
+  // Compact forests were grown on the features rounded to floats, so the new
+  // observations are rounded the same way before they meet the thresholds
+  std::vector< std::vector<float> > floatData;
+  std::vector<column_view> floatColumns;
+  if (getCompactSplits()) {
+    floatColumns = make_float_column_views(*xNew, floatData);
+    xNew = &floatColumns;
+  }
+
   size_t numObservations = (*xNew)[0].size();
   std::vector<double> prediction(numObservations,0.0);
+  if (isInstrumentationEnabled()) {
+    _instrumentation.rowsPredicted += numObservations;
+    _instrumentation.bytesAllocated += numObservations * sizeof(double);
+  }
 
 
   // If using weights, we need to initialize this
@@ -402,11 +692,9 @@ std::unique_ptr< std::vector<double> > forestry::predict(
     }
   }
 
-  // Only needed if exact = TRUE, vector for storing each tree's predictions
-  std::vector< std::vector<double> > tree_preds;
-  std::vector< std::vector<int> > tree_nodes;
-  std::vector<size_t> tree_seeds;
-  std::vector<size_t> tree_total_nodes;
+  // Without exact = TRUE, each thread sums the trees it predicts into its own
+  // slot and the slots are added up once all trees are done
+  size_t threadSlots = 1;
 
   #if DOPARELLEL
   size_t nthreadToUse = nthread;
@@ -415,6 +703,7 @@ std::unique_ptr< std::vector<double> > forestry::predict(
     // Use all threads
     nthreadToUse = std::thread::hardware_concurrency();
   }
+  threadSlots = std::max(nthreadToUse, (size_t) 1);
 
   if (isVerbose()) {
     std::cout << "Prediction parallel using " << nthreadToUse << " threads"
@@ -425,51 +714,94 @@ std::unique_ptr< std::vector<double> > forestry::predict(
     }
   }
 
-  std::vector<std::thread> allThreads(nthreadToUse);
-  std::mutex threadLock;
+  #endif
 
-  // For each thread, assign a sequence of tree numbers that the thread
-  // is responsible for handling
-  for (size_t t = 0; t < nthreadToUse; t++) {
-    auto dummyThread = std::bind(
-      [&](const int iStart, const int iEnd, const int t_) {
+  std::vector< std::vector<double> > slotPredictions(threadSlots);
+  std::vector< arma::Mat<double> > slotCoefficients(threadSlots);
+  // The coefficients of the tree a thread is predicting with, one row per
+  // observation. The rows keep their space from one tree to the next.
+  std::vector< std::vector< std::vector<double> > > slotTreeCoefficients(
+      coefficients ? threadSlots : 0);
+
+  // For the weight matrix each tree records the leaf of every observation, the
+  // rows are built from these records once all trees are done
+  bool buildWeights = weightMatrix || weightRows;
+  std::vector< comembership_info > treeComembership(buildWeights ? getNtree() : 0);
+
+  // With exact = TRUE the trees are handed out by decreasing seed and summed in
+  // this order as soon as the trees before them are, so only the predictions
+  // of a window of trees are kept at the same time
+  std::vector<size_t> exactOrder;
+  if (exact) {
+    exactOrder.resize(getNtree());
+    std::iota(exactOrder.begin(), exactOrder.end(), 0);
+    std::sort(exactOrder.begin(), exactOrder.end(),
+              [&](size_t a, size_t b) -> bool {
+                return (*getForest())[a]->getSeed() > (*getForest())[b]->getSeed();
+              });
+  }
+  size_t exactWindow = exact ? 2 * threadSlots : 0;
+  std::vector< std::vector<double> > windowPredictions(exactWindow);
+  std::vector<char> windowPredicted(exactWindow, 0);
+  std::function<void(size_t)> foldExactTree = [&](size_t rank) {
+    size_t windowSlot = rank % exactWindow;
+    if (!windowPredicted[windowSlot]) {
+      return;
+    }
+    double cur_weight = use_weights ? (double) (*tree_weights)[rank] : (double) 1.0;
+    const std::vector<double> &treePrediction = windowPredictions[windowSlot];
+    for (size_t j = 0; j < numObservations; j++) {
+      prediction[j] += cur_weight * treePrediction[j];
+    }
+  };
+  orderedFold exactFold(0, exactWindow, foldExactTree);
 
-        // loop over al assigned trees, iStart is the starting tree number
-        // and iEnd is the ending tree number
-        for (int i=iStart; i < iEnd; i++) {
+  #if DOPARELLEL
+  // Trees are handed out one at a time by the shared thread pool
+  getThreadPool().parallelFor(
+    0,
+    getNtree(),
+    nthreadToUse,
+    [&](const int rank) {
   #else
   // For non-parallel version, just simply iterate all trees serially
-  for(int i=0; i<((int) getNtree()); i++ ) {
+  for(int rank=0; rank<((int) getNtree()); rank++ ) {
   #endif
+          size_t i = exact ? exactOrder[rank] : rank;
+          if (exact) {
+            exactFold.start(rank);
+            windowPredicted[rank % exactWindow] = 0;
+          }
           try {
             std::vector<double> currentTreePrediction(numObservations);
             std::vector<int> currentTreeTerminalNodes(numObservations);
-            std::vector< std::vector<double> > currentTreeCoefficients(numObservations);
+            // Stays empty when the coefficients are not requested, so the
+            // ridge leaves skip copying them
+            std::vector< std::vector<double> > noCoefficients;
+            std::vector< std::vector<double> > &currentTreeCoefficients =
+              coefficients ?
+              slotTreeCoefficients[forestryThreadPool::getSlot()] :
+              noCoefficients;
+            if (coefficients) {
+              currentTreeCoefficients.resize(numObservations);
+            }
 
             //If terminal nodes, pass option to tree predict
             forestryTree *currentTree = (*getForest())[i].get();
 
-            if (use_weights && (tree_weights->at(i) == (size_t) 0)) {
+            comembership_info* currentComembership = nullptr;
+            if (buildWeights) {
+              currentComembership = &treeComembership[i];
+              currentComembership->leafOfRow.assign(numObservations,
+                                                    comembership_info::NO_LEAF);
+            }
+
+            // With exact = TRUE the weights are taken in the order of the
+            // seeds, as they are when the predictions are summed
+            if (use_weights &&
+                (tree_weights->at(exact ? rank : i) == (size_t) 0)) {
               // If weight for the tree is zero, don't predict with that tree
               std::fill(currentTreePrediction.begin(), currentTreePrediction.end(), 0);
-            } else if (coefficients) {
-              for (size_t l=0; l<numObservations; l++) {
-                currentTreeCoefficients[l] = std::vector<double>(coefficients->n_cols);
-              }
-
-              (*currentTree).predict(
-                  currentTreePrediction,
-                  &currentTreeTerminalNodes,
-                  currentTreeCoefficients,
-                  xNew,
-                  getTrainingData(),
-                  weightMatrix,
-                  getlinear(),
-                  getNaDirection(),
-                  seed + i,
-                  getMinNodeSizeToSplitAvg()
-              );
-
             } else {
               (*currentTree).predict(
                   currentTreePrediction,
@@ -477,7 +809,7 @@ std::unique_ptr< std::vector<double> > forestry::predict(
                   currentTreeCoefficients,
                   xNew,
                   getTrainingData(),
-                  weightMatrix,
+                  currentComembership,
                   getlinear(),
                   getNaDirection(),
                   seed + i,
@@ -486,57 +818,51 @@ std::unique_ptr< std::vector<double> > forestry::predict(
 
             }
 
-            // HERE IF NEED TERMINAL NODES, pass option to tree predict, then
-            // lock thread (shouldn't really need to), use i as offset and flip
-            // bool of matrix
-
-            #if DOPARELLEL
-            std::lock_guard<std::mutex> lock(threadLock);
-            # endif
-
-            // If we need to use the exact seeding order we save the tree
-            // predictions and the tree seeds
-
-            // For now store tree seeds even when not running exact,
-            // hopefully this solves a valgrind error relating to the sorting
-            // based on tree seeds when tree seeds might be uninitialized
-            tree_seeds.push_back(currentTree->getSeed());
+            // The terminal nodes of tree i always go to column i, which no
+            // other tree writes to
+            if (terminalNodes && (exact || !use_weights)) {
+              for (size_t k = 0; k < numObservations; k++) {
+                (*terminalNodes)(k, i) = currentTreeTerminalNodes[k];
+              }
+              (*terminalNodes)(numObservations, i) = (*currentTree).getNodeCount();
+            }
 
+            // With the exact seeding order the prediction waits in the window
+            // until it is summed
             if (exact) {
-              tree_preds.push_back(currentTreePrediction);
-              tree_nodes.push_back(currentTreeTerminalNodes);
-              tree_total_nodes.push_back(currentTree->getNodeCount());
-            } else {
-              if (!use_weights) {
+              windowPredictions[rank % exactWindow] =
+                std::move(currentTreePrediction);
+              windowPredicted[rank % exactWindow] = 1;
+            } else if (!use_weights || tree_weights->at(i) != (size_t) 0) {
+              double treeWeight = use_weights ?
+                (double) tree_weights->at(i) : (double) 1.0;
+              size_t slot = forestryThreadPool::getSlot();
+
+              std::vector<double> &slotPrediction = slotPredictions[slot];
+              if (slotPrediction.empty()) {
+                slotPrediction.assign(numObservations, 0.0);
+              }
+              if (use_weights) {
                 for (size_t j = 0; j < numObservations; j++) {
-                  prediction[j] += currentTreePrediction[j];
+                  slotPrediction[j] += treeWeight * currentTreePrediction[j];
                 }
-
-                if (coefficients) {
-                  for (size_t k = 0; k < numObservations; k++) {
-                    for (size_t l = 0; l < coefficients->n_cols; l++) {
-                      (*coefficients)(k,l) += currentTreeCoefficients[k][l];
-                    }
-                  }
+              } else {
+                for (size_t j = 0; j < numObservations; j++) {
+                  slotPrediction[j] += currentTreePrediction[j];
                 }
+              }
 
-                if (terminalNodes) {
-                  for (size_t k = 0; k < numObservations; k++) {
-                    (*terminalNodes)(k, i) = currentTreeTerminalNodes[k];
-                  }
-                  (*terminalNodes)(numObservations, i) = (*currentTree).getNodeCount();
+              if (coefficients) {
+                arma::Mat<double> &slotCoefficient = slotCoefficients[slot];
+                if (slotCoefficient.n_elem == 0) {
+                  slotCoefficient.zeros(numObservations, coefficients->n_cols);
                 }
-              } else {
-                if (tree_weights->at(i) != (size_t) 0) {
-                  for (size_t j = 0; j < numObservations; j++) {
-                    prediction[j] += ((double) tree_weights->at(i)) * currentTreePrediction[j];
-                  }
-
-                  if (coefficients) {
-                    for (size_t k = 0; k < numObservations; k++) {
-                      for (size_t l = 0; l < coefficients->n_cols; l++) {
-                        (*coefficients)(k,l) += ((double) tree_weights->at(i)) * currentTreeCoefficients[k][l];
-                      }
+                for (size_t k = 0; k < numObservations; k++) {
+                  for (size_t l = 0; l < coefficients->n_cols; l++) {
+                    if (use_weights) {
+                      slotCoefficient(k,l) += treeWeight * currentTreeCoefficients[k][l];
+                    } else {
+                      slotCoefficient(k,l) += currentTreeCoefficients[k][l];
                     }
                   }
                 }
@@ -545,57 +871,31 @@ std::unique_ptr< std::vector<double> > forestry::predict(
 
           } catch (std::runtime_error &err) {
             std::cerr << err.what() << std::endl;
+          } catch (...) {
+            if (exact) {
+              exactFold.finish(rank);
+            }
+            throw;
+          }
+          if (exact) {
+            exactFold.finish(rank);
           }
       }
   #if DOPARELLEL
-      },
-      t * getNtree() / nthreadToUse,
-      (t + 1) == nthreadToUse ?
-        getNtree() :
-        (t + 1) * getNtree() / nthreadToUse,
-      t
-    );
-    allThreads[t] = std::thread(dummyThread);
-  }
-
-  std::for_each(
-    allThreads.begin(),
-    allThreads.end(),
-    [](std::thread& x) { x.join(); }
   );
   #endif
 
-  // If exact, we need to aggregate the predictions by tree seed order.
-  if (exact) {
-    std::vector<size_t> indices(tree_seeds.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    //Order the indices by the seeds of the corresponding trees
-    std::sort(indices.begin(), indices.end(),
-              [&](size_t a, size_t b) -> bool {
-                return tree_seeds[a] > tree_seeds[b];
-              });
-
-    size_t weight_index = 0;
-    // Now aggregate using the new index ordering
-    for (std::vector<size_t>::iterator iter = indices.begin();
-        iter != indices.end();
-        ++iter)
-    {
-        size_t cur_index  = *iter;
-
-        double cur_weight = use_weights ? (double) (*tree_weights)[weight_index] : (double) 1.0;
-        weight_index++;
-        // Aggregate all predictions for current tree
+  if (!exact) {
+    // Add up the per thread sums in slot order
+    for (size_t slot = 0; slot < threadSlots; slot++) {
+      if (!slotPredictions[slot].empty()) {
         for (size_t j = 0; j < numObservations; j++) {
-          prediction[j] += cur_weight * tree_preds[cur_index][j];
-        }
-
-        if (terminalNodes) {
-          for (size_t k = 0; k < numObservations; k++) {
-            (*terminalNodes)(k, cur_index) = tree_nodes[cur_index][k];
-          }
-          (*terminalNodes)(numObservations, cur_index) = tree_total_nodes[cur_index];
+          prediction[j] += slotPredictions[slot][j];
         }
+      }
+      if (coefficients && slotCoefficients[slot].n_elem != 0) {
+        (*coefficients) += slotCoefficients[slot];
+      }
     }
   }
 
@@ -607,16 +907,28 @@ std::unique_ptr< std::vector<double> > forestry::predict(
     new std::vector<double>(prediction)
   );
 
-  // If we also update the weight matrix, we now have to divide every entry
-  // by the number of trees:
-  if (weightMatrix) {
-    size_t nrow = (*xNew)[0].size();      // number of features to be predicted
-    size_t ncol = getNtrain();            // number of train data
-    for ( size_t i = 0; i < nrow; i++) {
-      for (size_t j = 0; j < ncol; j++) {
-        (*weightMatrix)(i,j) = (*weightMatrix)(i,j) / total_weights;
-      }
-    }
+  // If we also build the weight matrix, every entry is divided by the number of
+  // trees
+  if (buildWeights) {
+    std::vector<double> rowTotals(numObservations, total_weights);
+    reduceWeightRows(
+      treeComembership,
+      rowTotals,
+      nthread,
+      [&](size_t row,
+          const std::vector<size_t> &columns,
+          const std::vector<double> &weights) {
+        if (weightMatrix) {
+          for (size_t k = 0; k < columns.size(); k++) {
+            (*weightMatrix)(row, columns[k]) = weights[k];
+          }
+        }
+        if (weightRows) {
+          (*weightRows)(row, columns, weights);
+        }
+      },
+      use_weights ? tree_weights : NULL
+    );
   }
 
   if (coefficients) {
@@ -631,31 +943,290 @@ std::unique_ptr< std::vector<double> > forestry::predict(
 }
 
 
+double forestry::predictRow(
+  std::vector<double>* xNew,
+  unsigned int seed
+){
+  // Predicts a single observation, given as one value per feature, by walking
+  // the node table of every tree. The trees are kept sorted by seed, so the
+  // sum is taken in the same order as predict with exact = TRUE.
+  if (getlinear()) {
+    throw std::runtime_error("predictRow does not support ridge forests.");
+  }
+  if (xNew->size() != getTrainingData()->getNumColumns()) {
+    throw std::runtime_error("xNew must contain one value per feature.");
+  }
+
+  // The values are rounded to floats as in predict
+  std::vector<double> floatRow;
+  if (getCompactSplits()) {
+    floatRow.resize(xNew->size());
+    for (size_t j = 0; j < xNew->size(); j++) {
+      floatRow[j] = (double) (float) (*xNew)[j];
+    }
+    xNew = &floatRow;
+  }
+
+  double prediction = 0;
+  for (size_t i = 0; i < getNtree(); i++) {
+    prediction += (*getForest())[i]->predictRow(
+      xNew,
+      getNaDirection(),
+      seed + i
+    );
+  }
+  return prediction / ((double) getNtree());
+}
+
+std::unique_ptr< leaf_assignment > forestry::assignLeaves(
+    std::vector<column_view>* xNew,
+    unsigned int seed,
+    size_t nthread,
+    bool keepComembership
+){
+  // Ridge leaves predict from the features, not from the leaf alone
+  if (getlinear()) {
+    throw std::runtime_error("The leaves cannot be aggregated for ridge forests.");
+  }
+  if (isSlim() && keepComembership) {
+    throw std::runtime_error("The weightMatrix is not available for slim forests.");
+  }
+
+  // The new observations are rounded to floats as in predict
+  std::vector< std::vector<float> > floatData;
+  std::vector<column_view> floatColumns;
+  if (getCompactSplits()) {
+    floatColumns = make_float_column_views(*xNew, floatData);
+    xNew = &floatColumns;
+  }
+
+  size_t numObservations = (*xNew)[0].size();
+  std::unique_ptr< leaf_assignment > leaves(new leaf_assignment);
+  leaves->terminalNodes.zeros(numObservations + 1, getNtree());
+  leaves->treeComembership.resize(keepComembership ? getNtree() : 0);
+
+  size_t nthreadToUse = nthread;
+  if (nthreadToUse == 0) {
+    // Use all threads
+    nthreadToUse = std::thread::hardware_concurrency();
+  }
+
+  #if DOPARELLEL
+  getThreadPool().parallelFor(
+    0,
+    getNtree(),
+    nthreadToUse,
+    [&](const int i) {
+  #else
+  for(int i=0; i<((int) getNtree()); i++ ) {
+  #endif
+        forestryTree *currentTree = (*getForest())[i].get();
+        std::vector<double> currentTreePrediction(numObservations);
+        std::vector<int> currentTreeTerminalNodes(numObservations);
+        std::vector< std::vector<double> > noCoefficients;
+
+        comembership_info* currentComembership = nullptr;
+        if (keepComembership) {
+          currentComembership = &leaves->treeComembership[i];
+          currentComembership->leafOfRow.assign(numObservations,
+                                                comembership_info::NO_LEAF);
+        }
+
+        // The seed of each tree is the one predict gives it, so missing
+        // values take the same directions
+        currentTree->predict(
+          currentTreePrediction,
+          &currentTreeTerminalNodes,
+          noCoefficients,
+          xNew,
+          getTrainingData(),
+          currentComembership,
+          false,
+          getNaDirection(),
+          seed + i,
+          getMinNodeSizeToSplitAvg()
+        );
+
+        // Tree i only writes to column i
+        for (size_t k = 0; k < numObservations; k++) {
+          leaves->terminalNodes(k, i) = currentTreeTerminalNodes[k];
+        }
+        leaves->terminalNodes(numObservations, i) = currentTree->getNodeCount();
+      }
+  #if DOPARELLEL
+  );
+  #endif
+
+  return leaves;
+}
+
+std::unique_ptr< std::vector<double> > forestry::predictLeaves(
+    const leaf_assignment &leaves,
+    arma::Mat<double>* weightMatrix,
+    size_t nthread,
+    bool use_weights,
+    std::vector<size_t>* tree_weights,
+    const weight_row_consumer* weightRows
+){
+  const arma::Mat<int> &terminalNodes = leaves.terminalNodes;
+  if (terminalNodes.n_cols != getNtree() || terminalNodes.n_rows == 0) {
+    throw std::runtime_error("The leaves were assigned by a forest with a different number of trees.");
+  }
+  bool buildWeights = weightMatrix || weightRows;
+  if (buildWeights && leaves.treeComembership.size() != getNtree()) {
+    throw std::runtime_error("The leaves were assigned without the weightMatrix.");
+  }
+  size_t numObservations = terminalNodes.n_rows - 1;
+
+  // The prediction of every leaf of every tree, by node id
+  std::vector< std::vector<double> > leafPredictions(getNtree());
+  for (size_t i = 0; i < getNtree(); i++) {
+    node_table* nodeTable = (*getForest())[i]->getNodeTable();
+    if (!nodeTable) {
+      throw std::runtime_error("The tree has no node table to predict with.");
+    }
+    std::vector<double> &treeLeafPredictions = leafPredictions[i];
+    for (size_t k = 0; k < nodeTable->splitFeature.size(); k++) {
+      if (nodeTable->splitFeature[k] < 0) {
+        size_t nodeId = nodeTable->nodeId[k];
+        if (nodeId >= treeLeafPredictions.size()) {
+          treeLeafPredictions.resize(nodeId + 1, 0.0);
+        }
+        treeLeafPredictions[nodeId] = nodeTable->splitValue[k];
+      }
+    }
+  }
+
+  double total_weights = 0.0;
+  for (size_t i = 0; i < getNtree(); i++) {
+    total_weights += use_weights ? (double) (*tree_weights)[i] : (double) 1.0;
+  }
+
+  // Sum the trees by decreasing seed, as predict does with exact = TRUE. As
+  // there, the tree weights are taken in this order.
+  std::vector<size_t> treeOrder(getNtree());
+  std::iota(treeOrder.begin(), treeOrder.end(), 0);
+  std::stable_sort(treeOrder.begin(), treeOrder.end(),
+                   [&](size_t a, size_t b) -> bool {
+                     return (*getForest())[a]->getSeed() > (*getForest())[b]->getSeed();
+                   });
+
+  std::vector<double> prediction(numObservations, 0.0);
+
+  // The observations are handed out in blocks, which read each column of the
+  // terminal nodes contiguously
+  const size_t blockSize = 256;
+  size_t numBlocks = (numObservations + blockSize - 1) / blockSize;
+
+  size_t nthreadToUse = nthread;
+  if (nthreadToUse == 0) {
+    // Use all threads
+    nthreadToUse = std::thread::hardware_concurrency();
+  }
+
+  #if DOPARELLEL
+  getThreadPool().parallelFor(
+    0,
+    numBlocks,
+    nthreadToUse,
+    [&](const size_t block) {
+  #else
+  for (size_t block = 0; block < numBlocks; block++) {
+  #endif
+        size_t blockBegin = block * blockSize;
+        size_t blockEnd = std::min(blockBegin + blockSize, numObservations);
+        for (size_t t = 0; t < treeOrder.size(); t++) {
+          size_t i = treeOrder[t];
+          double treeWeight = use_weights ?
+            (double) (*tree_weights)[t] : (double) 1.0;
+          if (treeWeight == 0) {
+            continue;
+          }
+          const int* treeNodes = terminalNodes.colptr(i);
+          const std::vector<double> &treeLeafPredictions = leafPredictions[i];
+          for (size_t j = blockBegin; j < blockEnd; j++) {
+            prediction[j] += treeWeight * treeLeafPredictions[treeNodes[j]];
+          }
+        }
+        for (size_t j = blockBegin; j < blockEnd; j++) {
+          prediction[j] /= total_weights;
+        }
+      }
+  #if DOPARELLEL
+  );
+  #endif
+
+  if (buildWeights) {
+    std::vector<double> rowTotals(numObservations, total_weights);
+    reduceWeightRows(
+      leaves.treeComembership,
+      rowTotals,
+      nthread,
+      [&](size_t row,
+          const std::vector<size_t> &columns,
+          const std::vector<double> &weights) {
+        if (weightMatrix) {
+          for (size_t k = 0; k < columns.size(); k++) {
+            (*weightMatrix)(row, columns[k]) = weights[k];
+          }
+        }
+        if (weightRows) {
+          (*weightRows)(row, columns, weights);
+        }
+      },
+      use_weights ? tree_weights : NULL
+    );
+  }
+
+  return std::unique_ptr< std::vector<double> >(
+    new std::vector<double>(prediction)
+  );
+}
+
 std::vector<double> forestry::predictOOB(
-    std::vector< std::vector<double> >* xNew,
+    std::vector<column_view>* xNew,
     arma::Mat<double>* weightMatrix,
     std::vector<size_t>* treeCounts,
     bool doubleOOB,
     bool exact,
-    std::vector<size_t> &training_idx
+    std::vector<size_t> &training_idx,
+    const weight_row_consumer* weightRows
 ) {
 
+  if (isSlim()) {
+    throw std::runtime_error("OOB predictions are not available for slim forests.");
+  }
+
+  phaseTimer predictOOBTimer(&_instrumentation, PHASE_PREDICT_OOB);
+
+  // The new observations are rounded to floats as in predict
+  std::vector< std::vector<float> > floatData;
+  std::vector<column_view> floatColumns;
+  if (getCompactSplits() && xNew) {
+    floatColumns = make_float_column_views(*xNew, floatData);
+    xNew = &floatColumns;
+  }
+
   bool use_training_idx = !training_idx.empty();
   size_t numTrainingRows = getTrainingData()->getNumRows();
   size_t numObservations = use_training_idx ? training_idx.size() : numTrainingRows;
-  std::vector<double> outputOOBPrediction(numObservations);
-  std::vector<size_t> outputOOBCount(numObservations);
-
-  for (size_t i=0; i<numObservations; i++) {
-    outputOOBPrediction[i] = 0;
-    outputOOBCount[i] = 0;
+  if (isInstrumentationEnabled()) {
+    _instrumentation.rowsPredicted += numObservations;
+    _instrumentation.bytesAllocated +=
+      numObservations * (sizeof(double) + sizeof(size_t));
   }
+  std::vector<double> outputOOBPrediction(numObservations, 0.0);
+  std::vector<size_t> outputOOBCount(numObservations, 0);
 
-  // If we have been giving training indices for the xNew matrix, use these
+  // For the weight matrix each tree records the leaf of every observation, the
+  // rows are built from these records once all trees are done
+  bool buildWeights = weightMatrix || weightRows;
+  std::vector< comembership_info > treeComembership(buildWeights ? getNtree() : 0);
 
-  // Only needed if exact = TRUE, vector for storing each tree's predictions
-  std::vector< std::vector<double> > tree_preds;
-  std::vector<size_t> tree_seeds;
+  // Each thread sends the trees it is handed through its own scratch space and
+  // sums their predictions and counts into its own slot, the slots are added
+  // up once all trees are done
+  size_t threadSlots = 1;
 
     #if DOPARELLEL
       size_t nthreadToUse = getNthread();
@@ -663,259 +1234,583 @@ std::vector<double> forestry::predictOOB(
         // Use all threads
         nthreadToUse = std::thread::hardware_concurrency();
       }
+      threadSlots = std::max(nthreadToUse, (size_t) 1);
       if (isVerbose()) {
         std::cout << "Calculating OOB parallel using " << nthreadToUse << " threads"
                           << std::endl;
       }
-      std::vector<std::thread> allThreads(nthreadToUse);
-      std::mutex threadLock;
-
-      // For each thread, assign a sequence of tree numbers that the thread
-      // is responsible for handling
-      for (size_t t = 0; t < nthreadToUse; t++) {
-        auto dummyThread = std::bind(
-          [&](const int iStart, const int iEnd, const int t_) {
-            // loop over all items
-            for (int i=iStart; i < iEnd; i++) {
-    #else
-              // For non-parallel version, just simply iterate all trees serially
-              for(int i=0; i<((int) getNtree()); i++ ) {
     #endif
-                try {
-                  std::vector<double> outputOOBPrediction_iteration(numObservations);
-                  std::vector<size_t> outputOOBCount_iteration(numObservations);
-                  for (size_t j=0; j<numObservations; j++) {
-                    outputOOBPrediction_iteration[j] = 0;
-                    outputOOBCount_iteration[j] = 0;
-                  }
+
+  std::vector< oob_scratch > slotScratch(threadSlots);
+  std::vector< std::vector<double> > slotPredictions(threadSlots);
+  std::vector< std::vector<size_t> > slotCounts(threadSlots);
+
+  // With exact = TRUE every prediction is divided by the number of trees which
+  // predict its observation as it is summed, so these are counted first. The
+  // trees are then handed out by decreasing seed and summed in this order as
+  // soon as the trees before them are, so only the predictions of a window of
+  // trees are kept at the same time.
+  std::vector<size_t> exactOrder;
+  if (exact) {
+    exactOrder.resize(getNtree());
+    std::iota(exactOrder.begin(), exactOrder.end(), 0);
+    std::sort(exactOrder.begin(), exactOrder.end(),
+              [&](size_t a, size_t b) -> bool {
+                return (*getForest())[a]->getSeed() > (*getForest())[b]->getSeed();
+              });
+
+    #if DOPARELLEL
+      getThreadPool().parallelFor(
+        0,
+        getNtree(),
+        nthreadToUse,
+        [&](const int i) {
+    #else
+              for(int i=0; i<((int) getNtree()); i++ ) {
+    #endif
+                size_t slot = forestryThreadPool::getSlot();
+                oob_scratch &scratch = slotScratch[slot];
+                (*getForest())[i]->getOOBIndex(
+                    scratch,
+                    getTrainingData(),
+                    getOOBhonest(),
+                    doubleOOB,
+                    training_idx
+                );
+                std::vector<size_t> &slotCount = slotCounts[slot];
+                if (slotCount.empty()) {
+                  slotCount.assign(numObservations, 0);
+                }
+                for (size_t k = 0; k < scratch.OOBIndex.size(); k++) {
+                  slotCount[scratch.OOBIndex[k]] += 1;
+                }
+              }
+    #if DOPARELLEL
+      );
+    #endif
+
+    for (size_t slot = 0; slot < threadSlots; slot++) {
+      if (slotCounts[slot].empty()) {
+        continue;
+      }
+      for (size_t j = 0; j < numObservations; j++) {
+        outputOOBCount[j] += slotCounts[slot][j];
+      }
+      std::vector<size_t>().swap(slotCounts[slot]);
+    }
+  }
+
+  size_t exactWindow = exact ? 2 * threadSlots : 0;
+  std::vector< std::vector<size_t> > windowOOBIndex(exactWindow);
+  std::vector< std::vector<double> > windowPredictions(exactWindow);
+  std::vector<char> windowPredicted(exactWindow, 0);
+  std::function<void(size_t)> foldExactTree = [&](size_t rank) {
+    size_t windowSlot = rank % exactWindow;
+    if (!windowPredicted[windowSlot]) {
+      return;
+    }
+    const std::vector<size_t> &currentOOBIndex = windowOOBIndex[windowSlot];
+    const std::vector<double> &currentPrediction = windowPredictions[windowSlot];
+    for (size_t k = 0; k < currentOOBIndex.size(); k++) {
+      size_t j = currentOOBIndex[k];
+      outputOOBPrediction[j] += currentPrediction[k] / outputOOBCount[j];
+    }
+  };
+  orderedFold exactFold(0, exactWindow, foldExactTree);
+
+    #if DOPARELLEL
+      // Trees are handed out one at a time by the shared thread pool
+      getThreadPool().parallelFor(
+        0,
+        getNtree(),
+        nthreadToUse,
+        [&](const int rank) {
+    #else
+              // For non-parallel version, just simply iterate all trees serially
+              for(int rank=0; rank<((int) getNtree()); rank++ ) {
+    #endif
+                size_t i = exact ? exactOrder[rank] : rank;
+                if (exact) {
+                  exactFold.start(rank);
+                  windowPredicted[rank % exactWindow] = 0;
+                }
+                try {
+                  size_t slot = forestryThreadPool::getSlot();
+                  oob_scratch &scratch = slotScratch[slot];
                   forestryTree *currentTree = (*getForest())[i].get();
+                  comembership_info* currentComembership = nullptr;
+                  if (buildWeights) {
+                    currentComembership = &treeComembership[i];
+                    currentComembership->leafOfRow.assign(numObservations,
+                                                          comembership_info::NO_LEAF);
+                  }
                   (*currentTree).getOOBPrediction(
-                      outputOOBPrediction_iteration,
-                      outputOOBCount_iteration,
+                      scratch,
                       getTrainingData(),
                       getOOBhonest(),
                       doubleOOB,
                       getMinNodeSizeToSplitAvg(),
                       xNew,
-                      weightMatrix,
+                      currentComembership,
                       training_idx
                   );
-                  #if DOPARELLEL
-                  std::lock_guard<std::mutex> lock(threadLock);
-                  #endif
-
-                  // based on tree seeds when tree seeds might be uninitialized
-                  tree_seeds.push_back(currentTree->getSeed());
 
                   if (exact) {
-                    tree_preds.push_back(outputOOBPrediction_iteration);
-                    //std::cout << "Tree predictions "<< std::endl;
-                    //print_vector(outputOOBPrediction_iteration);
-                    for (size_t j=0; j < numObservations; j++) {
-                      outputOOBCount[j] += outputOOBCount_iteration[j];
-                    }
+                    // The buffers of the slot are reused by the scratch space
+                    std::swap(windowOOBIndex[rank % exactWindow], scratch.OOBIndex);
+                    std::swap(windowPredictions[rank % exactWindow],
+                              scratch.OOBPrediction);
+                    windowPredicted[rank % exactWindow] = 1;
                   } else {
-                    for (size_t j=0; j < numObservations; j++) {
-                      outputOOBPrediction[j] += outputOOBPrediction_iteration[j];
-                      outputOOBCount[j] += outputOOBCount_iteration[j];
+                    std::vector<double> &slotPrediction = slotPredictions[slot];
+                    std::vector<size_t> &slotCount = slotCounts[slot];
+                    if (slotCount.empty()) {
+                      slotPrediction.assign(numObservations, 0.0);
+                      slotCount.assign(numObservations, 0);
+                    }
+                    for (size_t k = 0; k < scratch.OOBIndex.size(); k++) {
+                      slotCount[scratch.OOBIndex[k]] += 1;
+                      slotPrediction[scratch.OOBIndex[k]] += scratch.OOBPrediction[k];
                     }
                   }
 
                 } catch (std::runtime_error &err) {
                   // Rcpp::Rcerr << err.what() << std::endl;
+                } catch (...) {
+                  if (exact) {
+                    exactFold.finish(rank);
+                  }
+                  throw;
+                }
+                if (exact) {
+                  exactFold.finish(rank);
                 }
               }
     #if DOPARELLEL
-            },
-            t * getNtree() / nthreadToUse,
-            (t + 1) == nthreadToUse ?
-            getNtree() :
-              (t + 1) * getNtree() / nthreadToUse,
-              t
-        );
-        allThreads[t] = std::thread(dummyThread);
-          }
-          std::for_each(
-            allThreads.begin(),
-            allThreads.end(),
-            [](std::thread& x) { x.join(); }
-          );
+      );
     #endif
 
-  double OOB_MSE = 0;
+  // Add up the per thread sums in slot order
+  for (size_t slot = 0; slot < threadSlots; slot++) {
+    if (slotCounts[slot].empty()) {
+      continue;
+    }
+    for (size_t j = 0; j < numObservations; j++) {
+      outputOOBPrediction[j] += slotPredictions[slot][j];
+      outputOOBCount[j] += slotCounts[slot][j];
+    }
+  }
 
-  if (exact) {
-    std::vector<size_t> indices(tree_seeds.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    //Order the indices by the seeds of the corresponding trees
-    std::sort(indices.begin(), indices.end(),
-              [&](size_t a, size_t b) -> bool {
-                return tree_seeds[a] > tree_seeds[b];
-              });
+  for (size_t j=0; j<numObservations; j++){
+    if (outputOOBCount[j] != 0) {
+      if (!exact) {
+        outputOOBPrediction[j] = outputOOBPrediction[j] / outputOOBCount[j];
+      }
+      if (treeCounts) {
+        (*treeCounts)[j] = outputOOBCount[j];
+      }
+    } else {
+      outputOOBPrediction[j] = std::numeric_limits<double>::quiet_NaN();
+    }
+  }
 
+  // The weightMatrix rows are divided by the number of trees which predicted
+  // each observation
+  if (buildWeights) {
+    std::vector<double> rowTotals(outputOOBCount.begin(), outputOOBCount.end());
+    reduceWeightRows(
+      treeComembership,
+      rowTotals,
+      getNthread(),
+      [&](size_t row,
+          const std::vector<size_t> &columns,
+          const std::vector<double> &weights) {
+        if (weightMatrix) {
+          for (size_t k = 0; k < columns.size(); k++) {
+            (*weightMatrix)(row, columns[k]) = weights[k];
+          }
+        }
+        if (weightRows) {
+          (*weightRows)(row, columns, weights);
+        }
+      }
+    );
+  }
 
-    // Now aggregate using the new index ordering
-    for (std::vector<size_t>::iterator iter = indices.begin();
-         iter != indices.end();
-         ++iter)
-    {
-      size_t cur_index = *iter;
+  return outputOOBPrediction;
+}
 
-      // Aggregate all predictions for current tree
-      for (size_t j = 0; j < numObservations; j++) {
-        if (outputOOBCount[j] != 0) {
-          outputOOBPrediction[j] += tree_preds[cur_index][j] / outputOOBCount[j];
+void forestry::reduceWeightRows(
+    const std::vector< comembership_info > &treeComembership,
+    std::vector<double> &rowTotals,
+    size_t nthread,
+    const weight_row_consumer &weightRows,
+    const std::vector<size_t>* tree_weights
+) {
+  size_t numRows = rowTotals.size();
+  size_t numColumns = getNtrain();
 
-        } else {
-          outputOOBPrediction[j] = std::numeric_limits<double>::quiet_NaN();
-        }
+  size_t threadSlots = nthread;
+  if (threadSlots == 0) {
+    threadSlots = std::thread::hardware_concurrency();
+  }
+  threadSlots = std::max(threadSlots, (size_t) 1);
+
+  // Every thread sums its rows into its own dense scratch row, which is reset
+  // after each row through the list of columns it touched
+  std::vector< std::vector<double> > slotScratch(threadSlots);
+
+  #if DOPARELLEL
+  // Each row is built by a single thread, summing the trees in forest order,
+  // so no lock is needed and the weights do not depend on the thread count
+  getThreadPool().parallelFor(
+    0,
+    numRows,
+    nthread,
+    [&](const size_t row) {
+  #else
+  for (size_t row = 0; row < numRows; row++) {
+  #endif
+      std::vector<double> &scratch = slotScratch[forestryThreadPool::getSlot()];
+      if (scratch.empty()) {
+        scratch.assign(numColumns, 0.0);
       }
-    }
-    //Also divide the weightMatrix
-    if (weightMatrix) {
-      for (size_t j=0; j<numObservations; j++){
-        if (outputOOBCount[j] != 0) {
-          for (size_t i = 0; i < numTrainingRows; i++) {
-            (*weightMatrix)(j,i) = (*weightMatrix)(j,i) / outputOOBCount[j];
+
+      std::vector<size_t> columns;
+      std::vector<double> weights;
+
+      if (rowTotals[row] != 0) {
+        for (size_t t = 0; t < treeComembership.size(); t++) {
+          const comembership_info &comembership = treeComembership[t];
+          if (comembership.leafOfRow.empty() ||
+              comembership.leafOfRow[row] == comembership_info::NO_LEAF) {
+            continue;
           }
-            // Set the counts for this tree
-            (*treeCounts)[j] = outputOOBCount[j];
+          double treeWeight = tree_weights ?
+            (double) (*tree_weights)[t] : (double) 1.0;
+          if (treeWeight == 0) {
+            continue;
+          }
+
+          const std::vector<size_t> &leafTrainRows =
+            comembership.leafTrainRows[comembership.leafOfRow[row]];
+          for (size_t k = 0; k < leafTrainRows.size(); k++) {
+            if (scratch[leafTrainRows[k]] == 0) {
+              columns.push_back(leafTrainRows[k]);
+            }
+            scratch[leafTrainRows[k]] +=
+              treeWeight / ((double) leafTrainRows.size());
+          }
+        }
+
+        std::sort(columns.begin(), columns.end());
+        weights.resize(columns.size());
+        for (size_t k = 0; k < columns.size(); k++) {
+          weights[k] = scratch[columns[k]] / rowTotals[row];
+          scratch[columns[k]] = 0;
         }
       }
+
+      weightRows(row, columns, weights);
     }
+  #if DOPARELLEL
+  );
+  #endif
+}
 
-  } else {
-    for (size_t j=0; j<numObservations; j++){
-      double trueValue = getTrainingData()->getOutcomePoint(j);
-      if (outputOOBCount[j] != 0) {
-        OOB_MSE +=
-          pow(trueValue - outputOOBPrediction[j] / outputOOBCount[j], 2);
-        outputOOBPrediction[j] = outputOOBPrediction[j] / outputOOBCount[j];
-        //Also divide the weightMatrix
-        if (weightMatrix) {
-          for (size_t i = 0; i < numTrainingRows; i++) {
-            (*weightMatrix)(j,i) = (*weightMatrix)(j,i) / outputOOBCount[j];
-          }
-          (*treeCounts)[j] = outputOOBCount[j];
-        }
+std::vector<double> forestry::lpDistances(
+    std::vector<column_view>* xNew,
+    const std::vector<double> &newFeature,
+    const std::vector<double> &trainFeature,
+    bool categorical,
+    double p,
+    unsigned int seed,
+    bool OOB,
+    bool doubleOOB,
+    std::vector<size_t> &training_idx
+) {
+  if (trainFeature.size() != getNtrain()) {
+    throw std::runtime_error("The training feature must have one value per training observation.");
+  }
+
+  std::vector<double> distances(newFeature.size(), 0.0);
+
+  // Every row only visits the training observations it shares a leaf with,
+  // the rows are handed over by different threads but each row is written by
+  // one thread only
+  weight_row_consumer sumDistances = [&](
+      size_t row,
+      const std::vector<size_t> &columns,
+      const std::vector<double> &weights
+  ) {
+    double newValue = newFeature[row];
+    double distance = 0;
+    for (size_t k = 0; k < columns.size(); k++) {
+      double trainValue = trainFeature[columns[k]];
+      double difference;
+      if (std::isnan(newValue) || std::isnan(trainValue)) {
+        difference = std::numeric_limits<double>::quiet_NaN();
+      } else if (categorical) {
+        difference = newValue != trainValue ? 1 : 0;
       } else {
-        outputOOBPrediction[j] = std::numeric_limits<double>::quiet_NaN();
+        difference = std::pow(std::fabs(newValue - trainValue), p);
       }
+      distance += weights[k] * difference;
     }
+    distances[row] = distance;
+  };
+
+  if (OOB) {
+    predictOOB(xNew,
+               NULL,
+               NULL,
+               doubleOOB,
+               false,
+               training_idx,
+               &sumDistances);
+  } else {
+    predict(xNew,
+            NULL,
+            NULL,
+            NULL,
+            seed,
+            getNthread(),
+            false,
+            false,
+            NULL,
+            &sumDistances);
   }
 
-  return outputOOBPrediction;
+  return distances;
 }
 
 void forestry::calculateOOBError(
     bool doubleOOB
 ) {
 
-  size_t numObservations = getTrainingData()->getNumRows();
-
-  std::vector<double> outputOOBPrediction(numObservations);
-  std::vector<size_t> outputOOBCount(numObservations);
-
   std::vector<size_t> training_idx;
+  std::vector<size_t> outputOOBCount(getTrainingData()->getNumRows(), 0);
+  std::vector<double> outputOOBPrediction = predictOOB(
+    nullptr,
+    nullptr,
+    &outputOOBCount,
+    doubleOOB,
+    false,
+    training_idx
+  );
 
-  for (size_t i=0; i<numObservations; i++) {
-    outputOOBPrediction[i] = 0;
-    outputOOBCount[i] = 0;
+  double OOB_MSE = 0;
+  for (size_t j=0; j<outputOOBPrediction.size(); j++){
+    if (outputOOBCount[j] != 0) {
+      double trueValue = getTrainingData()->getOutcomePoint(j);
+      OOB_MSE += pow(trueValue - outputOOBPrediction[j], 2);
+    }
   }
 
-  #if DOPARELLEL
-  size_t nthreadToUse = getNthread();
-  if (nthreadToUse == 0) {
-    // Use all threads
-    nthreadToUse = std::thread::hardware_concurrency();
-  }
-  if (isVerbose()) {
-    std::cout << "Calculating OOB parallel using " << nthreadToUse << " threads"
-              << std::endl;
+  // Return the MSE and the prediction vector
+  this->_OOBError = OOB_MSE /( (double) outputOOBPrediction.size() );
+  this->_OOBpreds = outputOOBPrediction;
+};
+
+
+double forestry::getRunningOOBError() {
+
+  if (isSlim()) {
+    throw std::runtime_error("OOB predictions are not available for slim forests.");
   }
 
-  std::vector<std::thread> allThreads(nthreadToUse);
-  std::mutex threadLock;
+  size_t numObservations = getTrainingData()->getNumRows();
 
-  // For each thread, assign a sequence of tree numbers that the thread
-  // is responsible for handling
-  for (size_t t = 0; t < nthreadToUse; t++) {
-    auto dummyThread = std::bind(
-      [&](const int iStart, const int iEnd, const int t_) {
+  if (_runningOOBCounts.empty()) {
+    _runningOOBSums.assign(numObservations, 0.0);
+    _runningOOBCounts.assign(numObservations, 0);
 
-        // loop over all items
-        for (int i=iStart; i < iEnd; i++) {
-  #else
-  // For non-parallel version, just simply iterate all trees serially
-  for(int i=0; i<((int) getNtree()); i++ ) {
-  #endif
+    size_t threadSlots = 1;
+
+    #if DOPARELLEL
+    size_t nthreadToUse = getNthread();
+    if (nthreadToUse == 0) {
+      // Use all threads
+      nthreadToUse = std::thread::hardware_concurrency();
+    }
+    threadSlots = std::max(nthreadToUse, (size_t) 1);
+    #endif
+
+    std::vector< oob_scratch > slotScratch(threadSlots);
+
+    #if DOPARELLEL
+    std::mutex threadLock;
+
+    getThreadPool().parallelFor(
+      0,
+      getNtree(),
+      nthreadToUse,
+      [&](const int i) {
+    #else
+    for(int i=0; i<((int) getNtree()); i++ ) {
+    #endif
           try {
-            std::vector<double> outputOOBPrediction_iteration(numObservations);
-            std::vector<size_t> outputOOBCount_iteration(numObservations);
-            for (size_t j=0; j<numObservations; j++) {
-              outputOOBPrediction_iteration[j] = 0;
-              outputOOBCount_iteration[j] = 0;
-            }
-            forestryTree *currentTree = (*getForest())[i].get();
-            (*currentTree).getOOBPrediction(
-              outputOOBPrediction_iteration,
-              outputOOBCount_iteration,
+            oob_scratch &scratch = slotScratch[forestryThreadPool::getSlot()];
+            (*getForest())[i]->getOOBPrediction(
+              scratch,
               getTrainingData(),
               getOOBhonest(),
-              doubleOOB,
+              false,
               getMinNodeSizeToSplitAvg(),
               nullptr,
-              NULL,
-              training_idx
+              nullptr,
+              std::vector<size_t>()
             );
 
             #if DOPARELLEL
             std::lock_guard<std::mutex> lock(threadLock);
             #endif
 
-            for (size_t j=0; j < numObservations; j++) {
-              outputOOBPrediction[j] += outputOOBPrediction_iteration[j];
-              outputOOBCount[j] += outputOOBCount_iteration[j];
-            }
+            addRunningOOB(scratch, _runningOOBSums, _runningOOBCounts);
 
           } catch (std::runtime_error &err) {
             // Rcpp::Rcerr << err.what() << std::endl;
           }
         }
-  #if DOPARELLEL
-        },
-        t * getNtree() / nthreadToUse,
-        (t + 1) == nthreadToUse ?
-          getNtree() :
-          (t + 1) * getNtree() / nthreadToUse,
-        t
+    #if DOPARELLEL
     );
-    allThreads[t] = std::thread(dummyThread);
+    #endif
+  }
+
+  double OOB_MSE = 0;
+  size_t numPredicted = 0;
+  for (size_t j=0; j<numObservations; j++){
+    if (_runningOOBCounts[j] != 0) {
+      double trueValue = getTrainingData()->getOutcomePoint(j);
+      OOB_MSE += pow(trueValue - _runningOOBSums[j] / _runningOOBCounts[j], 2);
+      numPredicted++;
+    }
+  }
+
+  if (numPredicted == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
   }
+  return OOB_MSE / ((double) numPredicted);
+}
+
+std::vector<double> forestry::getVariableImportance(
+    unsigned int seed
+) {
+
+  if (isSlim()) {
+    throw std::runtime_error("The variable importance is not available for slim forests.");
+  }
+
+  DataFrame* trainingData = getTrainingData();
+  size_t numObservations = trainingData->getNumRows();
+  size_t numColumns = trainingData->getNumColumns();
 
-  std::for_each(
-    allThreads.begin(),
-    allThreads.end(),
-    [](std::thread& x) { x.join(); }
+  // The OOB predictions with no feature permuted
+  std::vector<size_t> training_idx;
+  std::vector<size_t> OOBCount(numObservations, 0);
+  std::vector<double> OOBPrediction = predictOOB(
+    nullptr,
+    nullptr,
+    &OOBCount,
+    false,
+    false,
+    training_idx
   );
-  #endif
 
   double OOB_MSE = 0;
-  for (size_t j=0; j<numObservations; j++){
-    double trueValue = getTrainingData()->getOutcomePoint(j);
-    if (outputOOBCount[j] != 0) {
-      OOB_MSE +=
-        pow(trueValue - outputOOBPrediction[j] / outputOOBCount[j], 2);
-      outputOOBPrediction[j] = outputOOBPrediction[j] / outputOOBCount[j];
-    } else {
-      outputOOBPrediction[j] = std::numeric_limits<double>::quiet_NaN();
+  for (size_t j = 0; j < numObservations; j++) {
+    if (OOBCount[j] != 0) {
+      double trueValue = trainingData->getOutcomePoint(j);
+      OOB_MSE += pow(trueValue - OOBPrediction[j], 2);
     }
   }
 
-  // Return the MSE and the prediction vector
-  this->_OOBError = OOB_MSE /( (double) outputOOBPrediction.size() );
-  this->_OOBpreds = outputOOBPrediction;
-};
+  // A permuted feature only changes the predictions of the trees which split
+  // on it, so the others are skipped
+  std::vector< std::vector<char> > treeSplitFeatures(getNtree());
+  for (size_t i = 0; i < getNtree(); i++) {
+    treeSplitFeatures[i].assign(numColumns, 0);
+    (*getForest())[i]->getSplitFeatures(treeSplitFeatures[i]);
+  }
+
+  size_t threadSlots = 1;
+
+  #if DOPARELLEL
+  size_t nthreadToUse = getNthread();
+  if (nthreadToUse == 0) {
+    // Use all threads
+    nthreadToUse = std::thread::hardware_concurrency();
+  }
+  threadSlots = std::max(nthreadToUse, (size_t) 1);
+  #endif
+
+  std::vector< oob_scratch > slotScratch(threadSlots);
+  std::vector< std::vector<double> > slotChanges(threadSlots);
+  std::vector< std::vector<size_t> > slotPermutations(threadSlots);
+  std::vector<double> importance(
+    numColumns,
+    std::numeric_limits<double>::quiet_NaN()
+  );
+
+  // Every feature is permuted on its own, with a permutation of the training
+  // rows drawn from seed + feature, so the result does not depend on the
+  // number of threads
+  #if DOPARELLEL
+  getThreadPool().parallelFor(
+    0,
+    numColumns,
+    nthreadToUse,
+    [&](const int feature) {
+  #else
+  for(int feature=0; feature<((int) numColumns); feature++ ) {
+  #endif
+        size_t slot = forestryThreadPool::getSlot();
+        oob_scratch &scratch = slotScratch[slot];
+        std::vector<double> &predictionChange = slotChanges[slot];
+        std::vector<size_t> &permutation = slotPermutations[slot];
+
+        permutation.resize(numObservations);
+        for (size_t j = 0; j < numObservations; j++) {
+          permutation[j] = j;
+        }
+        std::mt19937_64 random_number_generator(seed + feature);
+        std::shuffle(
+          permutation.begin(),
+          permutation.end(),
+          random_number_generator
+        );
+
+        predictionChange.assign(numObservations, 0.0);
+        for (size_t i = 0; i < getNtree(); i++) {
+          if (treeSplitFeatures[i][feature]) {
+            (*getForest())[i]->addPermutedOOBChange(
+              predictionChange,
+              scratch,
+              trainingData,
+              getOOBhonest(),
+              feature,
+              permutation
+            );
+          }
+        }
+
+        double permuted_MSE = 0;
+        for (size_t j = 0; j < numObservations; j++) {
+          if (OOBCount[j] != 0) {
+            double trueValue = trainingData->getOutcomePoint(j);
+            double permutedPrediction =
+              OOBPrediction[j] + predictionChange[j] / OOBCount[j];
+            permuted_MSE += pow(trueValue - permutedPrediction, 2);
+          }
+        }
+        importance[feature] = sqrt(permuted_MSE) / sqrt(OOB_MSE) - 1;
+      }
+  #if DOPARELLEL
+  );
+  #endif
+
+  return importance;
+}
 
 
 // -----------------------------------------------------------------------------
@@ -924,6 +1819,8 @@ void forestry::fillinTreeInfo(
     std::unique_ptr< std::vector< tree_info > > & forest_dta
 ){
 
+  phaseTimer serializeTimer(&_instrumentation, PHASE_SERIALIZE);
+
   if (isVerbose()) {
     RcppThread::Rcout << "Starting to translate Forest to R.\n";
   }
@@ -958,15 +1855,9 @@ void forestry::fillinTreeInfo(
 
 void forestry::reconstructTrees(
     std::unique_ptr< std::vector<size_t> > & categoricalFeatureColsRcpp,
-    std::unique_ptr< std::vector<unsigned int> > & tree_seeds,
-    std::unique_ptr< std::vector< std::vector<int> >  > & var_ids,
-    std::unique_ptr< std::vector< std::vector<double> >  > & split_vals,
-    std::unique_ptr< std::vector< std::vector<int> >  > & naLeftCounts,
-    std::unique_ptr< std::vector< std::vector<int> >  > & naRightCounts,
-    std::unique_ptr< std::vector< std::vector<int> >  > & naDefaultDirections,
-    std::unique_ptr< std::vector< std::vector<size_t> >  > & averagingSampleIndex,
-    std::unique_ptr< std::vector< std::vector<size_t> >  > & splittingSampleIndex,
-    std::unique_ptr< std::vector< std::vector<double> >  > & weights){
+    const std::vector< tree_info_view > & treeArrays){
+
+    phaseTimer reconstructTimer(&_instrumentation, PHASE_RECONSTRUCT);
 
     #if DOPARELLEL
     size_t nthreadToUse = this->getNthread();
@@ -981,25 +1872,21 @@ void forestry::reconstructTrees(
                         << std::endl;
     }
 
-    std::vector<std::thread> allThreads(nthreadToUse);
     std::mutex threadLock;
 
-    // For each thread, assign a sequence of tree numbers that the thread
-    // is responsible for handling
-    for (size_t t = 0; t < nthreadToUse; t++) {
-      auto dummyThread = std::bind(
-        [&](const int iStart, const int iEnd, const int t_) {
-
-          // loop over al assigned trees, iStart is the starting tree number
-          // and iEnd is the ending tree number
-          for (int i=iStart; i < iEnd; i++) {
+    // Trees are handed out one at a time by the shared thread pool
+    getThreadPool().parallelFor(
+      0,
+      treeArrays.size(),
+      nthreadToUse,
+      [&](const int i) {
     #else
               // For non-parallel version, just simply iterate all trees serially
-    for(int i=0; i<(split_vals->size()); i++ ) {
+    for(int i=0; i<(treeArrays.size()); i++ ) {
     #endif
 
       try{
-        forestryTree *oneTree = new forestryTree();
+        std::unique_ptr< forestryTree > oneTree(new forestryTree());
 
         oneTree->reconstruct_tree(
                 getMtry(),
@@ -1014,43 +1901,31 @@ void forestry::reconstructTrees(
                 getNaDirection(),
                 getlinear(),
                 getOverfitPenalty(),
-                (*tree_seeds)[i],
+                treeArrays[i].seed,
                 (*categoricalFeatureColsRcpp),
-                (*var_ids)[i],
-                (*split_vals)[i],
-                (*naLeftCounts)[i],
-                (*naRightCounts)[i],
-                (*naDefaultDirections)[i],
-                (*averagingSampleIndex)[i],
-                (*splittingSampleIndex)[i],
-                (*weights)[i]);
+                treeArrays[i]);
+        if (getInBagCounts()) {
+          oneTree->countSampleIndex(getTrainingData()->getNumRows());
+        } else if (getCompactSplits()) {
+          oneTree->compactSampleIndex();
+        }
+
+        if (isInstrumentationEnabled()) {
+          _instrumentation.bytesAllocated += oneTree->getMemoryUsage();
+        }
 
 #if DOPARELLEL
         std::lock_guard<std::mutex> lock(threadLock);
 #endif
 
-        (*getForest()).emplace_back(oneTree);
+        (*getForest()).push_back(std::move(oneTree));
         _ntree = _ntree + 1;
       } catch (std::runtime_error &err) {
         std::cerr << err.what() << std::endl;
       }
   }
   #if DOPARELLEL
-            },
-            t * split_vals->size() / nthreadToUse,
-            (t + 1) == nthreadToUse ?
-            split_vals->size() :
-              (t + 1) * split_vals->size() / nthreadToUse,
-              t
-        );
-        allThreads[t] = std::thread(dummyThread);
-          }
-
-          std::for_each(
-            allThreads.begin(),
-            allThreads.end(),
-            [](std::thread& x) { x.join(); }
-          );
+    );
 #endif
 
   // Try sorting the forest by seed, this way we should do predict in the same order
@@ -1060,9 +1935,310 @@ void forestry::reconstructTrees(
     return a.get()->getSeed() > b.get()->getSeed();
   });
 
+  // The reconstructed trees are not in the running OOB sums, which are summed
+  // again over all trees when they are next asked for
+  std::vector<double>().swap(_runningOOBSums);
+  std::vector<size_t>().swap(_runningOOBCounts);
+
   return;
 }
 
+// The binary forest format stores the tree_info of every tree as flat arrays,
+// so that a scoring process can map the file and rebuild the trees without
+// parsing anything. All values are in the byte order of the machine which
+// wrote the file, and every section starts at a multiple of eight bytes.
+//
+//   binary_forest_header
+//   metadata                       metadataBytes bytes
+//   for every tree:
+//     binary_tree_header
+//     var_id                       numVarIds int32
+//     split_val                    numSplitVals double, or float32 when the
+//                                  tree has BINARY_TREE_FLOAT_SPLITS set
+//     naLeftCount                  numSplitVals int32
+//     naRightCount                 numSplitVals int32
+//     naDefaultDirection           numSplitVals int32
+//     values                       numValues double
+//     averagingSampleIndex         numAveraging int32
+//     splittingSampleIndex         numSplitting int32
+static const char BINARY_FOREST_MAGIC[8] = {'R', 'F', 'O', 'R', 'E', 'S', 'T', 'B'};
+// Version 2 adds the tree flags, files without float32 split values are still
+// written as version 1
+static const uint32_t BINARY_FOREST_VERSION = 2;
+static const uint32_t BINARY_TREE_FLOAT_SPLITS = 1;
+static const uint32_t BINARY_FOREST_BYTE_ORDER = 0x01020304;
+
+struct binary_forest_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t numTrees;
+  uint64_t numColumns;
+  uint64_t numRows;
+  uint64_t metadataBytes;
+};
+
+struct binary_tree_header {
+  uint32_t seed;
+  uint32_t flags;
+  uint64_t numVarIds;
+  uint64_t numSplitVals;
+  uint64_t numValues;
+  uint64_t numAveraging;
+  uint64_t numSplitting;
+};
+
+static_assert(sizeof(int) == 4, "The binary forest format stores int as 32 bits");
+static_assert(sizeof(binary_forest_header) % 8 == 0, "Unaligned binary header");
+static_assert(sizeof(binary_tree_header) % 8 == 0, "Unaligned binary header");
+
+static size_t binaryPadding(size_t bytes) {
+  return (8 - bytes % 8) % 8;
+}
+
+static void writeBinarySection(
+  std::ofstream &output,
+  const void* data,
+  size_t bytes
+) {
+  static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  if (bytes > 0) {
+    output.write((const char*) data, bytes);
+  }
+  output.write(zeros, binaryPadding(bytes));
+}
+
+// Returns a pointer to the next section of count elements of type T and moves
+// position past it, throwing if the file is too short
+template<typename T>
+static const T* readBinarySection(
+  const mappedFile &file,
+  size_t &position,
+  uint64_t count
+) {
+  if (position > file.getSize() ||
+      count > (file.getSize() - position) / sizeof(T)) {
+    throw std::runtime_error("The binary forest file is truncated.");
+  }
+  const T* section = (const T*) (file.getData() + position);
+  size_t bytes = (size_t) count * sizeof(T);
+  position += bytes + binaryPadding(bytes);
+  return section;
+}
+
+static binary_forest_header readBinaryForestHeader(
+  const mappedFile &file
+) {
+  binary_forest_header header;
+  if (file.getSize() < sizeof(header)) {
+    throw std::runtime_error("The file is not a binary forest file.");
+  }
+  std::memcpy(&header, file.getData(), sizeof(header));
+  if (std::memcmp(header.magic, BINARY_FOREST_MAGIC, sizeof(header.magic)) != 0) {
+    throw std::runtime_error("The file is not a binary forest file.");
+  }
+  if (header.byteOrder != BINARY_FOREST_BYTE_ORDER) {
+    throw std::runtime_error("The binary forest file was written on a machine with a different byte order.");
+  }
+  if (header.version < 1 || header.version > BINARY_FOREST_VERSION) {
+    throw std::runtime_error("The binary forest file has the unsupported version " +
+                             std::to_string(header.version) + ".");
+  }
+  return header;
+}
+
+void forestry::saveBinaryForest(
+  const std::string &filename,
+  const char* metadata,
+  size_t metadataBytes
+) {
+  std::unique_ptr< std::vector<tree_info> > forest_dta(
+    new std::vector<tree_info>
+  );
+  fillinTreeInfo(forest_dta);
+
+  // The trees were timed while they were read out, writing them is timed here
+  phaseTimer serializeTimer(&_instrumentation, PHASE_SERIALIZE);
+
+  std::ofstream output(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Cannot open the file " + filename + " for writing.");
+  }
+
+  // The split values of a tree are stored as float32 when none of them loses
+  // precision, as for forests grown with compactSplits
+  std::vector<char> floatSplits(forest_dta->size(), 1);
+  bool anyFloatSplits = false;
+  for (size_t i = 0; i < forest_dta->size(); i++) {
+    for (auto splitVal : (*forest_dta)[i].split_val) {
+      if ((double) (float) splitVal != splitVal) {
+        floatSplits[i] = 0;
+        break;
+      }
+    }
+    anyFloatSplits = anyFloatSplits || floatSplits[i];
+  }
+
+  binary_forest_header header;
+  std::memcpy(header.magic, BINARY_FOREST_MAGIC, sizeof(header.magic));
+  header.version = anyFloatSplits ? BINARY_FOREST_VERSION : 1;
+  header.byteOrder = BINARY_FOREST_BYTE_ORDER;
+  header.numTrees = forest_dta->size();
+  header.numColumns = getTrainingData()->getNumColumns();
+  header.numRows = getNtrain();
+  header.metadataBytes = metadataBytes;
+  writeBinarySection(output, &header, sizeof(header));
+  writeBinarySection(output, metadata, metadataBytes);
+
+  for (size_t i = 0; i < forest_dta->size(); i++) {
+    tree_info &treeInfo = (*forest_dta)[i];
+
+    binary_tree_header treeHeader;
+    treeHeader.seed = treeInfo.seed;
+    treeHeader.flags = floatSplits[i] ? BINARY_TREE_FLOAT_SPLITS : 0;
+    treeHeader.numVarIds = treeInfo.var_id.size();
+    treeHeader.numSplitVals = treeInfo.split_val.size();
+    treeHeader.numValues = treeInfo.values.size();
+    treeHeader.numAveraging = treeInfo.averagingSampleIndex.size();
+    treeHeader.numSplitting = treeInfo.splittingSampleIndex.size();
+
+    writeBinarySection(output, &treeHeader, sizeof(treeHeader));
+    writeBinarySection(output, treeInfo.var_id.data(),
+                       treeInfo.var_id.size() * sizeof(int));
+    if (floatSplits[i]) {
+      std::vector<float> splitVals(treeInfo.split_val.begin(),
+                                   treeInfo.split_val.end());
+      writeBinarySection(output, splitVals.data(),
+                         splitVals.size() * sizeof(float));
+    } else {
+      writeBinarySection(output, treeInfo.split_val.data(),
+                         treeInfo.split_val.size() * sizeof(double));
+    }
+    writeBinarySection(output, treeInfo.naLeftCount.data(),
+                       treeInfo.naLeftCount.size() * sizeof(int));
+    writeBinarySection(output, treeInfo.naRightCount.data(),
+                       treeInfo.naRightCount.size() * sizeof(int));
+    writeBinarySection(output, treeInfo.naDefaultDirection.data(),
+                       treeInfo.naDefaultDirection.size() * sizeof(int));
+    writeBinarySection(output, treeInfo.values.data(),
+                       treeInfo.values.size() * sizeof(double));
+    writeBinarySection(output, treeInfo.averagingSampleIndex.data(),
+                       treeInfo.averagingSampleIndex.size() * sizeof(int));
+    writeBinarySection(output, treeInfo.splittingSampleIndex.data(),
+                       treeInfo.splittingSampleIndex.size() * sizeof(int));
+  }
+
+  output.close();
+  if (!output) {
+    throw std::runtime_error("Cannot write the file " + filename + ".");
+  }
+}
+
+void forestry::loadBinaryForest(
+  const std::string &filename
+) {
+  mappedFile file(filename);
+  binary_forest_header header = readBinaryForestHeader(file);
+
+  if (header.numColumns != getTrainingData()->getNumColumns() ||
+      header.numRows != getNtrain()) {
+    throw std::runtime_error("The binary forest file was written for different training data.");
+  }
+
+  size_t position = sizeof(header);
+  readBinarySection<char>(file, position, header.metadataBytes);
+
+  // Collect the arrays of every tree, so that the trees can be reconstructed
+  // in parallel
+  std::vector< tree_info_view > treeArrays;
+  // Holds the split values of the trees stored as float32, widened to double.
+  // Appending to a deque keeps the earlier vectors in place.
+  std::deque< std::vector<double> > widenedSplitVals;
+  for (uint64_t i = 0; i < header.numTrees; i++) {
+    binary_tree_header treeHeader;
+    std::memcpy(
+      &treeHeader,
+      readBinarySection<binary_tree_header>(file, position, 1),
+      sizeof(treeHeader)
+    );
+
+    tree_info_view treeView;
+    treeView.seed = treeHeader.seed;
+    treeView.numVarIds = treeHeader.numVarIds;
+    treeView.numSplitVals = treeHeader.numSplitVals;
+    treeView.numValues = treeHeader.numValues;
+    treeView.numAveraging = treeHeader.numAveraging;
+    treeView.numSplitting = treeHeader.numSplitting;
+    treeView.var_id =
+      readBinarySection<int>(file, position, treeHeader.numVarIds);
+    if (treeHeader.flags & BINARY_TREE_FLOAT_SPLITS) {
+      const float* splitVals =
+        readBinarySection<float>(file, position, treeHeader.numSplitVals);
+      widenedSplitVals.emplace_back(splitVals,
+                                    splitVals + treeHeader.numSplitVals);
+      treeView.split_val = widenedSplitVals.back().data();
+    } else {
+      treeView.split_val =
+        readBinarySection<double>(file, position, treeHeader.numSplitVals);
+    }
+    treeView.naLeftCount =
+      readBinarySection<int>(file, position, treeHeader.numSplitVals);
+    treeView.naRightCount =
+      readBinarySection<int>(file, position, treeHeader.numSplitVals);
+    treeView.naDefaultDirection =
+      readBinarySection<int>(file, position, treeHeader.numSplitVals);
+    treeView.values =
+      readBinarySection<double>(file, position, treeHeader.numValues);
+    treeView.averagingSampleIndex =
+      readBinarySection<int>(file, position, treeHeader.numAveraging);
+    treeView.splittingSampleIndex =
+      readBinarySection<int>(file, position, treeHeader.numSplitting);
+
+    // The split features and sample indices are used without further checks
+    // once the tree is reconstructed
+    for (size_t j = 0; j < treeView.numVarIds; j++) {
+      if (treeView.var_id[j] > (int) header.numColumns) {
+        throw std::runtime_error("The binary forest file contains an invalid split feature.");
+      }
+    }
+    for (size_t j = 0; j < treeView.numAveraging; j++) {
+      if (treeView.averagingSampleIndex[j] < 1 ||
+          (uint64_t) treeView.averagingSampleIndex[j] > header.numRows) {
+        throw std::runtime_error("The binary forest file contains an invalid sample index.");
+      }
+    }
+    for (size_t j = 0; j < treeView.numSplitting; j++) {
+      if (treeView.splittingSampleIndex[j] < 1 ||
+          (uint64_t) treeView.splittingSampleIndex[j] > header.numRows) {
+        throw std::runtime_error("The binary forest file contains an invalid sample index.");
+      }
+    }
+    treeArrays.push_back(treeView);
+  }
+
+  std::unique_ptr< std::vector<size_t> > categoricalFeatureCols(
+    new std::vector<size_t>(*getTrainingData()->getCatCols())
+  );
+  size_t ntreeBefore = getNtree();
+  reconstructTrees(categoricalFeatureCols, treeArrays);
+
+  if (getNtree() != ntreeBefore + header.numTrees) {
+    throw std::runtime_error("Not all trees of the binary forest file could be reconstructed.");
+  }
+}
+
+std::vector<char> forestry::readBinaryForestMetadata(
+  const std::string &filename
+) {
+  mappedFile file(filename);
+  binary_forest_header header = readBinaryForestHeader(file);
+
+  size_t position = sizeof(header);
+  const char* metadata =
+    readBinarySection<char>(file, position, header.metadataBytes);
+  return std::vector<char>(metadata, metadata + header.metadataBytes);
+}
+
 size_t forestry::getTotalNodeCount() {
   size_t node_count = 0;
   for (size_t i = 0; i < getNtree(); i++) {
@@ -1071,57 +2247,141 @@ size_t forestry::getTotalNodeCount() {
   }
   return node_count;
 }
+
+size_t forestry::getTotalMemoryUsage() {
+  size_t bytes = 0;
+  for (size_t i = 0; i < getNtree(); i++) {
+    bytes += (*getForest())[i]->getMemoryUsage();
+  }
+  return bytes;
+}
+
+void forestry::slim() {
+  for (size_t i = 0; i < getNtree(); i++) {
+    (*getForest())[i]->slim();
+  }
+  std::vector<double>().swap(_runningOOBSums);
+  std::vector<size_t>().swap(_runningOOBCounts);
+  _slim = true;
+}
 // [[Rcpp::depends(RcppArmadillo)]]
 // [[Rcpp::plugins(cpp11)]]
-std::vector<std::vector<double>>* forestry::neighborhoodImpute(
-    std::vector< std::vector<double> >* xNew,
-    arma::Mat<double>* weightMatrix
+std::unique_ptr< std::vector< std::vector<double> > > forestry::neighborhoodImpute(
+    std::vector<column_view>* xNew,
+    unsigned int seed,
+    size_t nthread
 ) {
-  std::vector<size_t>* categoricalCols = getTrainingData()->getCatCols();
-  std::vector<size_t>* numericalCols = getTrainingData()->getNumCols();
-
-  for(auto j : *numericalCols) {
-    for(size_t i = 0; i < (*xNew)[0].size(); i++) {
-      if(std::isnan((*xNew)[j][i])) {
-        arma::vec weights = weightMatrix->col(i);
-        std::vector<double>* xTrainColj = getTrainingData()->getFeatureData(j);
-          double totalWeights = 0;
-          double totalProd = 0;
-          size_t numRows = getTrainingData()->getNumRows();
-          for(size_t k = 0; k < numRows; k++) {
-            if(!std::isnan((*xTrainColj)[k])) {
-              totalProd = totalProd + (*xTrainColj)[k] * weights(k);
-              totalWeights = totalWeights + weights(k);
-            }
-            (*xNew)[j][i] = totalProd/totalWeights;
-          }}}}
-  for(auto j : *categoricalCols) {
-      for(size_t i = 0; i < (*xNew)[1].size(); i++) {
-        if(std::isnan((*xNew)[j][i])) {
-          arma::vec weights = weightMatrix->col(i);
-          std::vector<double>* xTrainColj = getTrainingData()->getFeatureData(j);
-          std::vector<double> categoryContribution;
-          categoryContribution.resize(45);
-          for(size_t k = 0; k < (*xTrainColj).size(); k++) {
-            if(!std::isnan((*xTrainColj)[k])) {
-              unsigned int category = round((*xTrainColj)[k]);
-              if(category + 1 > categoryContribution.size()) {
-                categoryContribution.resize(category + 1);
-              }
-              categoryContribution[round(category)] += weights(k);
-            }}
-          // Find position of max weight. In principle this can
-          // be done with std::which_max, std::distance. But this
-          // is inefficient because we have to iterate over the
-          // vector about 1.5 times.
-          double runningMax = -std::numeric_limits<double>::infinity();
-          size_t maxPosition=0;
-          for(size_t l = 0; l < categoryContribution.size(); l++) {
-            if(categoryContribution[l] > runningMax) {
-              runningMax = categoryContribution[l];
-              maxPosition = l;
-            }}
-          (*xNew)[j][i] = maxPosition;
-        }}}
-  return xNew;
+  size_t numFeatures = xNew->size();
+  size_t numObservations = numFeatures > 0 ? (*xNew)[0].size() : 0;
+
+  std::unique_ptr< std::vector< std::vector<double> > > imputedX (
+    new std::vector< std::vector<double> >(numFeatures)
+  );
+  for (size_t j = 0; j < numFeatures; j++) {
+    (*imputedX)[j].resize(numObservations);
+    for (size_t i = 0; i < numObservations; i++) {
+      (*imputedX)[j][i] = (*xNew)[j][i];
+    }
+  }
+
+  // Only the observations with a missing value are predicted. Observations
+  // without missing values draw no random NA directions, so the remaining
+  // observations see the same draws as when the whole data is predicted.
+  std::vector<size_t> missingRows;
+  for (size_t i = 0; i < numObservations; i++) {
+    for (size_t j = 0; j < numFeatures; j++) {
+      if (std::isnan((*xNew)[j][i])) {
+        missingRows.push_back(i);
+        break;
+      }
+    }
+  }
+  if (missingRows.empty()) {
+    return imputedX;
+  }
+
+  std::vector< std::vector<double> > missingData(numFeatures);
+  for (size_t j = 0; j < numFeatures; j++) {
+    missingData[j].resize(missingRows.size());
+    for (size_t i = 0; i < missingRows.size(); i++) {
+      missingData[j][i] = (*xNew)[j][missingRows[i]];
+    }
+  }
+  std::vector<column_view> missingColumns = make_column_views(missingData);
+
+  DataFrame* trainingData = getTrainingData();
+  std::vector<char> isCategorical(numFeatures, 0);
+  std::vector<size_t> numCategories(numFeatures, 0);
+  for (auto j : *trainingData->getCatCols()) {
+    isCategorical[j] = 1;
+    column_view* xTrainColj = trainingData->getFeatureData(j);
+    for (size_t k = 0; k < xTrainColj->size(); k++) {
+      if (!std::isnan((*xTrainColj)[k])) {
+        numCategories[j] = std::max(numCategories[j],
+                                    (size_t) round((*xTrainColj)[k]) + 1);
+      }
+    }
+  }
+
+  // Each row of the weight matrix imputes all missing values of its
+  // observation as soon as it is built, so the weight matrix is never stored
+  // and each missing value only visits the training observations sharing a
+  // leaf with the observation
+  weight_row_consumer imputeRow = [&](
+      size_t row,
+      const std::vector<size_t> &columns,
+      const std::vector<double> &weights
+  ) {
+    std::vector<double> categoryContribution;
+    for (size_t j = 0; j < numFeatures; j++) {
+      if (!std::isnan(missingData[j][row])) {
+        continue;
+      }
+      column_view* xTrainColj = trainingData->getFeatureData(j);
+
+      if (!isCategorical[j]) {
+        double totalWeights = 0;
+        double totalProd = 0;
+        for (size_t k = 0; k < columns.size(); k++) {
+          double trainValue = (*xTrainColj)[columns[k]];
+          if (!std::isnan(trainValue)) {
+            totalProd = totalProd + trainValue * weights[k];
+            totalWeights = totalWeights + weights[k];
+          }
+        }
+        (*imputedX)[j][missingRows[row]] = totalProd/totalWeights;
+      } else {
+        categoryContribution.assign(std::max(numCategories[j], (size_t) 1), 0);
+        for (size_t k = 0; k < columns.size(); k++) {
+          double trainValue = (*xTrainColj)[columns[k]];
+          if (!std::isnan(trainValue)) {
+            categoryContribution[(size_t) round(trainValue)] += weights[k];
+          }
+        }
+        // The first category with the largest weight is imputed
+        double runningMax = -std::numeric_limits<double>::infinity();
+        size_t maxPosition = 0;
+        for (size_t l = 0; l < categoryContribution.size(); l++) {
+          if (categoryContribution[l] > runningMax) {
+            runningMax = categoryContribution[l];
+            maxPosition = l;
+          }
+        }
+        (*imputedX)[j][missingRows[row]] = maxPosition;
+      }
+    }
+  };
+
+  predict(&missingColumns,
+          NULL,
+          NULL,
+          NULL,
+          seed,
+          nthread,
+          false,
+          false,
+          NULL,
+          &imputeRow);
+
+  return imputedX;
 }
@@ -5,6 +5,7 @@
 #include "DataFrame.h"
 #include "forestryTree.h"
 #include "utils.h"
+#include "instrumentation.h"
 #include <armadillo>
 #include <iostream>
 #include <vector>
@@ -45,11 +46,16 @@ public:
     bool naDirection,
     bool linear,
     double overfitPenalty,
-    bool doubleTree
+    bool doubleTree,
+    bool histogramSplit,
+    size_t nodeParallelSize,
+    bool compactSplits,
+    bool inBagCounts,
+    size_t firstTree
   );
 
   std::unique_ptr< std::vector<double> > predict(
-    std::vector< std::vector<double> >* xNew,
+    std::vector<column_view>* xNew,
     arma::Mat<double>* weightMatrix,
     arma::Mat<double>* coefficients,
     arma::Mat<int>* terminalNodes,
@@ -57,15 +63,72 @@ public:
     size_t nthread,
     bool exact,
     bool use_weights,
-    std::vector<size_t>* tree_weights
+    std::vector<size_t>* tree_weights,
+    const weight_row_consumer* weightRows = NULL
+  );
+
+  // Routes the observations of xNew through every tree once and records the
+  // leaves they reach, together with the leaf co-membership when the weight
+  // matrix is to be aggregated from the leaves as well
+  std::unique_ptr< leaf_assignment > assignLeaves(
+    std::vector<column_view>* xNew,
+    unsigned int seed,
+    size_t nthread,
+    bool keepComembership
+  );
+
+  // Aggregates the predictions, and the weight matrix when it is requested,
+  // from leaves assigned by assignLeaves. The trees are summed in the order
+  // of predict with exact = TRUE, and as there tree_weights gives the weight
+  // of each tree by its position in this order.
+  std::unique_ptr< std::vector<double> > predictLeaves(
+    const leaf_assignment &leaves,
+    arma::Mat<double>* weightMatrix,
+    size_t nthread,
+    bool use_weights,
+    std::vector<size_t>* tree_weights,
+    const weight_row_consumer* weightRows = NULL
+  );
+
+  double predictRow(
+    std::vector<double>* xNew,
+    unsigned int seed
   );
 
   std::vector<double> predictOOB(
-    std::vector< std::vector<double> >* xNew,
+    std::vector<column_view>* xNew,
     arma::Mat<double>* weightMatrix,
     std::vector<size_t>* treeCounts,
     bool doubleOOB,
     bool exact,
+    std::vector<size_t> &training_idx,
+    const weight_row_consumer* weightRows = NULL
+  );
+
+  // Builds the rows of the weight matrix from the leaf co-membership of the
+  // trees. Each tree counts with its entry in tree_weights when given.
+  void reduceWeightRows(
+    const std::vector< comembership_info > &treeComembership,
+    std::vector<double> &rowTotals,
+    size_t nthread,
+    const weight_row_consumer &weightRows,
+    const std::vector<size_t>* tree_weights = NULL
+  );
+
+  // Returns for each observation of xNew the sum over the training
+  // observations of its weight matrix entry times |newFeature - trainFeature|^p,
+  // or times the indicator that the categories differ when categorical is set.
+  // The weights are those of predict, or of predictOOB when OOB is set, and
+  // each row of the weight matrix is consumed as soon as it is built.
+  std::vector<double> lpDistances(
+    std::vector<column_view>* xNew,
+    const std::vector<double> &newFeature,
+    const std::vector<double> &trainFeature,
+    bool categorical,
+    double p,
+    unsigned int seed,
+    bool OOB,
+    bool doubleOOB,
     std::vector<size_t> &training_idx
   );
 
@@ -75,18 +138,37 @@ public:
 
   void reconstructTrees(
       std::unique_ptr< std::vector<size_t> > & categoricalFeatureColsRcpp,
-      std::unique_ptr< std::vector<unsigned int> > & tree_seeds,
-      std::unique_ptr< std::vector< std::vector<int> >  > & var_ids,
-      std::unique_ptr< std::vector< std::vector<double> >  > & split_vals,
-      std::unique_ptr< std::vector< std::vector<int> >  > & naLeftCounts,
-      std::unique_ptr< std::vector< std::vector<int> >  > & naRightCounts,
-      std::unique_ptr< std::vector< std::vector<int> >  > & naDefaultDirections,
-      std::unique_ptr< std::vector< std::vector<size_t> >  > & averagingSampleIndex,
-      std::unique_ptr< std::vector< std::vector<size_t> >  > & splittingSampleIndex,
-      std::unique_ptr< std::vector< std::vector<double> >  > & weights);
+      const std::vector< tree_info_view > & treeArrays
+  );
+
+  // Writes the trees to filename in the binary forest format together with
+  // metadataBytes bytes of metadata, which are stored as they are
+  void saveBinaryForest(
+      const std::string &filename,
+      const char* metadata,
+      size_t metadataBytes
+  );
+
+  // Adds the trees of a binary forest file written for the same training data
+  // to the forest. The trees are reconstructed straight from the memory
+  // mapped file.
+  void loadBinaryForest(
+      const std::string &filename
+  );
+
+  static std::vector<char> readBinaryForestMetadata(
+      const std::string &filename
+  );
 
   size_t getTotalNodeCount();
 
+  // Returns the approximate number of bytes held by the trees
+  size_t getTotalMemoryUsage();
+
+  // Frees everything the trees only need for the weight matrix, the OOB
+  // predictions and the imputation, which are then no longer available
+  void slim();
+
   void calculateOOBError(
       bool doubleOOB = false
   );
@@ -103,8 +185,41 @@ public:
     return _OOBpreds;
   }
 
+  // Returns the mean squared error of the OOB predictions over the training
+  // rows which are out of bag for at least one tree. The first call sums the
+  // OOB predictions of all trees, afterwards addTrees adds each new tree to the
+  // running sums as soon as it is trained, so the error can be followed while
+  // the forest grows.
+  double getRunningOOBError();
+
+  // Returns for every feature the relative increase of the root mean squared
+  // OOB error when the values of the feature are permuted between the training
+  // rows. The features are permuted one at a time without copying the data,
+  // and only the trees which split on a feature predict again.
+  std::vector<double> getVariableImportance(
+    unsigned int seed
+  );
+
   void addTrees(size_t ntree);
 
+  // Grows the trees with the numbers firstTree to firstTree + ntree - 1. They
+  // are the trees a forest with the same seed and training data grows at these
+  // numbers, so disjoint ranges can be grown in separate processes and merged
+  // with mergeForests. The range is grown as it is, the trees minTreesPerFold
+  // asks for are only added by addTrees.
+  void addTreeRange(size_t firstTree, size_t ntree);
+
+  // Moves the trees of shards grown with the same seed on the same training
+  // data into this forest, without reconstructing them. The shards are left
+  // without trees. The running OOB sums are added up when every forest keeps
+  // them. Throws when the forests do not match or share a tree.
+  void mergeForests(const std::vector< forestry* > &shards);
+
+  // Whether other grows its trees with the same seed, parameters and weights
+  // as this forest, so that its trees are the ones this forest grows for the
+  // same tree numbers
+  bool sameGrowthParameters(forestry* other);
+
   DataFrame* getTrainingData() {
     return _trainingData;
   }
@@ -217,12 +332,49 @@ public:
   double getOverfitPenalty() {
     return _overfitPenalty;
   }
-  std::vector<std::vector<double>>* neighborhoodImpute(
-      std::vector< std::vector<double> >* xNew,
-      arma::Mat<double>* weightMatrix
+
+  bool getHistogramSplit() {
+    return _histogramSplit;
+  }
+
+  size_t getNodeParallelSize() {
+    return _nodeParallelSize;
+  }
+
+  bool getCompactSplits() {
+    return _compactSplits;
+  }
+
+  bool getInBagCounts() {
+    return _inBagCounts;
+  }
+
+  bool isSlim() {
+    return _slim;
+  }
+
+  // Returns the time spent in the phases and the work done since the forest
+  // was created or last reset, collected while instrumentation is enabled
+  forestry_instrumentation* getInstrumentation() {
+    return &_instrumentation;
+  }
+
+  // Imputes the missing values of xNew with the training observations which
+  // share leaves with each observation, weighted as in the weight matrix.
+  // Numerical features get the weighted mean and categorical features the
+  // category with the largest weight. The rows of the weight matrix are
+  // consumed as they are built, in parallel, and are never stored.
+  std::unique_ptr< std::vector< std::vector<double> > > neighborhoodImpute(
+      std::vector<column_view>* xNew,
+      unsigned int seed,
+      size_t nthread
   );
 
 private:
+  // Grows the trees with the numbers firstTree to firstTree + ntree - 1, and
+  // when growFoldTrees is set at least the trees minTreesPerFold asks for
+  void growTrees(size_t firstTree, size_t ntree, bool growFoldTrees);
+
   DataFrame* _trainingData;
   size_t _ntree;
   bool _replace;
@@ -244,6 +396,10 @@ private:
   size_t _nthread;
   double _OOBError;
   std::vector<double> _OOBpreds;
+  // The running sums and counts of the OOB predictions of every training row,
+  // empty until getRunningOOBError is called
+  std::vector<double> _runningOOBSums;
+  std::vector<size_t> _runningOOBCounts;
   bool _splitMiddle;
   size_t _maxObs;
   size_t _minTreesPerFold;
@@ -253,6 +409,12 @@ private:
   bool _linear;
   double _overfitPenalty;
   bool _doubleTree;
+  bool _histogramSplit;
+  size_t _nodeParallelSize;
+  bool _compactSplits;
+  bool _inBagCounts;
+  bool _slim;
+  forestry_instrumentation _instrumentation;
 };
 
 #endif //HTECPP_RF_H
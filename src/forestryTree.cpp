@@ -1,6 +1,8 @@
 #include "forestryTree.h"
 #include "utils.h"
 #include "treeSplitting.h"
+#include "threadPool.h"
+#include "mappedColumns.h"
 #include <armadillo>
 #include <RcppThread.h>
 #include <cmath>
@@ -8,6 +10,7 @@
 #include <map>
 #include <random>
 #include <sstream>
+#include <limits>
 #include <tuple>
 // [[Rcpp::plugins(cpp11)]]
 
@@ -22,7 +25,19 @@ forestryTree::forestryTree():
   _interactionDepth(0),
   _averagingSampleIndex(nullptr),
   _splittingSampleIndex(nullptr),
-  _root(nullptr) {};
+  _compactAveragingSampleIndex(nullptr),
+  _compactSplittingSampleIndex(nullptr),
+  _averagingCounts(nullptr),
+  _splittingCounts(nullptr),
+  _root(nullptr),
+  _nodeCount(0),
+  _featuresEvaluated(0),
+  _histogramSplit(0),
+  _nodeParallelSize(0),
+  _compactSplits(0),
+  _nthread(0),
+  _nodeTable(nullptr),
+  _slim(0) {};
 
 forestryTree::~forestryTree() {};
 
@@ -45,7 +60,12 @@ forestryTree::forestryTree(
   bool naDirection,
   bool linear,
   double overfitPenalty,
-  unsigned int seed
+  unsigned int seed,
+  bool histogramSplit,
+  size_t nodeParallelSize,
+  bool compactSplits,
+  bool inBagCounts,
+  size_t nthread
 ){
   /**
   * @brief Honest random forest tree constructor
@@ -63,6 +83,17 @@ forestryTree::forestryTree(
   * @param splitMiddle    Boolean to indicate if new feature value is
   *    determined at a random position between two feature values
   * @param maxObs    Max number of observations to split on
+  * @param histogramSplit    Boolean to indicate if numerical features are
+  *    split on their histogram bins instead of all distinct values
+  * @param nodeParallelSize    Minimum splitting size of a node to evaluate its
+  *    features and grow its children in parallel, 0 to grow serially
+  * @param compactSplits    Boolean to indicate if the split values of
+  *    numerical features are rounded to values representable as float and
+  *    the sample indices are kept in uint32 once the tree is grown
+  * @param inBagCounts    Boolean to indicate if the tree keeps the in bag
+  *    counts of the rows instead of the sample indices, and passes every
+  *    sampled row once to the split search, which weighs it by its count
+  * @param nthread    Number of threads to use for the parallel nodes
   */
  /* Sanity Check */
   if (minNodeSizeAvg == 0) {
@@ -94,6 +125,18 @@ forestryTree::forestryTree(
   if (maxDepth == 0) {
     throw std::runtime_error("maxDepth cannot be set to 0.");
   }
+  if (compactSplits && linear) {
+    throw std::runtime_error("compactSplits is not available for ridge forests.");
+  }
+  if (inBagCounts && linear) {
+    throw std::runtime_error("inBagCounts is not available for ridge forests.");
+  }
+  if (inBagCounts && hasNas) {
+    throw std::runtime_error("inBagCounts is not available with missing values.");
+  }
+  if (inBagCounts && histogramSplit) {
+    throw std::runtime_error("inBagCounts is not available with histogramSplit.");
+  }
   if (minSplitGain != 0 && !linear) {
     throw std::runtime_error("minSplitGain cannot be set without setting linear to be true.");
   }
@@ -122,6 +165,7 @@ forestryTree::forestryTree(
   this->_minSplitGain = minSplitGain;
   this->_hasNas = hasNas;
   this->_naDirection = naDirection;
+  this->_linear = linear;
   this->_maxDepth = maxDepth;
   this->_interactionDepth = interactionDepth;
   this->_averagingSampleIndex = std::move(averagingSampleIndex);
@@ -131,7 +175,22 @@ forestryTree::forestryTree(
   this->_root = std::move(root);
   /* Node ID's are 1 indexed from left to right */
   this->_nodeCount = 0;
+  this->_featuresEvaluated = 0;
   this->_seed = seed;
+  this->_histogramSplit = histogramSplit;
+  this->_nodeParallelSize = nodeParallelSize;
+  this->_compactSplits = compactSplits;
+  this->_nthread = nthread;
+  this->_slim = false;
+
+  /* With in bag counts every sampled row is in the nodes once */
+  if (inBagCounts) {
+    countSampleIndex(trainingData->getNumRows());
+    _averagingSampleIndex.reset(new std::vector<size_t>());
+    _splittingSampleIndex.reset(new std::vector<size_t>());
+    counted_rows(*_averagingCounts, *_averagingSampleIndex);
+    counted_rows(*_splittingCounts, *_splittingSampleIndex);
+  }
 
   /* If ridge splitting, initialize RSS components to pass to leaves*/
 
@@ -171,11 +230,27 @@ forestryTree::forestryTree(
                                       [](int i) { return i==0; });;
   struct monotonic_info monotonic_details;
 
-  monotonic_details.monotonic_constraints = (*trainingData->getMonotonicConstraints());
+  monotonic_details.monotonic_constraints = trainingData->getMonotonicConstraints();
   monotonic_details.upper_bound = std::numeric_limits<double>::max();
   monotonic_details.lower_bound = -std::numeric_limits<double>::max();
   monotonic_details.monotoneAvg = (bool) trainingData->getMonotoneAvg();
 
+  /* With histogram splits, the root bins its samples from scratch */
+  histogram_node rootHistograms;
+  rootHistograms.averagingSampleIndex = getAveragingIndex();
+  rootHistograms.splittingSampleIndex = getSplittingIndex();
+
+  /* The nodes reuse their index vectors and split tables while growing */
+  _indexArena = std::unique_ptr< objectArena< std::vector<size_t> > > (
+    new objectArena< std::vector<size_t> >()
+  );
+  _splitArena = std::unique_ptr< objectArena< feature_splits > > (
+    new objectArena< feature_splits >()
+  );
+  _presortArena = std::unique_ptr< objectArena< presort_counts > > (
+    new objectArena< presort_counts >()
+  );
+
   /* Recursively grow the tree */
   recursivePartition(
     getRoot(),
@@ -192,8 +267,96 @@ forestryTree::forestryTree(
     s_ptr,
     monotone_splits,
     monotonic_details,
-    naDirection
+    naDirection,
+    getHistogramSplit() ? &rootHistograms : nullptr
   );
+  _indexArena.reset();
+  _splitArena.reset();
+  _presortArena.reset();
+
+  // Parallel nodes assign the ids of their leaves in the order in which they
+  // finish
+  if (getNodeParallelSize() > 0) {
+    this->_nodeCount = 0;
+    renumberLeaves(getRoot());
+  }
+
+  compileNodeTable(trainingData->getCatCols());
+
+  if (inBagCounts) {
+    _averagingSampleIndex.reset();
+    _splittingSampleIndex.reset();
+  } else if (compactSplits) {
+    compactSampleIndex();
+  }
+}
+
+void forestryTree::compactSampleIndex() {
+  if (!_averagingSampleIndex || !_splittingSampleIndex) {
+    return;
+  }
+  std::vector<size_t>* sampleIndices[2] = {
+    _averagingSampleIndex.get(),
+    _splittingSampleIndex.get()
+  };
+  for (size_t s = 0; s < 2; s++) {
+    for (size_t row : *sampleIndices[s]) {
+      if (row > std::numeric_limits<uint32_t>::max()) {
+        return;
+      }
+    }
+  }
+
+  _compactAveragingSampleIndex.reset(new std::vector<uint32_t>(
+    _averagingSampleIndex->begin(), _averagingSampleIndex->end()
+  ));
+  _compactSplittingSampleIndex.reset(new std::vector<uint32_t>(
+    _splittingSampleIndex->begin(), _splittingSampleIndex->end()
+  ));
+  _averagingSampleIndex.reset();
+  _splittingSampleIndex.reset();
+}
+
+void forestryTree::countSampleIndex(size_t numRows) {
+  if (!_averagingSampleIndex || !_splittingSampleIndex) {
+    return;
+  }
+  _averagingCounts.reset(new sample_counts());
+  _splittingCounts.reset(new sample_counts());
+  count_sample_rows(*_averagingSampleIndex, numRows, *_averagingCounts);
+  count_sample_rows(*_splittingSampleIndex, numRows, *_splittingCounts);
+  _averagingSampleIndex.reset();
+  _splittingSampleIndex.reset();
+}
+
+void forestryTree::getSampleIndex(
+    std::vector<size_t> &averagingSampleIndex,
+    std::vector<size_t> &splittingSampleIndex
+){
+  if (getAveragingCounts()) {
+    counted_sample_index(*getAveragingCounts(), averagingSampleIndex);
+    counted_sample_index(*getSplittingCounts(), splittingSampleIndex);
+    return;
+  }
+  averagingSampleIndex.clear();
+  splittingSampleIndex.clear();
+  for (size_t k = 0; k < getAveragingIndexSize(); k++) {
+    averagingSampleIndex.push_back(getAveragingIndexAt(k));
+  }
+  for (size_t k = 0; k < getSplittingIndexSize(); k++) {
+    splittingSampleIndex.push_back(getSplittingIndexAt(k));
+  }
+}
+
+void forestryTree::renumberLeaves(RFNode* node) {
+  if (node->is_leaf()) {
+    size_t node_id;
+    assignNodeId(node_id);
+    node->setNodeId(node_id);
+  } else {
+    renumberLeaves(node->getLeftChild());
+    renumberLeaves(node->getRightChild());
+  }
 }
 
 void forestryTree::setDummyTree(
@@ -226,9 +389,9 @@ void forestryTree::predict(
     std::vector<double> &outputPrediction,
     std::vector<int>* terminalNodes,
     std::vector< std::vector<double> > &outputCoefficients,
-    std::vector< std::vector<double> >* xNew,
+    std::vector<column_view>* xNew,
     DataFrame* trainingData,
-    arma::Mat<double>* weightMatrix,
+    comembership_info* comembership,
     bool linear,
     bool naDirection,
     unsigned int seed,
@@ -242,6 +405,29 @@ void forestryTree::predict(
     size_t operator()() {return currentNumber++; }
   };
 
+  // Without a weight matrix or ridge leaves only the split rules and the leaf
+  // weights are needed, which the flattened node table holds contiguously
+  if (getNodeTable() && !comembership && !linear) {
+    predictNodeTable(
+      outputPrediction,
+      terminalNodes,
+      xNew,
+      naDirection,
+      seed
+    );
+    return;
+  }
+
+  // The comembership of compact trees and of trees with in bag counts needs
+  // the averaging set as an index list
+  std::vector<size_t>* averagingIndex = getAveragingIndex();
+  std::vector<size_t> expandedAveragingIndex;
+  if (comembership && !averagingIndex) {
+    std::vector<size_t> expandedSplittingIndex;
+    getSampleIndex(expandedAveragingIndex, expandedSplittingIndex);
+    averagingIndex = &expandedAveragingIndex;
+  }
+
   std::vector<size_t> updateIndex(outputPrediction.size());
   rangeGenerator _rangeGenerator(0);
   std::generate(updateIndex.begin(), updateIndex.end(), _rangeGenerator);
@@ -249,10 +435,10 @@ void forestryTree::predict(
                        terminalNodes,
                        outputCoefficients,
                        &updateIndex,
-                       weightMatrix ? getAveragingIndex() : nullptr,
+                       comembership ? averagingIndex : nullptr,
                        xNew,
                        trainingData,
-                       weightMatrix,
+                       comembership,
                        linear,
                        naDirection,
                        getOverfitPenalty(),
@@ -262,6 +448,296 @@ void forestryTree::predict(
   //Rcpp::Rcout << "Seed is" << seed << ".\n";
 }
 
+// Draws the direction of an observation with a missing split feature at a
+// numerical split node of the node table, returns true for the left child
+bool drawNaLeft(
+    node_table* nodeTable,
+    size_t currentNode,
+    std::mt19937_64& random_number_generator
+){
+  size_t naLeftCount = nodeTable->naLeftCount[currentNode];
+  size_t naRightCount = nodeTable->naRightCount[currentNode];
+  std::vector<size_t> naSampling;
+  if ((naLeftCount == 0) && (naRightCount == 0)) {
+    naSampling = {
+      nodeTable->averageCount[currentNode + 1],
+      nodeTable->averageCount[nodeTable->rightChild[currentNode]]};
+  } else {
+    naSampling = {naLeftCount, naRightCount};
+  }
+  std::discrete_distribution<size_t> discrete_dist(
+      naSampling.begin(), naSampling.end()
+  );
+  return discrete_dist(random_number_generator) == 0;
+}
+
+void forestryTree::compileNodeTable(
+    std::vector<size_t>* categoricalCols
+){
+  std::unique_ptr< node_table > nodeTable ( new node_table );
+  (*getRoot()).write_node_table(*nodeTable, categoricalCols);
+  this->_nodeTable = std::move(nodeTable);
+}
+
+void forestryTree::predictNodeTable(
+    std::vector<double> &outputPrediction,
+    std::vector<int>* terminalNodes,
+    std::vector<column_view>* xNew,
+    bool naDirection,
+    unsigned int seed
+){
+  node_table* nodeTable = getNodeTable();
+  const int* splitFeature = nodeTable->splitFeature.data();
+  const double* splitValue = nodeTable->splitValue.data();
+  const size_t* rightChild = nodeTable->rightChild.data();
+
+  // Missing values are sent left or right at random. Each split node draws
+  // from its own generator seeded with seed, and since the observations are
+  // routed in order, each node sees the same sequence of draws as when the
+  // observations are partitioned node by node in RFNode::predict.
+  std::map<size_t, std::mt19937_64> naGenerators;
+
+  for (size_t i = 0; i < outputPrediction.size(); i++) {
+    size_t currentNode = 0;
+
+    while (splitFeature[currentNode] >= 0) {
+      double currentValue = (*xNew)[splitFeature[currentNode]][i];
+      bool goLeft;
+
+      if (std::isnan(currentValue)) {
+        if (naDirection) {
+          // naDefaultDirection is -1 for left and 1 for right
+          goLeft = nodeTable->naDefaultDirection[currentNode] != 1;
+        } else if (nodeTable->categoricalSplit[currentNode]) {
+          // Categorical splits keep no NA counts, so the draw is always left
+          goLeft = true;
+        } else {
+          std::map<size_t, std::mt19937_64>::iterator generator =
+            naGenerators.find(currentNode);
+          if (generator == naGenerators.end()) {
+            generator = naGenerators.insert(
+              std::make_pair(currentNode, std::mt19937_64(seed))
+            ).first;
+          }
+          goLeft = drawNaLeft(nodeTable, currentNode, generator->second);
+        }
+      } else if (nodeTable->categoricalSplit[currentNode]) {
+        goLeft = currentValue == splitValue[currentNode];
+      } else {
+        goLeft = currentValue < splitValue[currentNode];
+      }
+
+      currentNode = goLeft ? currentNode + 1 : rightChild[currentNode];
+    }
+
+    outputPrediction[i] = splitValue[currentNode];
+    if (terminalNodes) {
+      (*terminalNodes)[i] = nodeTable->nodeId[currentNode];
+    }
+  }
+}
+
+// Returns the child of the split node currentNode an observation with value
+// currentValue of the split feature goes to. Missing values which are sent in
+// a random direction get the first draw of a generator seeded with seed.
+size_t nodeTableChild(
+    node_table* nodeTable,
+    size_t currentNode,
+    double currentValue,
+    bool naDirection,
+    unsigned int seed
+){
+  bool goLeft;
+
+  if (std::isnan(currentValue)) {
+    if (naDirection) {
+      // naDefaultDirection is -1 for left and 1 for right
+      goLeft = nodeTable->naDefaultDirection[currentNode] != 1;
+    } else if (nodeTable->categoricalSplit[currentNode]) {
+      goLeft = true;
+    } else {
+      std::mt19937_64 random_number_generator(seed);
+      goLeft = drawNaLeft(nodeTable, currentNode, random_number_generator);
+    }
+  } else if (nodeTable->categoricalSplit[currentNode]) {
+    goLeft = currentValue == nodeTable->splitValue[currentNode];
+  } else {
+    goLeft = currentValue < nodeTable->splitValue[currentNode];
+  }
+
+  return goLeft ? currentNode + 1 : nodeTable->rightChild[currentNode];
+}
+
+// As nodeTableChild, but missing values which are sent in a random direction
+// get the next draw of the generator of the node in naGenerators, which is
+// seeded with seed on first use. Routing the observations one after the other
+// this way gives each node the same sequence of draws as predictNodeTable.
+size_t nodeTableChild(
+    node_table* nodeTable,
+    size_t currentNode,
+    double currentValue,
+    bool naDirection,
+    std::map<size_t, std::mt19937_64> &naGenerators,
+    unsigned int seed
+){
+  if (std::isnan(currentValue) && !naDirection &&
+      !nodeTable->categoricalSplit[currentNode]) {
+    std::map<size_t, std::mt19937_64>::iterator generator =
+      naGenerators.find(currentNode);
+    if (generator == naGenerators.end()) {
+      generator = naGenerators.insert(
+        std::make_pair(currentNode, std::mt19937_64(seed))
+      ).first;
+    }
+    return drawNaLeft(nodeTable, currentNode, generator->second) ?
+      currentNode + 1 : nodeTable->rightChild[currentNode];
+  }
+  return nodeTableChild(nodeTable, currentNode, currentValue, naDirection, seed);
+}
+
+double forestryTree::predictRow(
+    std::vector<double>* xNew,
+    bool naDirection,
+    unsigned int seed
+){
+  node_table* nodeTable = getNodeTable();
+  if (!nodeTable) {
+    throw std::runtime_error("The tree has no node table to predict with.");
+  }
+  const int* splitFeature = nodeTable->splitFeature.data();
+
+  // A single observation gets the first draw of every node, the same draw it
+  // gets when predicted alone with predict
+  size_t currentNode = 0;
+  while (splitFeature[currentNode] >= 0) {
+    currentNode = nodeTableChild(
+      nodeTable,
+      currentNode,
+      (*xNew)[splitFeature[currentNode]],
+      naDirection,
+      seed
+    );
+  }
+
+  return nodeTable->splitValue[currentNode];
+}
+
+// Sizes the mask of the observations in the bag the first time a scratch space
+// is used, which has room for every training row or every group
+void initializeOOBMask(
+    oob_scratch &scratch,
+    DataFrame* trainingData
+){
+  if (scratch.inBag.empty()) {
+    size_t maskSize = trainingData->getNumRows();
+    std::vector<size_t>* groups = trainingData->getGroups();
+    if (groups->at(0) != 0) {
+      maskSize = std::max(
+        maskSize,
+        *std::max_element(groups->begin(), groups->end()) + 1
+      );
+    }
+    scratch.inBag.assign(maskSize, 0);
+  }
+}
+
+void forestryTree::getSplitFeatures(
+    std::vector<char> &splitFeatures
+){
+  node_table* nodeTable = getNodeTable();
+  if (!nodeTable) {
+    throw std::runtime_error("The tree has no node table to read the splits from.");
+  }
+  for (size_t k = 0; k < nodeTable->splitFeature.size(); k++) {
+    if (nodeTable->splitFeature[k] >= 0) {
+      splitFeatures[nodeTable->splitFeature[k]] = 1;
+    }
+  }
+}
+
+void forestryTree::addPermutedOOBChange(
+    std::vector<double> &predictionChange,
+    oob_scratch &scratch,
+    DataFrame* trainingData,
+    bool OOBhonest,
+    size_t permutedFeature,
+    const std::vector<size_t> &permutation
+){
+  node_table* nodeTable = getNodeTable();
+  if (!nodeTable) {
+    throw std::runtime_error("The tree has no node table to predict with.");
+  }
+  const int* splitFeature = nodeTable->splitFeature.data();
+  std::vector<column_view>* featureData = trainingData->getAllFeatureData();
+  const column_view &permutedColumn = (*featureData)[permutedFeature];
+
+  std::vector<size_t> &OOBIndex = scratch.OOBIndex;
+  OOBIndex.clear();
+  initializeOOBMask(scratch, trainingData);
+  getOOBIndex(
+    OOBIndex,
+    scratch.inBag,
+    trainingData,
+    !OOBhonest,
+    std::vector<size_t>()
+  );
+
+  // Missing values are sent in the directions getOOBPrediction sends them,
+  // once for the OOB observations as they are and once for them with the
+  // feature permuted. The nodes above the first split on the feature see the
+  // same observations both times, so they share their generators.
+  std::map<size_t, std::mt19937_64> naGenerators[2];
+
+  for (size_t k = 0; k < OOBIndex.size(); k++) {
+    size_t row = OOBIndex[k];
+
+    // The path is the same with and without the permutation until it reaches
+    // the first split on the permuted feature
+    size_t currentNode = 0;
+    while (splitFeature[currentNode] >= 0 &&
+           ((size_t) splitFeature[currentNode]) != permutedFeature) {
+      currentNode = nodeTableChild(
+        nodeTable,
+        currentNode,
+        (*featureData)[splitFeature[currentNode]][row],
+        getNaDirection(),
+        naGenerators[0],
+        OOB_PREDICTION_SEED
+      );
+    }
+    if (splitFeature[currentNode] < 0) {
+      continue;
+    }
+
+    // From there the observation is followed once with its own value and
+    // once with the permuted value of the feature
+    size_t leaves[2];
+    double permutedValues[2] = {
+      permutedColumn[row],
+      permutedColumn[permutation[row]]
+    };
+    for (size_t p = 0; p < 2; p++) {
+      size_t node = currentNode;
+      while (splitFeature[node] >= 0) {
+        size_t feature = (size_t) splitFeature[node];
+        node = nodeTableChild(
+          nodeTable,
+          node,
+          feature == permutedFeature ?
+            permutedValues[p] : (*featureData)[feature][row],
+          getNaDirection(),
+          naGenerators[p],
+          OOB_PREDICTION_SEED
+        );
+      }
+      leaves[p] = node;
+    }
+
+    predictionChange[row] +=
+      nodeTable->splitValue[leaves[1]] - nodeTable->splitValue[leaves[0]];
+  }
+}
+
 
 std::vector<size_t> sampleFeatures(
     size_t mtry,
@@ -270,46 +746,25 @@ std::vector<size_t> sampleFeatures(
     bool numFeaturesOnly,
     std::vector<size_t>* numCols,
     std::vector<double>* weights,
+    const feature_sampling_table& weightsTable,
     std::vector<size_t>* sampledFeatures
 ){
   if(weights->size() == 0)
     return *sampledFeatures;
   else {
-    // Sample features without replacement
+    // Sample features without replacement. The draws use the sampling table
+    // built with the data frame, and the features drawn so far are marked so
+    // a repeated draw is rejected without searching the list.
     std::vector<size_t> featureList;
-    if (numFeaturesOnly) {
-      while (featureList.size() < mtry) {
-        std::discrete_distribution<size_t> discrete_dist(
-            weights->begin(), weights->end()
-        );
-
-        size_t index = discrete_dist(random_number_generator);
-
-        if (featureList.size() == 0 ||
-            std::find(featureList.begin(),
-                      featureList.end(),
-                      (*numCols)[index]) == featureList.end()
-        ) {
-          featureList.push_back((*numCols)[index]);
-        }
-      }
-
-    } else {
-      while (featureList.size() < mtry) {
-        std::discrete_distribution<size_t> discrete_dist(
-            weights->begin(), weights->end()
-        );
-        size_t randomIndex = discrete_dist(random_number_generator);
-        if (
-            featureList.size() == 0 ||
-              std::find(
-                featureList.begin(),
-                featureList.end(),
-                randomIndex
-              ) == featureList.end()
-        ) {
-          featureList.push_back(randomIndex);
-        }
+    featureList.reserve(mtry);
+    std::vector<bool> isSampled(weights->size(), false);
+    std::discrete_distribution<size_t> discrete_dist;
+    while (featureList.size() < mtry) {
+      size_t index = discrete_dist(random_number_generator, weightsTable);
+
+      if (!isSampled[index]) {
+        isSampled[index] = true;
+        featureList.push_back(numFeaturesOnly ? (*numCols)[index] : index);
       }
     }
     return featureList;
@@ -328,11 +783,12 @@ void splitDataIntoTwoParts(
     bool categoical,
     bool hasNas,
     size_t &naLeftCount,
-    size_t &naRightCount
+    size_t &naRightCount,
+    std::vector<size_t>* naIndices
 ){
 
   if (hasNas) {
-    std::vector<size_t> naIndices;
+    (*naIndices).clear();
     for (
         std::vector<size_t>::iterator it = (*sampleIndex).begin();
         it != (*sampleIndex).end();
@@ -342,7 +798,7 @@ void splitDataIntoTwoParts(
         // categorical, split by (==) or (!=)
         double currentFeatureValue = trainingData->getPoint(*it, splitFeature);
         if (std::isnan(currentFeatureValue)) {
-          naIndices.push_back(*it);
+          (*naIndices).push_back(*it);
         } else if (currentFeatureValue == splitValue) {
           (*leftPartitionIndex).push_back(*it);
         } else {
@@ -354,7 +810,7 @@ void splitDataIntoTwoParts(
         double currentFeatureValue = trainingData->getPoint(*it, splitFeature);
 
         if (std::isnan(currentFeatureValue)) {
-          naIndices.push_back(*it);
+          (*naIndices).push_back(*it);
         } else {
 
           if (currentFeatureValue < splitValue) {
@@ -369,12 +825,12 @@ void splitDataIntoTwoParts(
     // Now instead of splitting with distance to Y values, we send all NA indices
     // right if naBestDirection == 1, left if naBestDirection == -1
     if (naBestDirection == -1) {
-      for (const auto& index : naIndices) {
+      for (const auto& index : *naIndices) {
         leftPartitionIndex->push_back(index);
         naLeftCount++;
       }
     } else if (naBestDirection == 1) {
-      for (const auto& index : naIndices) {
+      for (const auto& index : *naIndices) {
         rightPartitionIndex->push_back(index);
         naRightCount++;
       }
@@ -414,14 +870,16 @@ void updateMonotoneConstraints(
     monotonic_info& monotone_details,
     monotonic_info& monotonic_details_left,
     monotonic_info& monotonic_details_right,
-    std::vector<int> monotonic_constraints,
     double leftMean,
     double rightMean,
     size_t bestSplitFeature
 ) {
-  int monotone_direction = monotone_details.monotonic_constraints[bestSplitFeature];
-  monotonic_details_left.monotonic_constraints = monotonic_constraints;
-  monotonic_details_right.monotonic_constraints = monotonic_constraints;
+  int monotone_direction =
+    (*monotone_details.monotonic_constraints)[bestSplitFeature];
+  monotonic_details_left.monotonic_constraints =
+    monotone_details.monotonic_constraints;
+  monotonic_details_right.monotonic_constraints =
+    monotone_details.monotonic_constraints;
 
   // Also need to pass down the monotone Average Flag
   monotonic_details_left.monotoneAvg = monotone_details.monotoneAvg;
@@ -470,7 +928,8 @@ void splitData(
     size_t &naLeftCount,
     size_t &naRightCount,
     bool categoical,
-    bool hasNas
+    bool hasNas,
+    std::vector<size_t>* naIndices
 ) {
   size_t avgL = 0;
   size_t avgR = 0;
@@ -486,7 +945,8 @@ void splitData(
     categoical,
     hasNas,
     avgL,
-    avgR
+    avgR,
+    naIndices
   );
 
   // splitting data
@@ -501,10 +961,81 @@ void splitData(
     categoical,
     hasNas,
     naLeftCount,
-    naRightCount
+    naRightCount,
+    naIndices
   );
 }
 
+void updatePartitionRange(
+    DataFrame* trainingData,
+    std::vector<size_t>* partitionIndex,
+    size_t splitFeature,
+    double &minValue,
+    double &maxValue
+) {
+  for (const auto& index : *partitionIndex) {
+    double featureValue = trainingData->getPoint(index, splitFeature);
+    if (!std::isnan(featureValue)) {
+      minValue = std::min(minValue, featureValue);
+      maxValue = std::max(maxValue, featureValue);
+    }
+  }
+}
+
+bool compactSplitValue(
+    DataFrame* trainingData,
+    size_t splitFeature,
+    double &splitValue,
+    std::vector<size_t>* averagingLeftPartitionIndex,
+    std::vector<size_t>* averagingRightPartitionIndex,
+    std::vector<size_t>* splittingLeftPartitionIndex,
+    std::vector<size_t>* splittingRightPartitionIndex
+) {
+  // Rounds splitValue to a float which still lies above every value of the
+  // left partitions and at most at every value of the right partitions, so the
+  // partitions stay the same, preferring one below the right partitions.
+  // Returns false when no such float exists, in
+  // which case splitValue is only rounded and the data has to be split again.
+  double leftMin = std::numeric_limits<double>::infinity();
+  double leftMax = -std::numeric_limits<double>::infinity();
+  double rightMin = std::numeric_limits<double>::infinity();
+  double rightMax = -std::numeric_limits<double>::infinity();
+  updatePartitionRange(trainingData, averagingLeftPartitionIndex,
+                       splitFeature, leftMin, leftMax);
+  updatePartitionRange(trainingData, splittingLeftPartitionIndex,
+                       splitFeature, leftMin, leftMax);
+  updatePartitionRange(trainingData, averagingRightPartitionIndex,
+                       splitFeature, rightMin, rightMax);
+  updatePartitionRange(trainingData, splittingRightPartitionIndex,
+                       splitFeature, rightMin, rightMax);
+
+  float compactValue = (float) splitValue;
+  if ((double) compactValue > rightMin) {
+    compactValue = std::nextafter(compactValue,
+                                  -std::numeric_limits<float>::infinity());
+  } else if ((double) compactValue <= leftMax) {
+    compactValue = std::nextafter(compactValue,
+                                  std::numeric_limits<float>::infinity());
+  }
+  // A threshold equal to the smallest value of the right partitions sends the
+  // doubles which round up onto it left, so the float below it is taken when
+  // it still lies above the left partitions
+  if ((double) compactValue == rightMin) {
+    float lowerValue = std::nextafter(compactValue,
+                                      -std::numeric_limits<float>::infinity());
+    if ((double) lowerValue > leftMax) {
+      compactValue = lowerValue;
+    }
+  }
+
+  if ((double) compactValue > leftMax && (double) compactValue <= rightMin) {
+    splitValue = (double) compactValue;
+    return true;
+  }
+  splitValue = (double) (float) splitValue;
+  return false;
+}
+
 std::pair<double, double> calculateRSquaredSplit (
     DataFrame* trainingData,
     std::vector<size_t>* splittingSampleIndex,
@@ -595,20 +1126,26 @@ void forestryTree::recursivePartition(
     std::shared_ptr< arma::Mat<double> > gtotal,
     std::shared_ptr< arma::Mat<double> > stotal,
     bool monotone_splits,
-    monotonic_info monotone_details,
-    bool naDirection
+    monotonic_info &monotone_details,
+    bool naDirection,
+    histogram_node* histograms
 ){
-  if ((*averagingSampleIndex).size() < getMinNodeSizeAvg() ||
-      (*splittingSampleIndex).size() < getMinNodeSizeSpt() ||
+  // With in bag counts the rows of the node stand for as many observations as
+  // they were drawn
+  size_t averagingSize = counted_size(averagingSampleIndex, getAveragingCounts());
+  size_t splittingSize = counted_size(splittingSampleIndex, getSplittingCounts());
+
+  if (averagingSize < getMinNodeSizeAvg() ||
+      splittingSize < getMinNodeSizeSpt() ||
       (depth == getMaxDepth())) {
 
     size_t node_id;
     assignNodeId(node_id);
     (*rootNode).setLeafNode(
-        averagingSampleIndex->size(),
-        splittingSampleIndex->size(),
+        averagingSize,
+        splittingSize,
         node_id,
-        trainingData->partitionMean(averagingSampleIndex)
+        counted_mean(trainingData, averagingSampleIndex, getAveragingCounts())
     );
 
     // If we are growing a linear forest, we need to precalculate the ridge coefficients
@@ -624,13 +1161,16 @@ void forestryTree::recursivePartition(
   // Sample mtry amounts of features if possible.
   std::vector<size_t> featureList;
   std::vector<double>* featureWeightsUsed;
+  const feature_sampling_table* featureWeightsTableUsed;
   std::vector<size_t>* sampledWeightsVariablesUsed;
 
     if (depth >= getInteractionDepth()) {
       featureWeightsUsed = trainingData->getdeepFeatureWeights();
+      featureWeightsTableUsed = &trainingData->getdeepFeatureWeightsTable();
       sampledWeightsVariablesUsed = trainingData->getdeepFeatureWeightsVariables();
     } else {
       featureWeightsUsed = trainingData->getfeatureWeights();
+      featureWeightsTableUsed = &trainingData->getfeatureWeightsTable();
       sampledWeightsVariablesUsed = trainingData->getfeatureWeightsVariables();
     }
 
@@ -641,6 +1181,7 @@ void forestryTree::recursivePartition(
       false,
       trainingData->getNumCols(),
       featureWeightsUsed,
+      *featureWeightsTableUsed,
       sampledWeightsVariablesUsed
     );
 
@@ -688,7 +1229,8 @@ void forestryTree::recursivePartition(
     gtotal,
     stotal,
     monotone_splits,
-    monotone_details
+    monotone_details,
+    histograms
   );
 
   // Create a leaf node if the current bestSplitValue is NA
@@ -698,10 +1240,10 @@ void forestryTree::recursivePartition(
     assignNodeId(node_id);
 
     (*rootNode).setLeafNode(
-        averagingSampleIndex->size(),
-        splittingSampleIndex->size(),
+        averagingSize,
+        splittingSize,
         node_id,
-        trainingData->partitionMean(averagingSampleIndex)
+        counted_mean(trainingData, averagingSampleIndex, getAveragingCounts())
     );
 
     // If we are growing a linear forest, we need to precalculate the ridge coefficients
@@ -713,12 +1255,20 @@ void forestryTree::recursivePartition(
 
 
   } else {
-    // Test if the current feature is categorical
-    std::vector<size_t> averagingLeftPartitionIndex;
-    std::vector<size_t> averagingRightPartitionIndex;
-    std::vector<size_t> splittingLeftPartitionIndex;
-    std::vector<size_t> splittingRightPartitionIndex;
-    std::vector<size_t> categorialCols = *(*trainingData).getCatCols();
+    // The partitions reuse the index vectors of earlier nodes at this depth
+    arenaObject< std::vector<size_t> > averagingLeft(_indexArena.get(), depth);
+    arenaObject< std::vector<size_t> > averagingRight(_indexArena.get(), depth);
+    arenaObject< std::vector<size_t> > splittingLeft(_indexArena.get(), depth);
+    arenaObject< std::vector<size_t> > splittingRight(_indexArena.get(), depth);
+    arenaObject< std::vector<size_t> > naIndices(_indexArena.get(), depth);
+    std::vector<size_t> &averagingLeftPartitionIndex = *averagingLeft;
+    std::vector<size_t> &averagingRightPartitionIndex = *averagingRight;
+    std::vector<size_t> &splittingLeftPartitionIndex = *splittingLeft;
+    std::vector<size_t> &splittingRightPartitionIndex = *splittingRight;
+    averagingLeftPartitionIndex.clear();
+    averagingRightPartitionIndex.clear();
+    splittingLeftPartitionIndex.clear();
+    splittingRightPartitionIndex.clear();
 
     // Create split for both averaging and splitting dataset based on
     // categorical feature or not
@@ -735,14 +1285,49 @@ void forestryTree::recursivePartition(
       &splittingRightPartitionIndex,
       naLeftCount,
       naRightCount,
-      std::find(
-        categorialCols.begin(),
-        categorialCols.end(),
-        bestSplitFeature
-      ) != categorialCols.end(),
-        gethasNas()
+      (*trainingData).isCategorical(bestSplitFeature),
+      gethasNas(),
+      naIndices.get()
     );
 
+    // With compact splits the split values of numerical features are stored
+    // as float, which only moves the split when no float separates the sides
+    if (getCompactSplits() &&
+        !(*trainingData).isCategorical(bestSplitFeature) &&
+        !compactSplitValue(
+          trainingData,
+          bestSplitFeature,
+          bestSplitValue,
+          &averagingLeftPartitionIndex,
+          &averagingRightPartitionIndex,
+          &splittingLeftPartitionIndex,
+          &splittingRightPartitionIndex
+        )) {
+      averagingLeftPartitionIndex.clear();
+      averagingRightPartitionIndex.clear();
+      splittingLeftPartitionIndex.clear();
+      splittingRightPartitionIndex.clear();
+      naLeftCount = 0;
+      naRightCount = 0;
+      splitData(
+        trainingData,
+        averagingSampleIndex,
+        splittingSampleIndex,
+        bestSplitFeature,
+        bestSplitValue,
+        bestSplitNaDir,
+        &averagingLeftPartitionIndex,
+        &averagingRightPartitionIndex,
+        &splittingLeftPartitionIndex,
+        &splittingRightPartitionIndex,
+        naLeftCount,
+        naRightCount,
+        false,
+        gethasNas(),
+        naIndices.get()
+      );
+    }
+
     size_t lAvgSize = averagingLeftPartitionIndex.size();
     size_t rAvgSize = averagingRightPartitionIndex.size();
     size_t lSplSize = splittingLeftPartitionIndex.size();
@@ -755,10 +1340,10 @@ void forestryTree::recursivePartition(
       size_t node_id;
       assignNodeId(node_id);
       (*rootNode).setLeafNode(
-          averagingSampleIndex->size(),
-          splittingSampleIndex->size(),
+          averagingSize,
+          splittingSize,
           node_id,
-          trainingData->partitionMean(averagingSampleIndex)
+          counted_mean(trainingData, averagingSampleIndex, getAveragingCounts())
       );
 
       // If we are growing a linear forest, we need to precalculate the ridge coefficients
@@ -787,10 +1372,10 @@ void forestryTree::recursivePartition(
         size_t node_id;
         assignNodeId(node_id);
         (*rootNode).setLeafNode(
-            averagingSampleIndex->size(),
-            splittingSampleIndex->size(),
+            averagingSize,
+            splittingSize,
             node_id,
-            trainingData->partitionMean(averagingSampleIndex)
+            counted_mean(trainingData, averagingSampleIndex, getAveragingCounts())
         );
 
         // If we are growing a linear forest, we need to precalculate the ridge coefficients
@@ -811,17 +1396,17 @@ void forestryTree::recursivePartition(
 
     size_t childDepth = depth + 1;
 
-    std::shared_ptr< arma::Mat<double> > g_ptr_r = std::make_shared< arma::Mat<double> >(bestSplitGR);
-    std::shared_ptr< arma::Mat<double> > g_ptr_l = std::make_shared< arma::Mat<double> >(bestSplitGL);
-
-    std::shared_ptr< arma::Mat<double> > s_ptr_r = std::make_shared< arma::Mat<double> >(bestSplitSR);
-    std::shared_ptr< arma::Mat<double> > s_ptr_l = std::make_shared< arma::Mat<double> >(bestSplitSL);
+    // When not linear splitting, use nullptr for unneeded matrices
+    std::shared_ptr< arma::Mat<double> > g_ptr_r = nullptr;
+    std::shared_ptr< arma::Mat<double> > g_ptr_l = nullptr;
+    std::shared_ptr< arma::Mat<double> > s_ptr_r = nullptr;
+    std::shared_ptr< arma::Mat<double> > s_ptr_l = nullptr;
 
-    if (!linear) {
-      g_ptr_r = nullptr;
-      g_ptr_l = nullptr;
-      s_ptr_r = nullptr;
-      s_ptr_l = nullptr;
+    if (linear) {
+      g_ptr_r = std::make_shared< arma::Mat<double> >(bestSplitGR);
+      g_ptr_l = std::make_shared< arma::Mat<double> >(bestSplitGL);
+      s_ptr_r = std::make_shared< arma::Mat<double> >(bestSplitSR);
+      s_ptr_l = std::make_shared< arma::Mat<double> >(bestSplitSL);
     }
 
     // If monotone splitting, we need to pass down the monotone constraints,
@@ -837,9 +1422,10 @@ void forestryTree::recursivePartition(
           monotone_details,
           monotonic_details_left,
           monotonic_details_right,
-          (*trainingData->getMonotonicConstraints()),
-          trainingData->partitionMean(&splittingLeftPartitionIndex),
-          trainingData->partitionMean(&splittingRightPartitionIndex),
+          counted_mean(trainingData, &splittingLeftPartitionIndex,
+                       getSplittingCounts()),
+          counted_mean(trainingData, &splittingRightPartitionIndex,
+                       getSplittingCounts()),
           bestSplitFeature
         );
     }
@@ -849,8 +1435,8 @@ void forestryTree::recursivePartition(
     // right.
     if (naDirection && naLeftCount == 0 && naRightCount == 0) {
       std::vector<size_t> naSampling = {
-        averagingLeftPartitionIndex.size(),
-        averagingRightPartitionIndex.size()
+        counted_size(&averagingLeftPartitionIndex, getAveragingCounts()),
+        counted_size(&averagingRightPartitionIndex, getAveragingCounts())
       };
       std::discrete_distribution<size_t> discrete_dist(
           naSampling.begin(), naSampling.end()
@@ -865,43 +1451,66 @@ void forestryTree::recursivePartition(
       }
     }
 
-    // Recursively split on the left child node
-    recursivePartition(
-      leftChild.get(),
-      &averagingLeftPartitionIndex,
-      &splittingLeftPartitionIndex,
-      trainingData,
-      random_number_generator,
-      childDepth,
-      splitMiddle,
-      maxObs,
-      linear,
-      overfitPenalty,
-      g_ptr_l,
-      s_ptr_l,
-      monotone_splits,
-      monotonic_details_left,
-      naDirection
-    );
+    // With histogram splits, the children can derive their histograms from
+    // the ones of this node
+    histogram_node leftHistograms;
+    histogram_node rightHistograms;
+    if (histograms) {
+      leftHistograms.parent = histograms;
+      leftHistograms.sibling = &rightHistograms;
+      leftHistograms.averagingSampleIndex = &averagingLeftPartitionIndex;
+      leftHistograms.splittingSampleIndex = &splittingLeftPartitionIndex;
+      rightHistograms.parent = histograms;
+      rightHistograms.sibling = &leftHistograms;
+      rightHistograms.averagingSampleIndex = &averagingRightPartitionIndex;
+      rightHistograms.splittingSampleIndex = &splittingRightPartitionIndex;
+    }
 
-    // Recursively split on the right child node
-    recursivePartition(
-      rightChild.get(),
-      &averagingRightPartitionIndex,
-      &splittingRightPartitionIndex,
-      trainingData,
-      random_number_generator,
-      childDepth,
-      splitMiddle,
-      maxObs,
-      linear,
-      overfitPenalty,
-      g_ptr_r,
-      s_ptr_r,
-      monotone_splits,
-      monotonic_details_right,
-      naDirection
-    );
+    // Recursively split on the left and the right child node
+    auto growChild = [&](size_t child, std::mt19937_64& childGenerator) {
+      bool left = child == 0;
+      histogram_node* childHistograms = left ? &leftHistograms : &rightHistograms;
+      recursivePartition(
+        left ? leftChild.get() : rightChild.get(),
+        left ? &averagingLeftPartitionIndex : &averagingRightPartitionIndex,
+        left ? &splittingLeftPartitionIndex : &splittingRightPartitionIndex,
+        trainingData,
+        childGenerator,
+        childDepth,
+        splitMiddle,
+        maxObs,
+        linear,
+        overfitPenalty,
+        left ? g_ptr_l : g_ptr_r,
+        left ? s_ptr_l : s_ptr_r,
+        monotone_splits,
+        left ? monotonic_details_left : monotonic_details_right,
+        naDirection,
+        histograms ? childHistograms : nullptr
+      );
+    };
+
+    // A child derives its histograms from the ones of its sibling, so with
+    // histogram splits the children are always grown one after the other
+    if (isParallelNode(splittingSampleIndex) && !histograms) {
+      // Each child draws from its own generator, so the tree does not depend
+      // on which child finishes first
+      std::vector<std::mt19937_64> childGenerators;
+      childGenerators.push_back(std::mt19937_64(random_number_generator()));
+      childGenerators.push_back(std::mt19937_64(random_number_generator()));
+
+      getThreadPool().parallelFor(
+        0,
+        2,
+        getNthread(),
+        [&](size_t child) {
+          growChild(child, childGenerators[child]);
+        }
+      );
+    } else {
+      growChild(0, random_number_generator);
+      growChild(1, random_number_generator);
+    }
 
     (*rootNode).setSplitNode(
         bestSplitFeature,
@@ -960,18 +1569,41 @@ void forestryTree::selectBestFeature(
     std::shared_ptr< arma::Mat<double> > gtotal,
     std::shared_ptr< arma::Mat<double> > stotal,
     bool monotone_splits,
-    monotonic_info &monotone_details
+    monotonic_info &monotone_details,
+    histogram_node* histograms
 ){
 
   // Get the number of total features
   size_t mtry = (*featureList).size();
+  _featuresEvaluated += mtry;
+
+  // When the features are memory mapped and the node has at least as many
+  // samples as a feature has pages, nearly every page of the sampled features
+  // is read anyway, so they are read ahead while the first one is evaluated
+  if ((*trainingData).isMapped()) {
+    size_t nodeSize = (*splittingSampleIndex).size() +
+      (*averagingSampleIndex).size();
+    size_t rowsPerPage = mappedColumns::COLUMN_ALIGNMENT / sizeof(double);
+    if (nodeSize * rowsPerPage >= (*trainingData).getNumRows()) {
+      for (size_t i=0; i<mtry; i++) {
+        (*trainingData).prefetchFeature((*featureList)[i]);
+      }
+    }
+  }
 
-  // Initialize the minimum loss for each feature
-  double* bestSplitLossAll = new double[mtry];
-  double* bestSplitValueAll = new double[mtry];
-  size_t* bestSplitFeatureAll = new size_t[mtry];
-  size_t* bestSplitCountAll = new size_t[mtry];
-  int* bestSplitNaDirectionAll = new int[mtry];
+  // Initialize the minimum loss for each feature, in tables which are reused
+  // by the following nodes
+  arenaObject< feature_splits > featureSplits(_splitArena.get(), 0);
+  featureSplits->loss.resize(mtry);
+  featureSplits->value.resize(mtry);
+  featureSplits->feature.resize(mtry);
+  featureSplits->count.resize(mtry);
+  featureSplits->naDirection.resize(mtry);
+  double* bestSplitLossAll = featureSplits->loss.data();
+  double* bestSplitValueAll = featureSplits->value.data();
+  size_t* bestSplitFeatureAll = featureSplits->feature.data();
+  size_t* bestSplitCountAll = featureSplits->count.data();
+  int* bestSplitNaDirectionAll = featureSplits->naDirection.data();
 
   for (size_t i=0; i<mtry; i++) {
     bestSplitLossAll[i] = -std::numeric_limits<double>::infinity();
@@ -981,18 +1613,11 @@ void forestryTree::selectBestFeature(
     bestSplitNaDirectionAll[i] = 0;
   }
 
-  // Iterate each selected features
-  for (size_t i=0; i<mtry; i++) {
+  // Evaluates the ith selected feature
+  auto evaluateFeature = [&](size_t i, std::mt19937_64& featureGenerator) {
     size_t currentFeature = (*featureList)[i];
     // Test if the current feature is in the categorical list
-    std::vector<size_t> categorialCols = *(*trainingData).getCatCols();
-    if (
-        std::find(
-          categorialCols.begin(),
-          categorialCols.end(),
-          currentFeature
-        ) != categorialCols.end()
-    ){
+    if ((*trainingData).isCategorical(currentFeature)) {
       if (linear) {
         // Ridge split on categorical feature
         findBestSplitRidgeCategorical(
@@ -1007,7 +1632,7 @@ void forestryTree::selectBestFeature(
           trainingData,
           getMinNodeSizeToSplitSpt(),
           getMinNodeSizeToSplitAvg(),
-          random_number_generator,
+          featureGenerator,
           overfitPenalty,
           gtotal,
           stotal
@@ -1027,7 +1652,7 @@ void forestryTree::selectBestFeature(
           trainingData,
           getMinNodeSizeToSplitSpt(),
           getMinNodeSizeToSplitAvg(),
-          random_number_generator,
+          featureGenerator,
           maxObs
         );
       } else {
@@ -1035,6 +1660,8 @@ void forestryTree::selectBestFeature(
         findBestSplitValueCategorical(
           averagingSampleIndex,
           splittingSampleIndex,
+          getAveragingCounts(),
+          getSplittingCounts(),
           i,
           currentFeature,
           bestSplitLossAll,
@@ -1044,7 +1671,7 @@ void forestryTree::selectBestFeature(
           trainingData,
           getMinNodeSizeToSplitSpt(),
           getMinNodeSizeToSplitAvg(),
-          random_number_generator,
+          featureGenerator,
           maxObs
         );
       }
@@ -1061,7 +1688,7 @@ void forestryTree::selectBestFeature(
         trainingData,
         getMinNodeSizeToSplitSpt(),
         getMinNodeSizeToSplitAvg(),
-        random_number_generator,
+        featureGenerator,
         splitMiddle,
         maxObs,
         overfitPenalty,
@@ -1083,17 +1710,41 @@ void forestryTree::selectBestFeature(
         trainingData,
         getMinNodeSizeToSplitSpt(),
         getMinNodeSizeToSplitAvg(),
-        random_number_generator,
+        featureGenerator,
         splitMiddle,
         maxObs,
         monotone_splits,
         monotone_details
       );
+    } else if (histograms) {
+      // Run CART split on the histogram bins
+      findBestSplitValueHistogram(
+        averagingSampleIndex,
+        splittingSampleIndex,
+        i,
+        currentFeature,
+        bestSplitLossAll,
+        bestSplitValueAll,
+        bestSplitFeatureAll,
+        bestSplitCountAll,
+        trainingData,
+        getMinNodeSizeToSplitSpt(),
+        getMinNodeSizeToSplitAvg(),
+        featureGenerator,
+        splitMiddle,
+        maxObs,
+        monotone_splits,
+        monotone_details,
+        histograms,
+        _presortArena.get()
+      );
     } else {
       // Run Standard CART split
       findBestSplitValueNonCategorical(
         averagingSampleIndex,
         splittingSampleIndex,
+        getAveragingCounts(),
+        getSplittingCounts(),
         i,
         currentFeature,
         bestSplitLossAll,
@@ -1103,13 +1754,41 @@ void forestryTree::selectBestFeature(
         trainingData,
         getMinNodeSizeToSplitSpt(),
         getMinNodeSizeToSplitAvg(),
-        random_number_generator,
+        featureGenerator,
         splitMiddle,
         maxObs,
         monotone_splits,
-        monotone_details
+        monotone_details,
+        _presortArena.get()
       );
     }
+  };
+
+  // With histogram splits the features derive their histograms from the ones
+  // of the sibling node, which are built on demand, so they are always
+  // evaluated one after the other
+  if (isParallelNode(splittingSampleIndex) && !histograms) {
+    // Each feature draws from its own generator, so the split does not depend
+    // on the order in which the features are evaluated
+    std::vector<std::mt19937_64::result_type> featureSeeds(mtry);
+    for (size_t i=0; i<mtry; i++) {
+      featureSeeds[i] = random_number_generator();
+    }
+
+    getThreadPool().parallelFor(
+      0,
+      mtry,
+      getNthread(),
+      [&](size_t i) {
+        std::mt19937_64 featureGenerator(featureSeeds[i]);
+        evaluateFeature(i, featureGenerator);
+      }
+    );
+  } else {
+    // Iterate each selected features
+    for (size_t i=0; i<mtry; i++) {
+      evaluateFeature(i, random_number_generator);
+    }
   }
 
   determineBestSplit(
@@ -1144,290 +1823,126 @@ void forestryTree::selectBestFeature(
                      bestSplitFeature,
                      bestSplitValue);
   }
-
-  delete[](bestSplitLossAll);
-  delete[](bestSplitValueAll);
-  delete[](bestSplitFeatureAll);
-  delete[](bestSplitCountAll);
-  delete[](bestSplitNaDirectionAll);
 }
 
 void forestryTree::printTree(){
   (*getRoot()).printSubtree();
 }
 
-void forestryTree::getOOBindex(
+void forestryTree::getOOBIndex(
     std::vector<size_t> &outputOOBIndex,
-    std::vector<size_t> &allIndex
+    std::vector<char> &inBag,
+    DataFrame* trainingData,
+    bool excludeSplitting,
+    const std::vector<size_t>& training_idx
 ){
-
-  size_t nRows = allIndex.size();
-
-  // Generate union of splitting and averaging dataset
-  std::sort(
-    getSplittingIndex()->begin(),
-    getSplittingIndex()->end()
-  );
-  std::sort(
-    getAveragingIndex()->begin(),
-    getAveragingIndex()->end()
-  );
-  std::sort(
-          allIndex.begin(),
-          allIndex.end()
-  );
-
-  std::vector<size_t> allSampledIndex(
-      getSplittingIndex()->size() + getAveragingIndex()->size()
-  );
-
-  std::vector<size_t>::iterator it= std::set_union(
-    getSplittingIndex()->begin(),
-    getSplittingIndex()->end(),
-    getAveragingIndex()->begin(),
-    getAveragingIndex()->end(),
-    allSampledIndex.begin()
-  );
-
-  allSampledIndex.resize((unsigned long) (it - allSampledIndex.begin()));
-
-  // OOB index is the set difference between sampled index and all index
-  std::vector<size_t> OOBIndex(nRows);
-
-  it = std::set_difference (
-    allIndex.begin(),
-    allIndex.end(),
-    allSampledIndex.begin(),
-    allSampledIndex.end(),
-    OOBIndex.begin()
-  );
-  OOBIndex.resize((unsigned long) (it - OOBIndex.begin()));
-
-  for (
-      std::vector<size_t>::iterator it_ = OOBIndex.begin();
-      it_ != OOBIndex.end();
-      ++it_
-  ) {
-    outputOOBIndex.push_back(*it_);
+  // The observations in the bag are marked in inBag, or with groups the groups
+  // of these observations, and every candidate whose mark is not set is out of
+  // bag. The marks are removed again afterwards.
+  std::vector<size_t>* groups = trainingData->getGroups();
+  bool useGroups = groups->at(0) != 0;
+
+  size_t numAveraging = getAveragingIndexSize();
+  size_t numSplitting = excludeSplitting ? getSplittingIndexSize() : 0;
+
+  for (size_t k = 0; k < numAveraging; k++) {
+    size_t row = getAveragingIndexAt(k);
+    inBag[useGroups ? (*groups)[row] : row] = 1;
   }
-
-}
-
-void forestryTree::getDoubleOOBIndex(
-    std::vector<size_t> &outputOOBIndex,
-    std::vector<size_t> &allIndex
-){
-
-  size_t nRows = allIndex.size();
-  // This function is intended to be used with OOB honesty
-  // using a double bootstrap in order to get the observations which
-  // were not selected in the first bootstrap (the splitting set),
-  // and were not selected in the second bootstrap (the averaging set)
-  // we expect for each tree, this should be about  0.368^2 = 13.5%
-  // of the total observations.
-
-  // equivalent to setDiff(1:nrow(x), union(splittingIndices, averagingIndices))
-  // Generate union of splitting and averaging dataset
-  std::sort(
-    getSplittingIndex()->begin(),
-    getSplittingIndex()->end()
-  );
-  std::sort(
-    getAveragingIndex()->begin(),
-    getAveragingIndex()->end()
-  );
-
-  std::sort(
-          allIndex.begin(),
-          allIndex.end()
-  );
-
-  std::vector<size_t> allSampledIndex(
-      getSplittingIndex()->size() + getAveragingIndex()->size()
-  );
-
-  std::vector<size_t>::iterator it= std::set_union(
-    getSplittingIndex()->begin(),
-    getSplittingIndex()->end(),
-    getAveragingIndex()->begin(),
-    getAveragingIndex()->end(),
-    allSampledIndex.begin()
-  );
-
-  allSampledIndex.resize((unsigned long) (it - allSampledIndex.begin()));
-
-  // OOB index is the set difference between sampled index and all index
-  std::vector<size_t> OOBIndex(nRows);
-
-  it = std::set_difference (
-    allIndex.begin(),
-    allIndex.end(),
-    allSampledIndex.begin(),
-    allSampledIndex.end(),
-    OOBIndex.begin()
-  );
-  OOBIndex.resize((unsigned long) (it - OOBIndex.begin()));
-
-  for (
-      std::vector<size_t>::iterator it_ = OOBIndex.begin();
-      it_ != OOBIndex.end();
-      ++it_
-  ) {
-    outputOOBIndex.push_back(*it_);
+  for (size_t k = 0; k < numSplitting; k++) {
+    size_t row = getSplittingIndexAt(k);
+    inBag[useGroups ? (*groups)[row] : row] = 1;
   }
-}
-
-void forestryTree::getOOBhonestIndex(
-    std::vector<size_t> &outputOOBIndex,
-    std::vector<size_t> &allIndex
-){
-
-  size_t nRows = allIndex.size();
-
-  // Generate union of splitting and averaging dataset
-  std::sort(
-    getAveragingIndex()->begin(),
-    getAveragingIndex()->end()
-  );
 
-  // Super annoying problem, have to sort before doing set_diff
-  std::sort(
-          allIndex.begin(),
-          allIndex.end()
-  );
+  // Trees with in bag counts mark every row which was drawn at least once
+  const sample_counts* averagingCounts = getAveragingCounts();
+  const sample_counts* splittingCounts =
+    excludeSplitting ? getSplittingCounts() : nullptr;
+  size_t numCounted = averagingCounts ? averagingCounts->size() : 0;
+  for (size_t row = 0; row < numCounted; row++) {
+    if ((*averagingCounts)[row] > 0 ||
+        (splittingCounts && (*splittingCounts)[row] > 0)) {
+      inBag[useGroups ? (*groups)[row] : row] = 1;
+    }
+  }
 
+  bool use_training_idx = !training_idx.empty();
+  size_t numCandidates = use_training_idx ?
+    training_idx.size() : trainingData->getNumRows();
 
-  // OOB index is the set difference between sampled index and all index
-  std::vector<size_t> OOBIndex(nRows);
+  for (size_t i = 0; i < numCandidates; i++) {
+    size_t row = use_training_idx ? training_idx[i] : i;
+    if (!inBag[useGroups ? (*groups)[row] : row]) {
+      outputOOBIndex.push_back(i);
+    }
+  }
 
-  std::vector<size_t>::iterator it = std::set_difference (
-    allIndex.begin(),
-    allIndex.end(),
-    getAveragingIndex()->begin(),
-    getAveragingIndex()->end(),
-    OOBIndex.begin()
-  );
-  OOBIndex.resize((unsigned long) (it - OOBIndex.begin()));
+  for (size_t k = 0; k < numAveraging; k++) {
+    size_t row = getAveragingIndexAt(k);
+    inBag[useGroups ? (*groups)[row] : row] = 0;
+  }
+  for (size_t k = 0; k < numSplitting; k++) {
+    size_t row = getSplittingIndexAt(k);
+    inBag[useGroups ? (*groups)[row] : row] = 0;
+  }
+  for (size_t row = 0; row < numCounted; row++) {
+    inBag[useGroups ? (*groups)[row] : row] = 0;
+  }
 
-  for (
-      std::vector<size_t>::iterator it_ = OOBIndex.begin();
-      it_ != OOBIndex.end();
-      ++it_
-  ) {
-    outputOOBIndex.push_back(*it_);
+  // The observations are predicted in the order of the training rows, so that
+  // the random directions of missing values do not depend on the order of
+  // training_idx
+  if (use_training_idx) {
+    std::stable_sort(
+      outputOOBIndex.begin(),
+      outputOOBIndex.end(),
+      [&](size_t a, size_t b) -> bool {
+        return training_idx[a] < training_idx[b];
+      }
+    );
   }
 }
 
-void forestryTree::getOOGIndex(
-    std::vector<size_t> &outputOOBIndex,
-    std::vector<size_t> groupMemberships,
-    std::vector<size_t> &allIndex,
-    bool doubleOOB
+void forestryTree::getOOBIndex(
+    oob_scratch &scratch,
+    DataFrame* trainingData,
+    bool OOBhonest,
+    bool doubleOOB,
+    const std::vector<size_t>& training_idx
 ){
 
-  // For a given tree, we cycle through all averaging indices and get their
-  // group memberships. Then we take the set of observations which are in groups
-  // which haven't been seen by the current tree, and output this to outputOOBIndex
-  std::sort(
-    getAveragingIndex()->begin(),
-    getAveragingIndex()->end()
-  );
+  initializeOOBMask(scratch, trainingData);
 
-  std::sort(
-          allIndex.begin(),
-          allIndex.end()
+  // With OOB honesty the splitting set can be predicted, except for double
+  // OOB predictions. Without it, the splitting and averaging sets are both in
+  // the bag.
+  scratch.OOBIndex.clear();
+  getOOBIndex(
+    scratch.OOBIndex,
+    scratch.inBag,
+    trainingData,
+    !OOBhonest || doubleOOB,
+    training_idx
   );
-
-  // Add all in sample groups to a set
-  std::set<size_t> in_sample_groups;
-  for (std::vector<size_t>::iterator iter = getAveragingIndex()->begin();
-       iter != getAveragingIndex()->end();
-       iter++) {
-    in_sample_groups.insert(groupMemberships[*iter]);
-  }
-
-  // When doing double OOB predictions with groups, take neither groups in the
-  // averaging or splitting sets
-  if (doubleOOB) {
-      for (std::vector<size_t>::iterator iter = getSplittingIndex()->begin();
-           iter != getSplittingIndex()->end();
-           iter++) {
-          in_sample_groups.insert(groupMemberships[*iter]);
-      }
-  }
-
-  for (
-      std::vector<size_t>::iterator it_ = allIndex.begin();
-      it_ != allIndex.end();
-      ++it_
-  ) {
-    // If the group the current observation is in isn't included in the tree,
-    // we ad that observation to the Out of Group index set
-    if (in_sample_groups.find(groupMemberships[*it_]) == in_sample_groups.end()) {
-      outputOOBIndex.push_back(*it_);
-    }
-  }
 }
 
 void forestryTree::getOOBPrediction(
-    std::vector<double> &outputOOBPrediction,
-    std::vector<size_t> &outputOOBCount,
+    oob_scratch &scratch,
     DataFrame* trainingData,
     bool OOBhonest,
     bool doubleOOB,
     size_t nodesizeStrictAvg,
-    std::vector< std::vector<double> >* xNew,
-    arma::Mat<double>* weightMatrix,
+    std::vector<column_view>* xNew,
+    comembership_info* comembership,
     const std::vector<size_t>& training_idx
 ){
 
-  std::vector<size_t> OOBIndex;
-  bool use_training_idx = !(training_idx.size() == 0);
-  // OOB with and without using the OOB set as the averaging set requires
-  // different sets of trees to be used (we want the set of trees)
-  // without the averaging set
-
-  std::vector<size_t> allIndex(trainingData->getNumRows());
-  if (!use_training_idx) {
-      std::iota(allIndex.begin(), allIndex.end(), 0);
-  } else {
-      allIndex = training_idx;
-  }
-
-  if (trainingData->getGroups()->at(0) != 0) {
-    std::vector<size_t> group_membership_vector = *(trainingData->getGroups());
-    if (OOBhonest) {
-        getOOGIndex(OOBIndex,
-                    group_membership_vector,
-                    allIndex,
-                    doubleOOB);
-    } else {
-        getOOGIndex(OOBIndex,
-                    group_membership_vector,
-                    allIndex,
-                    true);
-    }
-
-  } else {
-    if (OOBhonest) {
-      if (doubleOOB) {
-        // Get setDiff(1:nrow(x), union(splittingIndices, averagingIndices))
-        getDoubleOOBIndex(OOBIndex, allIndex);
-      } else {
-        // Get setDiff(1:nrow(x), averagingIndices)
-        getOOBhonestIndex(OOBIndex, allIndex);
-      }
-    } else {
-      // Standard OOB indices in the non honest case
-      getOOBindex(OOBIndex, allIndex);
-    }
-  }
-  // Xnew has first access being the feature selection and second access being
-  // the observation selection.
+  getOOBIndex(scratch, trainingData, OOBhonest, doubleOOB, training_idx);
+  std::vector<size_t> &OOBIndex = scratch.OOBIndex;
 
   // Holds observations from training data corresponding to the OOB observations
   // for this tree.
-  std::vector< std::vector<double> >* OOBSampleObservations_;
+  std::vector<column_view>* OOBSampleObservations_;
 
   if (xNew == nullptr) {
     OOBSampleObservations_ = trainingData->getAllFeatureData();
@@ -1435,73 +1950,34 @@ void forestryTree::getOOBPrediction(
     OOBSampleObservations_ = xNew;
   }
 
-  std::vector<double> currentTreePrediction(OOBIndex.size());
-  std::vector<int>* currentTreeTerminalNodes = nullptr;
-  std::vector< std::vector<double> > currentTreeCoefficients(OOBIndex.size());
-  std::vector< std::vector<double> > xnew(trainingData->getNumColumns());
-
-  // If using training indices, need to make sure we get the correct rows in
-  // the new data, so make a map from OOB Indices for the tree -> row id in xnew
-  std::vector<size_t> idx_to_use;
-  std::map<size_t, size_t> map_trainidx;
-  std::vector<size_t> indexInTrain(OOBIndex.size());
-
-  if (use_training_idx) {
-
-      for (size_t i = 0; i < training_idx.size(); i++) {
-          map_trainidx[training_idx[i]] = i;
-      }
-
-      for (size_t k = 0; k < OOBIndex.size(); k++) {
-          indexInTrain[k] = ((size_t) map_trainidx.at(OOBIndex[k]));
-      }
+  size_t numColumns = trainingData->getNumColumns();
+  scratch.OOBFeatures.resize(numColumns);
+  for (size_t k = 0; k < numColumns; k++) {
+    std::vector<double> &column = scratch.OOBFeatures[k];
+    column.resize(OOBIndex.size());
+    for (size_t i = 0; i < OOBIndex.size(); i++) {
+      column[i] = (*OOBSampleObservations_)[k][OOBIndex[i]];
+    }
   }
 
-  for (size_t k = 0; k < trainingData->getNumColumns(); k++)
-    {
-      // Populate all values of the Kth feature
-      if (use_training_idx) {
-          for ( const auto& row_idx : OOBIndex) {
-              xnew[k].push_back((*OOBSampleObservations_)[k][map_trainidx.at(row_idx)]);
-          }
-      } else {
-          for (const auto& row_idx : OOBIndex) {
-              xnew[k].push_back((*OOBSampleObservations_)[k][row_idx]);
-          }
-      }
-    }
+  std::vector<column_view> OOBColumns = make_column_views(scratch.OOBFeatures);
+  std::vector< std::vector<double> > currentTreeCoefficients;
+  scratch.OOBPrediction.resize(OOBIndex.size());
 
   // Run predict on the new feature corresponding to all out of bag observations
   predict(
-    currentTreePrediction,
-    currentTreeTerminalNodes,
+    scratch.OOBPrediction,
+    nullptr,
     currentTreeCoefficients,
-    &xnew,
+    &OOBColumns,
     trainingData,
-    weightMatrix,
+    comembership,
     false,
     getNaDirection(),
-    44,
+    OOB_PREDICTION_SEED,
     nodesizeStrictAvg,
-    use_training_idx ? &indexInTrain : &OOBIndex
+    &OOBIndex
   );
-
-  // Now take only the OOB entries in the predictions
-  // If we are using training indices, use those
-  if (use_training_idx) {
-
-      for (size_t i = 0; i < OOBIndex.size(); i++) {
-          // Update the global OOB vector
-          outputOOBPrediction[map_trainidx.at(OOBIndex[i])] += currentTreePrediction[i];
-          outputOOBCount[map_trainidx.at(OOBIndex[i])] += 1;
-      }
-  } else {
-      for (size_t i = 0; i < OOBIndex.size(); i++) {
-          // Update the global OOB vector
-          outputOOBPrediction[OOBIndex[i]] += currentTreePrediction[i];
-          outputOOBCount[OOBIndex[i]] += 1;
-      }
-  }
 }
 
 // -----------------------------------------------------------------------------
@@ -1511,13 +1987,23 @@ std::unique_ptr<tree_info> forestryTree::getTreeInfo(
   std::unique_ptr<tree_info> treeInfo(
     new tree_info
   );
-  (*getRoot()).write_node_info(treeInfo, trainingData);
-
-  for (size_t i = 0; i<_averagingSampleIndex->size(); i++) {
-    treeInfo->averagingSampleIndex.push_back((*_averagingSampleIndex)[i] + 1);
+  if (getRoot()) {
+    (*getRoot()).write_node_info(treeInfo, trainingData);
+  } else {
+    writeNodeTableInfo(treeInfo);
   }
-  for (size_t i = 0; i<_splittingSampleIndex->size(); i++) {
-    treeInfo->splittingSampleIndex.push_back((*_splittingSampleIndex)[i] + 1);
+
+  // Slim trees no longer have their sample indices
+  if (!isSlim()) {
+    std::vector<size_t> averagingSampleIndex;
+    std::vector<size_t> splittingSampleIndex;
+    getSampleIndex(averagingSampleIndex, splittingSampleIndex);
+    for (size_t row : averagingSampleIndex) {
+      treeInfo->averagingSampleIndex.push_back(row + 1);
+    }
+    for (size_t row : splittingSampleIndex) {
+      treeInfo->splittingSampleIndex.push_back(row + 1);
+    }
   }
 
   // set seed of the current tree
@@ -1526,6 +2012,94 @@ std::unique_ptr<tree_info> forestryTree::getTreeInfo(
   return treeInfo;
 }
 
+void forestryTree::writeNodeTableInfo(
+    std::unique_ptr<tree_info> & treeInfo
+){
+  // The node table is in the same depth first order as write_node_info, but
+  // does not keep the splitting counts of the leaves, which are written as 0
+  node_table* nodeTable = getNodeTable();
+  for (size_t i = 0; i < nodeTable->splitFeature.size(); i++) {
+    if (nodeTable->splitFeature[i] < 0) {
+      treeInfo->var_id.push_back(-((int) nodeTable->averageCount[i]));
+      treeInfo->var_id.push_back(0);
+      treeInfo->split_val.push_back(0);
+      treeInfo->naLeftCount.push_back(-1);
+      treeInfo->naRightCount.push_back(-1);
+      treeInfo->naDefaultDirection.push_back(0);
+
+      treeInfo->num_avg_samples.push_back(nodeTable->averageCount[i]);
+      treeInfo->num_spl_samples.push_back(0);
+      treeInfo->values.push_back(nodeTable->splitValue[i]);
+    } else {
+      treeInfo->var_id.push_back(nodeTable->splitFeature[i] + 1);
+      treeInfo->split_val.push_back(nodeTable->splitValue[i]);
+      treeInfo->naLeftCount.push_back(nodeTable->naLeftCount[i]);
+      treeInfo->naRightCount.push_back(nodeTable->naRightCount[i]);
+      treeInfo->naDefaultDirection.push_back(nodeTable->naDefaultDirection[i]);
+    }
+  }
+}
+
+void forestryTree::slim() {
+  _averagingSampleIndex.reset();
+  _splittingSampleIndex.reset();
+  _compactAveragingSampleIndex.reset();
+  _compactSplittingSampleIndex.reset();
+  _averagingCounts.reset();
+  _splittingCounts.reset();
+  // Ridge leaves keep their coefficients in the nodes, all other predictions
+  // are made from the node table
+  if (!_linear && getNodeTable()) {
+    _root.reset();
+  }
+
+  // The node table was grown one node at a time
+  node_table* nodeTable = getNodeTable();
+  if (nodeTable) {
+    nodeTable->splitFeature.shrink_to_fit();
+    nodeTable->splitValue.shrink_to_fit();
+    nodeTable->rightChild.shrink_to_fit();
+    nodeTable->categoricalSplit.shrink_to_fit();
+    nodeTable->naDefaultDirection.shrink_to_fit();
+    nodeTable->naLeftCount.shrink_to_fit();
+    nodeTable->naRightCount.shrink_to_fit();
+    nodeTable->averageCount.shrink_to_fit();
+    nodeTable->nodeId.shrink_to_fit();
+  }
+  _slim = true;
+}
+
+size_t forestryTree::getMemoryUsage() {
+  size_t numNodes = getNodeTable() ? getNodeTable()->splitFeature.size() : 0;
+  size_t bytes = sizeof(forestryTree);
+  if (getRoot()) {
+    bytes += numNodes * sizeof(RFNode);
+  }
+  if (getNodeTable()) {
+    bytes += numNodes * (sizeof(int) + sizeof(double) + sizeof(char) +
+      sizeof(int) + 5 * sizeof(size_t));
+  }
+  if (getAveragingIndex()) {
+    bytes += getAveragingIndex()->size() * sizeof(size_t);
+  }
+  if (getSplittingIndex()) {
+    bytes += getSplittingIndex()->size() * sizeof(size_t);
+  }
+  if (_compactAveragingSampleIndex) {
+    bytes += _compactAveragingSampleIndex->size() * sizeof(uint32_t);
+  }
+  if (_compactSplittingSampleIndex) {
+    bytes += _compactSplittingSampleIndex->size() * sizeof(uint32_t);
+  }
+  if (getAveragingCounts()) {
+    bytes += getAveragingCounts()->getMemoryUsage();
+  }
+  if (getSplittingCounts()) {
+    bytes += getSplittingCounts()->getMemoryUsage();
+  }
+  return bytes;
+}
+
 void forestryTree::reconstruct_tree(
     size_t mtry,
     size_t minNodeSizeSpt,
@@ -1541,14 +2115,7 @@ void forestryTree::reconstruct_tree(
     double overfitPenalty,
     unsigned int seed,
     std::vector<size_t> categoricalFeatureColsRcpp,
-    std::vector<int> var_ids,
-    std::vector<double> split_vals,
-    std::vector<int> naLeftCounts,
-    std::vector<int> naRightCounts,
-    std::vector<int> naDefaultDirections,
-    std::vector<size_t> averagingSampleIndex,
-    std::vector<size_t> splittingSampleIndex,
-    std::vector<double> predictWeights
+    const tree_info_view &treeArrays
     ){
   // Setting all the parameters:
   _mtry = mtry;
@@ -1564,69 +2131,78 @@ void forestryTree::reconstruct_tree(
   _linear = linear;
   _overfitPenalty = overfitPenalty;
   _nodeCount = 0;
+  _featuresEvaluated = 0;
   _seed = seed;
+  _slim = false;
 
   _averagingSampleIndex = std::unique_ptr< std::vector<size_t> > (
     new std::vector<size_t>
   );
-  for(size_t i=0; i<averagingSampleIndex.size(); i++){
-    (*_averagingSampleIndex).push_back(averagingSampleIndex[i] - 1);
+  _averagingSampleIndex->reserve(treeArrays.numAveraging);
+  for(size_t i=0; i<treeArrays.numAveraging; i++){
+    (*_averagingSampleIndex).push_back(treeArrays.averagingSampleIndex[i] - 1);
   }
   _splittingSampleIndex = std::unique_ptr< std::vector<size_t> > (
     new std::vector<size_t>
   );
-  for(size_t i=0; i<splittingSampleIndex.size(); i++){
-    (*_splittingSampleIndex).push_back(splittingSampleIndex[i] - 1);
+  _splittingSampleIndex->reserve(treeArrays.numSplitting);
+  for(size_t i=0; i<treeArrays.numSplitting; i++){
+    (*_splittingSampleIndex).push_back(treeArrays.splittingSampleIndex[i] - 1);
   }
 
   std::unique_ptr< RFNode > root ( new RFNode() );
   this->_root = std::move(root);
 
+  size_t varIdPosition = 0;
+  size_t splitValPosition = 0;
+  size_t valuePosition = 0;
   recursive_reconstruction(
     _root.get(),
-    &var_ids,
-    &split_vals,
-    &naLeftCounts,
-    &naRightCounts,
-    &naDefaultDirections,
-    &predictWeights
+    treeArrays,
+    varIdPosition,
+    splitValPosition,
+    valuePosition
   );
 
+  compileNodeTable(&categoricalFeatureColsRcpp);
+
   return ;
 }
 
 
 void forestryTree::recursive_reconstruction(
   RFNode* currentNode,
-  std::vector<int> * var_ids,
-  std::vector<double> * split_vals,
-  std::vector<int> * naLeftCounts,
-  std::vector<int> * naRightCounts,
-  std::vector<int> * naDefaultDirections,
-  std::vector<double> * weights
+  const tree_info_view &treeArrays,
+  size_t &varIdPosition,
+  size_t &splitValPosition,
+  size_t &valuePosition
 ) {
-  int var_id = (*var_ids)[0];
-    (*var_ids).erase((*var_ids).begin());
-  double  split_val = (*split_vals)[0];
-    (*split_vals).erase((*split_vals).begin());
-
-    size_t naLeftCount = (*naLeftCounts)[0];
-    (*naLeftCounts).erase((*naLeftCounts).begin());
-    size_t naRightCount = (*naRightCounts)[0];
-    (*naRightCounts).erase((*naRightCounts).begin());
-    int naDefaultDirection = (*naDefaultDirections)[0];
-    (*naDefaultDirections).erase((*naDefaultDirections).begin());
+  // The arrays are read front to back through the positions, which advance
+  // as the nodes are consumed in the order they were written
+  if (varIdPosition >= treeArrays.numVarIds ||
+      splitValPosition >= treeArrays.numSplitVals) {
+    throw std::runtime_error("The tree information ends before the tree is complete.");
+  }
+  int var_id = treeArrays.var_id[varIdPosition++];
+  double split_val = treeArrays.split_val[splitValPosition];
+
+  size_t naLeftCount = treeArrays.naLeftCount[splitValPosition];
+  size_t naRightCount = treeArrays.naRightCount[splitValPosition];
+  int naDefaultDirection = treeArrays.naDefaultDirection[splitValPosition];
+  splitValPosition++;
 
   if(var_id < 0){
     // This is a terminal node
     int nAve = std::abs((int) var_id);
+    if (varIdPosition >= treeArrays.numVarIds ||
+        valuePosition >= treeArrays.numValues) {
+      throw std::runtime_error("The tree information ends before the tree is complete.");
+    }
     // Pull second entry in var_ids if it is a leaf node
-    int nSpl = std::abs((int) (*var_ids)[0]);
-    (*var_ids).erase((*var_ids).begin());
+    int nSpl = std::abs((int) treeArrays.var_id[varIdPosition++]);
 
     // Pull the prediction weight for the node
-    double predictionWeight = (*weights)[0];
-    weights->erase(weights->begin());
+    double predictionWeight = treeArrays.values[valuePosition++];
 
     size_t node_id;
     std::vector<double> wts;
@@ -1650,22 +2226,18 @@ void forestryTree::recursive_reconstruction(
 
     recursive_reconstruction(
       leftChild.get(),
-      var_ids,
-      split_vals,
-      naLeftCounts,
-      naRightCounts,
-      naDefaultDirections,
-      weights
-      );
+      treeArrays,
+      varIdPosition,
+      splitValPosition,
+      valuePosition
+    );
 
     recursive_reconstruction(
       rightChild.get(),
-      var_ids,
-      split_vals,
-      naLeftCounts,
-      naRightCounts,
-      naDefaultDirections,
-      weights
+      treeArrays,
+      varIdPosition,
+      splitValPosition,
+      valuePosition
     );
 
     (*currentNode).setSplitNode(
@@ -6,14 +6,22 @@
 #include <string>
 #include <random>
 #include <chrono>
+#include <atomic>
+#include <cstdint>
 #include "DataFrame.h"
 #include "RFNode.h"
 #include "utils.h"
+#include "objectArena.h"
+#include "sampling.h"
 #include <armadillo>
 
 class forestryTree {
 
 public:
+  // The seed of the random directions of missing values in the OOB
+  // predictions, which the permutation importance follows as well
+  static const unsigned int OOB_PREDICTION_SEED = 44;
+
   forestryTree();
   virtual ~forestryTree();
 
@@ -36,7 +44,12 @@ public:
     bool naDirection,
     bool linear,
     double overfitPenalty,
-    unsigned int seed
+    unsigned int seed,
+    bool histogramSplit,
+    size_t nodeParallelSize,
+    bool compactSplits,
+    bool inBagCounts,
+    size_t nthread
   );
 
   // This tree is only for testing purpose
@@ -58,9 +71,9 @@ public:
     std::vector<double> &outputPrediction,
     std::vector<int>* terminalNodes,
     std::vector< std::vector<double> > &outputCoefficients,
-    std::vector< std::vector<double> >* xNew,
+    std::vector<column_view>* xNew,
     DataFrame* trainingData,
-    arma::Mat<double>* weightMatrix = NULL,
+    comembership_info* comembership = NULL,
     bool linear = false,
     bool naDirection = false,
     unsigned int seed = 44,
@@ -68,10 +81,39 @@ public:
     std::vector<size_t>* OOBIndex = NULL
   );
 
+  void compileNodeTable(
+    std::vector<size_t>* categoricalCols
+  );
+
+  void predictNodeTable(
+    std::vector<double> &outputPrediction,
+    std::vector<int>* terminalNodes,
+    std::vector<column_view>* xNew,
+    bool naDirection,
+    unsigned int seed
+  );
+
+  double predictRow(
+    std::vector<double>* xNew,
+    bool naDirection,
+    unsigned int seed
+  );
+
   std::unique_ptr<tree_info> getTreeInfo(
       DataFrame* trainingData
   );
 
+  void writeNodeTableInfo(
+      std::unique_ptr<tree_info> & treeInfo
+  );
+
+  // Frees the sample indices and, for trees without ridge leaves, the nodes,
+  // keeping only what is needed to predict with aggregation = "average"
+  void slim();
+
+  // Returns the approximate number of bytes held by the tree
+  size_t getMemoryUsage();
+
   void reconstruct_tree(
       size_t mtry,
       size_t minNodeSizeSpt,
@@ -87,23 +129,14 @@ public:
       double overfitPenalty,
       unsigned int seed,
       std::vector<size_t> categoricalFeatureColsRcpp,
-      std::vector<int> var_ids,
-      std::vector<double> split_vals,
-      std::vector<int> naLeftCounts,
-      std::vector<int> naRightCounts,
-      std::vector<int> naDefaultDirections,
-      std::vector<size_t> averagingSampleIndex,
-      std::vector<size_t> splittingSampleIndex,
-      std::vector<double> predictWeights);
+      const tree_info_view &treeArrays);
 
   void recursive_reconstruction(
       RFNode* currentNode,
-      std::vector<int> * var_ids,
-      std::vector<double> * split_vals,
-      std::vector<int> * naLeftCounts,
-      std::vector<int> * naRightCounts,
-      std::vector<int> * naDefaultDirections,
-      std::vector<double> * weights
+      const tree_info_view &treeArrays,
+      size_t &varIdPosition,
+      size_t &splitValPosition,
+      size_t &valuePosition
   );
 
   void recursivePartition(
@@ -120,8 +153,9 @@ public:
     std::shared_ptr< arma::Mat<double> > gtotal,
     std::shared_ptr< arma::Mat<double> > stotal,
     bool monotone_splits,
-    monotonic_info monotone_details,
-    bool naDirection
+    monotonic_info &monotone_details,
+    bool naDirection,
+    histogram_node* histograms
   );
 
   void selectBestFeature(
@@ -145,7 +179,8 @@ public:
       std::shared_ptr< arma::Mat<double> > gtotal,
       std::shared_ptr< arma::Mat<double> > stotal,
       bool monotone_splits,
-      monotonic_info &monotone_details
+      monotonic_info &monotone_details,
+      histogram_node* histograms
   );
 
   void initializelinear(
@@ -160,40 +195,62 @@ public:
 
   void trainTiming();
 
-  void getOOBindex(
+  // Appends the positions of the observations which are out of bag for this
+  // tree, among the rows in training_idx or all training rows when it is
+  // empty. inBag is a mask indexed by training row, or by group when the
+  // training data has groups, which has to be all zero and is left all zero.
+  void getOOBIndex(
     std::vector<size_t> &outputOOBIndex,
-    std::vector<size_t> &allIndex
-  );
-
-  void getDoubleOOBIndex(
-      std::vector<size_t> &outputOOBIndex,
-      std::vector<size_t> &allIndex
-  );
-
-  void getOOBhonestIndex(
-      std::vector<size_t> &outputOOBIndex,
-      std::vector<size_t> &allIndex
+    std::vector<char> &inBag,
+    DataFrame* trainingData,
+    bool excludeSplitting,
+    const std::vector<size_t>& training_idx
   );
 
-  void getOOGIndex(
-      std::vector<size_t> &outputOOBIndex,
-      std::vector<size_t> groupMemberships,
-      std::vector<size_t> &allIndex,
-      bool doubleOOB
+  // Leaves the positions of the observations getOOBPrediction predicts in
+  // scratch.OOBIndex, without predicting them
+  void getOOBIndex(
+    oob_scratch &scratch,
+    DataFrame* trainingData,
+    bool OOBhonest,
+    bool doubleOOB,
+    const std::vector<size_t>& training_idx
   );
 
+  // Predicts the observations which are out of bag for this tree, leaving their
+  // positions in scratch.OOBIndex and the predictions in scratch.OOBPrediction
   void getOOBPrediction(
-    std::vector<double> &outputOOBPrediction,
-    std::vector<size_t> &outputOOBCount,
+    oob_scratch &scratch,
     DataFrame* trainingData,
     bool OOBhonest,
     bool doubleOOB,
     size_t nodesizeStrictAvg,
-    std::vector< std::vector<double> >* xNew,
-    arma::Mat<double>* weightMatrix,
+    std::vector<column_view>* xNew,
+    comembership_info* comembership,
     const std::vector<size_t>& training_idx
   );
 
+  // Marks the features which the tree splits on in splitFeatures, which holds
+  // an entry for every feature
+  void getSplitFeatures(
+    std::vector<char> &splitFeatures
+  );
+
+  // Adds to predictionChange, for every training observation which is out of
+  // bag for this tree, how much its prediction changes when its value of
+  // permutedFeature is taken from the training row permutation[row] instead.
+  // Only the observations whose path reaches a split on the feature are
+  // predicted again, from that split on. Missing values are sent in the
+  // directions getOOBPrediction sends them.
+  void addPermutedOOBChange(
+    std::vector<double> &predictionChange,
+    oob_scratch &scratch,
+    DataFrame* trainingData,
+    bool OOBhonest,
+    size_t permutedFeature,
+    const std::vector<size_t> &permutation
+  );
+
   size_t getMtry() {
     return _mtry;
   }
@@ -226,6 +283,10 @@ public:
     return _interactionDepth;
   }
 
+  // Compact trees keep their sample indices in uint32 and return nullptr
+  // here, the ...Size and ...At accessors read the indices of either width.
+  // Trees grown with in bag counts keep no index lists once they are grown,
+  // getSampleIndex gives the samples of every tree.
   std::vector<size_t>* getSplittingIndex() {
     return _splittingSampleIndex.get();
   }
@@ -234,10 +295,61 @@ public:
     return _averagingSampleIndex.get();
   }
 
+  size_t getSplittingIndexSize() {
+    return _compactSplittingSampleIndex ?
+      _compactSplittingSampleIndex->size() :
+      (_splittingSampleIndex ? _splittingSampleIndex->size() : 0);
+  }
+
+  size_t getSplittingIndexAt(size_t k) {
+    return _compactSplittingSampleIndex ?
+      (size_t) (*_compactSplittingSampleIndex)[k] :
+      (*_splittingSampleIndex)[k];
+  }
+
+  size_t getAveragingIndexSize() {
+    return _compactAveragingSampleIndex ?
+      _compactAveragingSampleIndex->size() :
+      (_averagingSampleIndex ? _averagingSampleIndex->size() : 0);
+  }
+
+  size_t getAveragingIndexAt(size_t k) {
+    return _compactAveragingSampleIndex ?
+      (size_t) (*_compactAveragingSampleIndex)[k] :
+      (*_averagingSampleIndex)[k];
+  }
+
+  // Narrows the sample indices to uint32 once the tree is grown, as compact
+  // forests do. Does nothing when a row does not fit in 32 bits.
+  void compactSampleIndex();
+
+  // Replaces the sample indices by the in bag counts of the numRows
+  // observations, as trees grown with inBagCounts keep them
+  void countSampleIndex(size_t numRows);
+
+  sample_counts* getSplittingCounts() {
+    return _splittingCounts.get();
+  }
+
+  sample_counts* getAveragingCounts() {
+    return _averagingCounts.get();
+  }
+
+  // Fills the averaging and splitting samples of the tree, with every row as
+  // often as it was drawn, from whichever form the tree keeps them in
+  void getSampleIndex(
+    std::vector<size_t> &averagingSampleIndex,
+    std::vector<size_t> &splittingSampleIndex
+  );
+
   RFNode* getRoot() {
     return _root.get();
   }
 
+  node_table* getNodeTable() {
+    return _nodeTable.get();
+  }
+
   double getOverfitPenalty() {
     return _overfitPenalty;
   }
@@ -254,14 +366,51 @@ public:
     return _naDirection;
   }
 
+  bool getHistogramSplit() {
+    return _histogramSplit;
+  }
+
+  size_t getNodeParallelSize() {
+    return _nodeParallelSize;
+  }
+
+  bool getCompactSplits() {
+    return _compactSplits;
+  }
+
+  size_t getNthread() {
+    return _nthread;
+  }
+
+  // Nodes with at least nodeParallelSize splitting observations evaluate their
+  // features and grow their children in parallel
+  bool isParallelNode(std::vector<size_t>* splittingSampleIndex) {
+    return _nodeParallelSize > 0 &&
+      counted_size(splittingSampleIndex, getSplittingCounts()) >=
+        _nodeParallelSize;
+  }
+
   void assignNodeId(size_t& node_i) {
     node_i = ++_nodeCount;
   }
 
+  // Gives the leaves below node consecutive ids from left to right, the same
+  // ids they are assigned when the tree is grown serially
+  void renumberLeaves(RFNode* node);
+
   size_t getNodeCount() {
     return _nodeCount;
   }
 
+  // Returns how often the split search ran on a feature of a node
+  size_t getFeaturesEvaluated() {
+    return _featuresEvaluated;
+  }
+
+  bool isSlim() {
+    return _slim;
+  }
+
 private:
   size_t _mtry;
   size_t _minNodeSizeSpt;
@@ -273,13 +422,30 @@ private:
   size_t _interactionDepth;
   std::unique_ptr< std::vector<size_t> > _averagingSampleIndex;
   std::unique_ptr< std::vector<size_t> > _splittingSampleIndex;
+  std::unique_ptr< std::vector<uint32_t> > _compactAveragingSampleIndex;
+  std::unique_ptr< std::vector<uint32_t> > _compactSplittingSampleIndex;
+  std::unique_ptr< sample_counts > _averagingCounts;
+  std::unique_ptr< sample_counts > _splittingCounts;
   std::unique_ptr< RFNode > _root;
   bool _hasNas;
   bool _naDirection;
   bool _linear;
   double _overfitPenalty;
   unsigned int _seed;
-  size_t _nodeCount;
+  std::atomic<size_t> _nodeCount;
+  std::atomic<size_t> _featuresEvaluated;
+  bool _histogramSplit;
+  size_t _nodeParallelSize;
+  bool _compactSplits;
+  size_t _nthread;
+  std::unique_ptr< node_table > _nodeTable;
+  bool _slim;
+  // Hand out the partition index vectors, the per feature split tables and
+  // the presorted split counts of the nodes while the tree is grown, and are
+  // freed afterwards
+  std::unique_ptr< objectArena< std::vector<size_t> > > _indexArena;
+  std::unique_ptr< objectArena< feature_splits > > _splitArena;
+  std::unique_ptr< objectArena< presort_counts > > _presortArena;
 };
 
 
@@ -0,0 +1,26 @@
+#include "instrumentation.h"
+
+// Whether the forests collect their instrumentation
+static std::atomic<bool> instrumentationEnabled(false);
+
+std::string instrumentedPhaseName(size_t phase) {
+  static const char* names[NUM_INSTRUMENTED_PHASES] = {
+    "sampling",
+    "growing",
+    "runningOOB",
+    "predict",
+    "weightMatrix",
+    "predictOOB",
+    "serialize",
+    "reconstruct"
+  };
+  return phase < NUM_INSTRUMENTED_PHASES ? names[phase] : "";
+}
+
+void setInstrumentationEnabled(bool enabled) {
+  instrumentationEnabled = enabled;
+}
+
+bool isInstrumentationEnabled() {
+  return instrumentationEnabled;
+}
@@ -0,0 +1,104 @@
+#ifndef FORESTRYCPP_INSTRUMENTATION_H
+#define FORESTRYCPP_INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// The phases of training and prediction which are timed separately
+enum instrumented_phase {
+  PHASE_SAMPLING = 0,
+  PHASE_GROWING,
+  PHASE_RUNNING_OOB,
+  PHASE_PREDICT,
+  PHASE_WEIGHT_MATRIX,
+  PHASE_PREDICT_OOB,
+  PHASE_SERIALIZE,
+  PHASE_RECONSTRUCT,
+  NUM_INSTRUMENTED_PHASES
+};
+
+// Returns the name of a phase as it is reported to R
+std::string instrumentedPhaseName(size_t phase);
+
+// Collection is off by default and switched on for the whole process. While it
+// is on, every forest adds the time it spends in each phase and the work it
+// does to its own forestry_instrumentation.
+void setInstrumentationEnabled(bool enabled);
+
+bool isInstrumentationEnabled();
+
+// Contains the time spent in each phase, summed over the threads which worked
+// on it, and counters of the work done. The members can be updated from
+// several threads at the same time.
+struct forestry_instrumentation {
+  std::atomic<unsigned long long> phaseNanoseconds[NUM_INSTRUMENTED_PHASES];
+  std::atomic<unsigned long long> phaseCalls[NUM_INSTRUMENTED_PHASES];
+  std::atomic<unsigned long long> treesGrown;
+  std::atomic<unsigned long long> nodesGrown;
+  // contains the number of leaves of the grown trees, as getTotalNodeCount
+  std::atomic<unsigned long long> featuresEvaluated;
+  // contains the number of times the split search ran on a feature of a node
+  std::atomic<unsigned long long> rowsPredicted;
+  std::atomic<unsigned long long> bytesAllocated;
+  // contains the bytes of the trees grown or reconstructed, as getMemoryUsage,
+  // and of the prediction buffers. The transient scratch of the split search
+  // and the armadillo matrices passed in by the caller are not counted.
+
+  forestry_instrumentation() {
+    reset();
+  }
+
+  void reset() {
+    for (size_t i = 0; i < NUM_INSTRUMENTED_PHASES; i++) {
+      phaseNanoseconds[i] = 0;
+      phaseCalls[i] = 0;
+    }
+    treesGrown = 0;
+    nodesGrown = 0;
+    featuresEvaluated = 0;
+    rowsPredicted = 0;
+    bytesAllocated = 0;
+  }
+};
+
+// Adds the time from its construction to its destruction, or to the call of
+// stop, to a phase when instrumentation was enabled at construction
+class phaseTimer {
+
+public:
+  phaseTimer(forestry_instrumentation* stats, instrumented_phase phase):
+    _stats(isInstrumentationEnabled() ? stats : nullptr), _phase(phase) {
+    if (_stats) {
+      _start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~phaseTimer() {
+    stop();
+  }
+
+  // Ends the timed part before the timer goes out of scope
+  void stop() {
+    if (_stats) {
+      std::chrono::nanoseconds elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - _start
+        );
+      _stats->phaseNanoseconds[_phase] +=
+        (unsigned long long) elapsed.count();
+      _stats->phaseCalls[_phase]++;
+      _stats = nullptr;
+    }
+  }
+
+private:
+  phaseTimer(const phaseTimer&);
+  phaseTimer& operator=(const phaseTimer&);
+
+  forestry_instrumentation* _stats;
+  instrumented_phase _phase;
+  std::chrono::steady_clock::time_point _start;
+};
+
+#endif //FORESTRYCPP_INSTRUMENTATION_H
@@ -0,0 +1,147 @@
+#include "mappedColumns.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+static const char COLUMN_FILE_MAGIC[8] = {'R', 'F', 'O', 'R', 'E', 'S', 'T', 'C'};
+static const uint32_t COLUMN_FILE_VERSION = 2;
+static const uint32_t COLUMN_FILE_BYTE_ORDER = 0x01020304;
+
+struct column_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t numRows;
+  uint64_t numColumns;
+  // contains the bytes of one value, 8 for doubles and 4 for floats. Files of
+  // version 1 always store doubles.
+  uint32_t valueBytes;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(column_file_header) <= mappedColumns::COLUMN_ALIGNMENT,
+              "The column file header does not fit before the first column");
+
+// Returns the number of bytes of a column padded to the column alignment
+static size_t columnStride(size_t numRows, size_t valueBytes) {
+  size_t bytes = numRows * valueBytes;
+  return bytes + (mappedColumns::COLUMN_ALIGNMENT -
+    bytes % mappedColumns::COLUMN_ALIGNMENT) % mappedColumns::COLUMN_ALIGNMENT;
+}
+
+mappedColumns::mappedColumns(const std::string& filename):
+  _file(filename), _numRows(0), _numColumns(0), _valueBytes(sizeof(double)) {
+
+  column_file_header header;
+  if (_file.getSize() < sizeof(header)) {
+    throw std::runtime_error("The file " + filename + " is not a column file.");
+  }
+  std::memcpy(&header, _file.getData(), sizeof(header));
+  if (std::memcmp(header.magic, COLUMN_FILE_MAGIC, sizeof(header.magic)) != 0) {
+    throw std::runtime_error("The file " + filename + " is not a column file.");
+  }
+  if (header.byteOrder != COLUMN_FILE_BYTE_ORDER) {
+    throw std::runtime_error("The column file was written on a machine with a different byte order.");
+  }
+  if (header.version != 1 && header.version != COLUMN_FILE_VERSION) {
+    throw std::runtime_error("The column file has the unsupported version " +
+                             std::to_string(header.version) + ".");
+  }
+
+  if (header.version > 1) {
+    if (header.valueBytes != sizeof(double) &&
+        header.valueBytes != sizeof(float)) {
+      throw std::runtime_error("The column file stores values of an unsupported size.");
+    }
+    _valueBytes = (size_t) header.valueBytes;
+  }
+
+  _numRows = (size_t) header.numRows;
+  _numColumns = (size_t) header.numColumns;
+  if (_numColumns > 0 &&
+      (_file.getSize() < COLUMN_ALIGNMENT ||
+       (_file.getSize() - COLUMN_ALIGNMENT) / _numColumns <
+         columnStride(_numRows, _valueBytes))) {
+    throw std::runtime_error("The column file is truncated.");
+  }
+}
+
+mappedColumns::~mappedColumns() {}
+
+size_t mappedColumns::columnOffset(size_t colIndex) const {
+  return COLUMN_ALIGNMENT + colIndex * columnStride(_numRows, _valueBytes);
+}
+
+void mappedColumns::write(
+  const std::string& filename,
+  const std::vector<column_view>& columns,
+  bool float32
+) {
+  std::ofstream output(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Cannot open the file " + filename + " for writing.");
+  }
+
+  column_file_header header;
+  std::memcpy(header.magic, COLUMN_FILE_MAGIC, sizeof(header.magic));
+  header.version = COLUMN_FILE_VERSION;
+  header.byteOrder = COLUMN_FILE_BYTE_ORDER;
+  header.numRows = columns.empty() ? 0 : columns[0].size();
+  header.numColumns = columns.size();
+  header.valueBytes = float32 ? sizeof(float) : sizeof(double);
+  header.reserved = 0;
+
+  std::vector<char> zeros(COLUMN_ALIGNMENT, 0);
+  output.write((const char*) &header, sizeof(header));
+  output.write(zeros.data(), COLUMN_ALIGNMENT - sizeof(header));
+
+  size_t numRows = (size_t) header.numRows;
+  size_t valueBytes = (size_t) header.valueBytes;
+  size_t padding = columnStride(numRows, valueBytes) - numRows * valueBytes;
+  std::vector<double> doubleValues;
+  std::vector<float> floatValues;
+  for (size_t j = 0; j < columns.size(); j++) {
+    if (columns[j].size() != numRows) {
+      throw std::runtime_error("All columns of a column file must have the same number of rows.");
+    }
+    if (float32) {
+      floatValues.resize(numRows);
+      for (size_t i = 0; i < numRows; i++) {
+        floatValues[i] = (float) columns[j][i];
+      }
+      output.write((const char*) floatValues.data(), numRows * valueBytes);
+    } else {
+      doubleValues.resize(numRows);
+      for (size_t i = 0; i < numRows; i++) {
+        doubleValues[i] = columns[j][i];
+      }
+      output.write((const char*) doubleValues.data(), numRows * valueBytes);
+    }
+    output.write(zeros.data(), padding);
+  }
+
+  if (!output) {
+    throw std::runtime_error("Cannot write the file " + filename + ".");
+  }
+}
+
+std::vector<column_view> mappedColumns::getColumns() const {
+  std::vector<column_view> columns;
+  columns.reserve(_numColumns);
+  for (size_t j = 0; j < _numColumns; j++) {
+    const char* columnData = _file.getData() + columnOffset(j);
+    if (isFloat32()) {
+      columns.push_back(column_view((const float*) columnData, _numRows));
+    } else {
+      columns.push_back(column_view((const double*) columnData, _numRows));
+    }
+  }
+  return columns;
+}
+
+void mappedColumns::prefetchColumn(size_t colIndex) const {
+  if (colIndex < _numColumns) {
+    _file.prefetch(columnOffset(colIndex), _numRows * _valueBytes);
+  }
+}
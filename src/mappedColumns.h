@@ -0,0 +1,65 @@
+#ifndef FORESTRYCPP_MAPPEDCOLUMNS_H
+#define FORESTRYCPP_MAPPEDCOLUMNS_H
+
+#include "DataFrame.h"
+#include "mappedFile.h"
+#include <string>
+#include <vector>
+
+// A feature matrix stored column by column in a file, which is memory mapped
+// so a data frame can be built over data sets larger than the memory. Only the
+// pages of the rows a node touches are read, and the pages the system evicts
+// are read again from the file when they are needed.
+//
+// The file holds a header followed by the columns as doubles, or as floats to
+// halve the size of the file, in the byte order of the machine which wrote
+// it. Every column starts at a multiple of COLUMN_ALIGNMENT bytes, so a column
+// can be prefetched without touching its neighbors.
+class mappedColumns {
+
+public:
+  explicit mappedColumns(const std::string& filename);
+  virtual ~mappedColumns();
+
+  // Writes the columns, which all have the same number of rows, to filename.
+  // With float32 the values are rounded to floats.
+  static void write(
+    const std::string& filename,
+    const std::vector<column_view>& columns,
+    bool float32 = false
+  );
+
+  // Returns views over the columns, which are valid as long as the object
+  std::vector<column_view> getColumns() const;
+
+  // Starts reading the column colIndex into memory in the background
+  void prefetchColumn(size_t colIndex) const;
+
+  size_t getNumRows() const {
+    return _numRows;
+  }
+
+  size_t getNumColumns() const {
+    return _numColumns;
+  }
+
+  // Returns whether the values are stored as floats
+  bool isFloat32() const {
+    return _valueBytes == sizeof(float);
+  }
+
+  static const size_t COLUMN_ALIGNMENT = 4096;
+
+private:
+  mappedColumns(const mappedColumns&);
+  mappedColumns& operator=(const mappedColumns&);
+
+  size_t columnOffset(size_t colIndex) const;
+
+  mappedFile _file;
+  size_t _numRows;
+  size_t _numColumns;
+  size_t _valueBytes;
+};
+
+#endif //FORESTRYCPP_MAPPEDCOLUMNS_H
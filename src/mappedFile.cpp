@@ -0,0 +1,80 @@
+#include "mappedFile.h"
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+#ifndef WIN_R_BUILD
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+mappedFile::mappedFile(const std::string& filename):
+  _data(nullptr), _size(0), _isMapped(false) {
+
+#ifndef WIN_R_BUILD
+  int fileDescriptor = open(filename.c_str(), O_RDONLY);
+  if (fileDescriptor < 0) {
+    throw std::runtime_error("Cannot open the file " + filename + ".");
+  }
+  struct stat fileStatus;
+  if (fstat(fileDescriptor, &fileStatus) != 0) {
+    close(fileDescriptor);
+    throw std::runtime_error("Cannot read the size of the file " + filename + ".");
+  }
+  _size = (size_t) fileStatus.st_size;
+
+  if (_size > 0) {
+    void* mapping = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapping != MAP_FAILED) {
+      _data = (const char*) mapping;
+      _isMapped = true;
+      // The readers jump between rows, so the pages around a fault are not
+      // read ahead, only what prefetch asks for
+      madvise(mapping, _size, MADV_RANDOM);
+    }
+  }
+  // The mapping stays valid after the descriptor is closed
+  close(fileDescriptor);
+
+  if (_isMapped || _size == 0) {
+    return;
+  }
+#endif
+
+  // Fall back to reading the whole file
+  std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!input) {
+    throw std::runtime_error("Cannot open the file " + filename + ".");
+  }
+  input.seekg(0, std::ios::end);
+  _size = (size_t) input.tellg();
+  input.seekg(0, std::ios::beg);
+  _buffer.resize(_size);
+  if (_size > 0 && !input.read(_buffer.data(), _size)) {
+    throw std::runtime_error("Cannot read the file " + filename + ".");
+  }
+  _data = _buffer.data();
+}
+
+mappedFile::~mappedFile() {
+#ifndef WIN_R_BUILD
+  if (_isMapped) {
+    munmap((void*) _data, _size);
+  }
+#endif
+}
+
+void mappedFile::prefetch(size_t offset, size_t bytes) const {
+#ifndef WIN_R_BUILD
+  if (!_isMapped || offset >= _size || bytes == 0) {
+    return;
+  }
+  bytes = std::min(bytes, _size - offset);
+  // madvise needs an address at the start of a page
+  size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+  size_t start = offset - offset % pageSize;
+  madvise((void*) (_data + start), bytes + (offset - start), MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,41 @@
+#ifndef FORESTRYCPP_MAPPEDFILE_H
+#define FORESTRYCPP_MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+
+// A read only view of the whole content of a file. Where the platform
+// supports it the file is memory mapped, so only the pages which are actually
+// touched are read from disk and the pages are shared between all processes
+// mapping the same file. Otherwise the file is read into memory.
+class mappedFile {
+
+public:
+  explicit mappedFile(const std::string& filename);
+  virtual ~mappedFile();
+
+  const char* getData() const {
+    return _data;
+  }
+
+  size_t getSize() const {
+    return _size;
+  }
+
+  // Asks the system to start reading the bytes [offset, offset + bytes) of a
+  // memory mapped file in the background, so they are in memory by the time
+  // they are touched. Does nothing when the file was read into memory.
+  void prefetch(size_t offset, size_t bytes) const;
+
+private:
+  mappedFile(const mappedFile&);
+  mappedFile& operator=(const mappedFile&);
+
+  const char* _data;
+  size_t _size;
+  // Holds the content when the file could not be memory mapped
+  std::vector<char> _buffer;
+  bool _isMapped;
+};
+
+#endif //FORESTRYCPP_MAPPEDFILE_H
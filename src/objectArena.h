@@ -0,0 +1,86 @@
+#ifndef FORESTRYCPP_OBJECTARENA_H
+#define FORESTRYCPP_OBJECTARENA_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+// Hands out objects which are reused once they are released, so buffers such
+// as the sample index vectors of the nodes keep their capacity from one node
+// to the next and growing a tree allocates memory only for the first nodes
+// which need it. The objects are kept apart by level (the depth of the node),
+// so a small node is not handed a buffer which has grown to the size of the
+// root. The arena can be shared by nodes which are grown at the same time.
+template <class T>
+class objectArena {
+
+public:
+  objectArena() {}
+
+  // Returns an object for level which has been released before, or a new one.
+  // The object keeps its content from the last use.
+  T* acquire(size_t level) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (level >= _freeObjects.size()) {
+      _freeObjects.resize(level + 1);
+    }
+    std::vector<T*> &freeObjects = _freeObjects[level];
+    if (freeObjects.empty()) {
+      _objects.push_back(std::unique_ptr<T>(new T()));
+      return _objects.back().get();
+    }
+    T* object = freeObjects.back();
+    freeObjects.pop_back();
+    return object;
+  }
+
+  void release(size_t level, T* object) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _freeObjects[level].push_back(object);
+  }
+
+private:
+  objectArena(const objectArena&);
+  objectArena& operator=(const objectArena&);
+
+  std::mutex _mutex;
+  // Owns every object handed out
+  std::vector< std::unique_ptr<T> > _objects;
+  // The released objects of each level
+  std::vector< std::vector<T*> > _freeObjects;
+};
+
+// Holds an object of an arena and releases it when going out of scope
+template <class T>
+class arenaObject {
+
+public:
+  arenaObject(objectArena<T>* arena, size_t level):
+    _arena(arena), _level(level), _object(arena->acquire(level)) {}
+
+  ~arenaObject() {
+    _arena->release(_level, _object);
+  }
+
+  T* get() {
+    return _object;
+  }
+
+  T& operator*() {
+    return *_object;
+  }
+
+  T* operator->() {
+    return _object;
+  }
+
+private:
+  arenaObject(const arenaObject&);
+  arenaObject& operator=(const arenaObject&);
+
+  objectArena<T>* _arena;
+  size_t _level;
+  T* _object;
+};
+
+#endif //FORESTRYCPP_OBJECTARENA_H
@@ -4,8 +4,17 @@
 #include "RFNode.h"
 #include "forestry.h"
 #include "utils.h"
+#include "instrumentation.h"
+#include "threadPool.h"
+#include "mappedColumns.h"
 #include <RcppArmadillo.h>
 
+// Called by R when the package library is unloaded. The workers of the shared
+// thread pool are joined here, before the library is detached.
+extern "C" void R_unload_Rforestry(DllInfo *dll) {
+  getThreadPool().shutdown();
+}
+
 void freeforestry(
   SEXP ptr
 ){
@@ -16,6 +25,63 @@ void freeforestry(
   R_ClearExternalPtr(ptr);
 }
 
+// Keeps the R columns which a set of column views points into alive. Columns
+// which R does not store as doubles are converted once and kept here.
+struct rcppFeatureData {
+  Rcpp::List columns;
+  std::vector< std::vector<double> > convertedColumns;
+};
+
+// Returns views over the columns of x, numeric columns are not copied. The
+// owner has to be kept alive as long as the views are used. Columns used by a
+// DataFrame are marked as not mutable, so that R copies them before any
+// modification instead of changing the training data underneath the forest.
+std::vector<column_view> rcppColumnViews(
+  Rcpp::List x,
+  std::shared_ptr<rcppFeatureData> &owner,
+  bool markNotMutable
+){
+  owner = std::make_shared<rcppFeatureData>();
+  owner->columns = x;
+  owner->convertedColumns.resize(x.size());
+
+  std::vector<column_view> featureColumns(x.size());
+  for (R_xlen_t j = 0; j < x.size(); j++) {
+    SEXP column = owner->columns[j];
+    if (TYPEOF(column) == REALSXP) {
+      if (markNotMutable) {
+        MARK_NOT_MUTABLE(column);
+      }
+      featureColumns[j] = column_view(REAL(column), (size_t) XLENGTH(column));
+    } else {
+      owner->convertedColumns[j] = Rcpp::as< std::vector<double> >(column);
+      featureColumns[j] = column_view(owner->convertedColumns[j]);
+    }
+  }
+  return featureColumns;
+}
+
+// Returns the rows of a weight matrix in compressed sparse row format, which
+// predict turns into a sparse matrix
+Rcpp::List wrapSparseWeightMatrix(
+  std::vector< std::vector<size_t> > &weightColumns,
+  std::vector< std::vector<double> > &weightValues,
+  size_t numColumns
+){
+  sparse_weight_matrix weightMatrix;
+  compress_weight_rows(weightColumns, weightValues, numColumns, weightMatrix);
+
+  return Rcpp::List::create(
+    Rcpp::Named("rowPointers") = Rcpp::wrap(weightMatrix.rowPointers),
+    Rcpp::Named("columnIndices") = Rcpp::wrap(weightMatrix.columnIndices),
+    Rcpp::Named("values") = Rcpp::wrap(weightMatrix.values),
+    Rcpp::Named("dim") = Rcpp::NumericVector::create(
+      (double) weightMatrix.numRows,
+      (double) weightMatrix.numColumns
+    )
+  );
+}
+
 // [[Rcpp::export]]
 SEXP rcpp_cppDataFrameInterface(
     Rcpp::List x,
@@ -31,13 +97,17 @@ SEXP rcpp_cppDataFrameInterface(
     Rcpp::NumericVector observationWeights,
     Rcpp::NumericVector monotonicConstraints,
     Rcpp::NumericVector groupMemberships,
-    bool monotoneAvg
+    bool monotoneAvg,
+    bool float32Features
 ){
 
   try {
-    std::unique_ptr<std::vector< std::vector<double> > > featureDataRcpp (
-        new std::vector< std::vector<double> >(
-            Rcpp::as< std::vector< std::vector<double> > >(x)
+    // The feature columns point straight into x instead of copying it, unless
+    // float32Features asks for a float copy of them
+    std::shared_ptr<rcppFeatureData> featureDataOwner;
+    std::unique_ptr< std::vector<column_view> > featureDataRcpp (
+        new std::vector<column_view>(
+            rcppColumnViews(x, featureDataOwner, true)
         )
     );
 
@@ -105,6 +175,7 @@ SEXP rcpp_cppDataFrameInterface(
 
     DataFrame* trainingData = new DataFrame(
         std::move(featureDataRcpp),
+        featureDataOwner,
         std::move(outcomeDataRcpp),
         std::move(categoricalFeatureColsRcpp),
         std::move(linearFeats),
@@ -117,6 +188,95 @@ SEXP rcpp_cppDataFrameInterface(
         std::move(observationWeightsRcpp),
         std::move(monotonicConstraintsRcpp),
         std::move(groupMembershipsRcpp),
+        (bool) monotoneAvg,
+        true,
+        float32Features
+    );
+
+    Rcpp::XPtr<DataFrame> ptr(trainingData, true) ;
+    return ptr;
+
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return NULL;
+}
+
+
+// [[Rcpp::export]]
+SEXP rcpp_cppMappedDataFrameInterface(
+    std::string filename,
+    Rcpp::NumericVector y,
+    Rcpp::NumericVector catCols,
+    Rcpp::NumericVector linCols,
+    Rcpp::NumericVector featureWeights,
+    Rcpp::NumericVector featureWeightsVariables,
+    Rcpp::NumericVector deepFeatureWeights,
+    Rcpp::NumericVector deepFeatureWeightsVariables,
+    Rcpp::NumericVector observationWeights,
+    Rcpp::NumericVector monotonicConstraints,
+    Rcpp::NumericVector groupMemberships,
+    bool monotoneAvg
+){
+
+  try {
+    // The feature columns are read from the memory mapped file, which the
+    // data frame keeps open as long as it lives
+    std::shared_ptr< mappedColumns > featureColumns =
+      std::make_shared< mappedColumns >(filename);
+
+    std::unique_ptr< std::vector<size_t> > linearFeats (
+        new std::vector<size_t>(
+            Rcpp::as< std::vector<size_t> >(linCols)
+        )
+    );
+
+    std::sort(linearFeats->begin(), linearFeats->end());
+
+    DataFrame* trainingData = new DataFrame(
+        featureColumns,
+        std::unique_ptr< std::vector<double> >(
+          new std::vector<double>(Rcpp::as< std::vector<double> >(y))
+        ),
+        std::unique_ptr< std::vector<size_t> >(
+          new std::vector<size_t>(Rcpp::as< std::vector<size_t> >(catCols))
+        ),
+        std::move(linearFeats),
+        std::unique_ptr< std::vector<double> >(
+          new std::vector<double>(
+            Rcpp::as< std::vector<double> >(featureWeights)
+          )
+        ),
+        std::unique_ptr< std::vector<size_t> >(
+          new std::vector<size_t>(
+            Rcpp::as< std::vector<size_t> >(featureWeightsVariables)
+          )
+        ),
+        std::unique_ptr< std::vector<double> >(
+          new std::vector<double>(
+            Rcpp::as< std::vector<double> >(deepFeatureWeights)
+          )
+        ),
+        std::unique_ptr< std::vector<size_t> >(
+          new std::vector<size_t>(
+            Rcpp::as< std::vector<size_t> >(deepFeatureWeightsVariables)
+          )
+        ),
+        std::unique_ptr< std::vector<double> >(
+          new std::vector<double>(
+            Rcpp::as< std::vector<double> >(observationWeights)
+          )
+        ),
+        std::make_shared< std::vector<int> >(
+          Rcpp::as< std::vector<int> >(monotonicConstraints)
+        ),
+        std::unique_ptr< std::vector<size_t> >(
+          new std::vector<size_t>(
+            Rcpp::as< std::vector<size_t> >(groupMemberships)
+          )
+        ),
         (bool) monotoneAvg
     );
 
@@ -131,6 +291,49 @@ SEXP rcpp_cppDataFrameInterface(
   return NULL;
 }
 
+// [[Rcpp::export]]
+void rcpp_writeColumnFileInterface(
+    Rcpp::List x,
+    std::string filename,
+    bool float32
+){
+  try {
+    std::shared_ptr<rcppFeatureData> featureDataOwner;
+    std::vector<column_view> featureColumns =
+      rcppColumnViews(x, featureDataOwner, false);
+    mappedColumns::write(filename, featureColumns, float32);
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+}
+
+// [[Rcpp::export]]
+Rcpp::List rcpp_readColumnFileInterface(
+    std::string filename
+){
+  try {
+    mappedColumns columnFile(filename);
+    std::vector<column_view> featureColumns = columnFile.getColumns();
+
+    Rcpp::List columns(featureColumns.size());
+    for (size_t j = 0; j < featureColumns.size(); j++) {
+      Rcpp::NumericVector column(featureColumns[j].size());
+      for (size_t i = 0; i < featureColumns[j].size(); i++) {
+        column[i] = featureColumns[j][i];
+      }
+      columns[j] = column;
+    }
+    return columns;
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::List::create(NA_REAL);
+}
+
 
 // [[Rcpp::export]]
 SEXP rcpp_cppBuildInterface(
@@ -174,6 +377,11 @@ SEXP rcpp_cppBuildInterface(
   bool linear,
   double overfitPenalty,
   bool doubleTree,
+  bool histogramSplit,
+  int nodeParallelSize,
+  bool compactSplits,
+  bool inBagCounts,
+  int firstTree,
   bool existing_dataframe_flag,
   SEXP existing_dataframe
 ){
@@ -210,7 +418,12 @@ SEXP rcpp_cppBuildInterface(
         naDirection,
         linear,
         (double) overfitPenalty,
-        doubleTree
+        doubleTree,
+        histogramSplit,
+        (size_t) nodeParallelSize,
+        compactSplits,
+        inBagCounts,
+        (size_t) firstTree
       );
 
       Rcpp::XPtr<forestry> ptr(testFullForest, true) ;
@@ -229,9 +442,11 @@ SEXP rcpp_cppBuildInterface(
   } else {
 
     try {
-      std::unique_ptr< std::vector< std::vector<double> > > featureDataRcpp (
-          new std::vector< std::vector<double> >(
-              Rcpp::as< std::vector< std::vector<double> > >(x)
+      // The feature columns point straight into x instead of copying it
+      std::shared_ptr<rcppFeatureData> featureDataOwner;
+      std::unique_ptr< std::vector<column_view> > featureDataRcpp (
+          new std::vector<column_view>(
+              rcppColumnViews(x, featureDataOwner, true)
           )
       );
 
@@ -300,6 +515,7 @@ SEXP rcpp_cppBuildInterface(
 
       DataFrame* trainingData = new DataFrame(
           std::move(featureDataRcpp),
+          featureDataOwner,
           std::move(outcomeDataRcpp),
           std::move(categoricalFeatureColsRcpp),
           std::move(linearFeats),
@@ -312,7 +528,9 @@ SEXP rcpp_cppBuildInterface(
           std::move(observationWeightsRcpp),
           std::move(monotoneConstraintsRcpp),
           std::move(groupMembershipsRcpp),
-          (bool) monotoneAvg
+          (bool) monotoneAvg,
+          true,
+          compactSplits
       );
 
       forestry* testFullForest = new forestry(
@@ -342,7 +560,12 @@ SEXP rcpp_cppBuildInterface(
         naDirection,
         linear,
         (double) overfitPenalty,
-        doubleTree
+        doubleTree,
+        histogramSplit,
+        (size_t) nodeParallelSize,
+        compactSplits,
+        inBagCounts,
+        (size_t) firstTree
       );
       Rcpp::XPtr<forestry> ptr(testFullForest, true) ;
       R_RegisterCFinalizerEx(
@@ -371,6 +594,7 @@ Rcpp::List rcpp_cppPredictInterface(
   int nthread,
   bool exact,
   bool returnWeightMatrix,
+  bool sparseWeightMatrix,
   bool use_weights,
   bool use_hold_out_idx,
   Rcpp::NumericVector tree_weights,
@@ -380,8 +604,10 @@ Rcpp::List rcpp_cppPredictInterface(
 
     Rcpp::XPtr< forestry > testFullForest(forest) ;
 
-    std::vector< std::vector<double> > featureData =
-      Rcpp::as< std::vector< std::vector<double> > >(x);
+    // Predict directly from the columns of x instead of copying them
+    std::shared_ptr<rcppFeatureData> featureDataOwner;
+    std::vector<column_view> featureData =
+      rcppColumnViews(x, featureDataOwner, false);
 
     std::unique_ptr< std::vector<double> > testForestPrediction;
     // We always initialize the weightMatrix. If the aggregation is weightMatrix
@@ -390,7 +616,24 @@ Rcpp::List rcpp_cppPredictInterface(
     arma::Mat<int> terminalNodes;
     arma::Mat<double> coefficients;
 
-    if (returnWeightMatrix) {
+    // A sparse weightMatrix is collected row by row and never held densely
+    sparseWeightMatrix = returnWeightMatrix && sparseWeightMatrix &&
+      aggregation != "coefs" && aggregation != "terminalNodes";
+    std::vector< std::vector<size_t> > weightColumns;
+    std::vector< std::vector<double> > weightValues;
+    weight_row_consumer collectWeightRows = [&](
+      size_t row,
+      const std::vector<size_t> &columns,
+      const std::vector<double> &weights
+    ) {
+      weightColumns[row] = columns;
+      weightValues[row] = weights;
+    };
+
+    if (sparseWeightMatrix) {
+      weightColumns.resize(featureData[0].size());
+      weightValues.resize(featureData[0].size());
+    } else if (returnWeightMatrix) {
       size_t nrow = featureData[0].size(); // number of features to be predicted
       size_t ncol = (*testFullForest).getNtrain(); // number of train data
       weightMatrix.resize(nrow, ncol); // initialize the space for the matrix
@@ -404,21 +647,27 @@ Rcpp::List rcpp_cppPredictInterface(
 
     // If using predict indices, set weights according to them
     if (use_hold_out_idx) {
+      if (testFullForest->isSlim()) {
+        throw std::runtime_error("holdOutIdx is not available for slim forests.");
+      }
       std::vector<size_t> holdOutIdxCpp = Rcpp::as< std::vector<size_t> >(hold_out_idx);
 
       for (auto &tree : *(testFullForest->getForest())) {
         bool discard_tree = false;
         std::unordered_set<size_t> hold_out_set(holdOutIdxCpp.begin(), holdOutIdxCpp.end());
-        for (const auto &averaging_index : *(tree->getAveragingIndex()) ) {
-          if (hold_out_set.count(averaging_index)) {
+        std::vector<size_t> averagingSampleIndex;
+        std::vector<size_t> splittingSampleIndex;
+        tree->getSampleIndex(averagingSampleIndex, splittingSampleIndex);
+        for (size_t row : averagingSampleIndex) {
+          if (hold_out_set.count(row)) {
             discard_tree = true;
             break;
           }
         }
         // if Still haven't found any of them, search splitting set
         if (!discard_tree) {
-          for (const auto &splitting_index : *(tree->getSplittingIndex()) ) {
-            if (hold_out_set.count(splitting_index)) {
+          for (size_t row : splittingSampleIndex) {
+            if (hold_out_set.count(row)) {
               discard_tree = true;
               break;
             }
@@ -453,7 +702,7 @@ Rcpp::List rcpp_cppPredictInterface(
     if (aggregation == "coefs") {
       size_t nrow = featureData[0].size();
       // Now we need the number of linear features + 1 for the intercept
-      size_t ncol = (*testFullForest).getTrainingData()->getLinObsData(0).size() + 1;
+      size_t ncol = (*testFullForest).getTrainingData()->getLinCols()->size() + 1;
       //Set coefficients to be zero
       coefficients.resize(nrow, ncol);
       coefficients.zeros(nrow, ncol);
@@ -506,14 +755,15 @@ Rcpp::List rcpp_cppPredictInterface(
         );
       } else {
         testForestPrediction = (*testFullForest).predict(&featureData,
-                                returnWeightMatrix ? &weightMatrix : NULL,
+                                returnWeightMatrix && !sparseWeightMatrix ? &weightMatrix : NULL,
                                 NULL,
                                 NULL,
                                 seed,
                                 threads_to_use,
                                 exact,
                                 use_weights,
-                                use_weights ? testForestTreeWeights : NULL);
+                                use_weights ? testForestTreeWeights : NULL,
+                                sparseWeightMatrix ? &collectWeightRows : NULL);
       }
     }
 
@@ -525,6 +775,17 @@ Rcpp::List rcpp_cppPredictInterface(
     delete testForestPrediction_;
     delete testForestTreeWeights;
 
+    if (sparseWeightMatrix) {
+      return Rcpp::List::create(Rcpp::Named("predictions") = predictions,
+                                Rcpp::Named("weightMatrix") = wrapSparseWeightMatrix(
+                                  weightColumns,
+                                  weightValues,
+                                  (*testFullForest).getNtrain()
+                                ),
+                                Rcpp::Named("terminalNodes") = terminalNodes,
+                                Rcpp::Named("coef") = coefficients);
+    }
+
     return Rcpp::List::create(Rcpp::Named("predictions") = predictions,
                               Rcpp::Named("weightMatrix") = weightMatrix,
                               Rcpp::Named("terminalNodes") = terminalNodes,
@@ -540,6 +801,193 @@ Rcpp::List rcpp_cppPredictInterface(
   return Rcpp::List::create(NA_REAL);
 }
 
+// [[Rcpp::export]]
+double rcpp_cppPredictRowInterface(
+  SEXP forest,
+  Rcpp::NumericVector x,
+  int seed
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    std::vector<double> observation = Rcpp::as< std::vector<double> >(x);
+    return (*testFullForest).predictRow(&observation, (unsigned int) seed);
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::NumericVector::get_na();
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector rcpp_cppLpDistanceInterface(
+  SEXP forest,
+  Rcpp::List x,
+  Rcpp::NumericVector newFeature,
+  Rcpp::NumericVector trainFeature,
+  bool categorical,
+  double p,
+  int seed,
+  bool OOB,
+  bool doubleOOB,
+  bool use_training_idx,
+  Rcpp::IntegerVector training_idx
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+
+    std::shared_ptr<rcppFeatureData> featureDataOwner;
+    std::vector<column_view> featureData =
+      rcppColumnViews(x, featureDataOwner, false);
+
+    std::vector<size_t> training_idx_cpp;
+    if (use_training_idx) {
+      training_idx_cpp = Rcpp::as< std::vector<size_t> >(training_idx);
+    }
+
+    std::vector<double> distances = (*testFullForest).lpDistances(
+      &featureData,
+      Rcpp::as< std::vector<double> >(newFeature),
+      Rcpp::as< std::vector<double> >(trainFeature),
+      categorical,
+      p,
+      (unsigned int) seed,
+      OOB,
+      doubleOOB,
+      training_idx_cpp
+    );
+    return Rcpp::wrap(distances);
+
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::NumericVector::get_na();
+}
+
+// [[Rcpp::export]]
+SEXP rcpp_cppAssignLeavesInterface(
+  SEXP forest,
+  Rcpp::List x,
+  int seed,
+  int nthread,
+  bool keepWeightMatrix
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+
+    std::shared_ptr<rcppFeatureData> featureDataOwner;
+    std::vector<column_view> featureData =
+      rcppColumnViews(x, featureDataOwner, false);
+
+    size_t threads_to_use;
+    if (nthread == 0) {
+      threads_to_use = testFullForest->getNthread();
+    } else {
+      threads_to_use = (size_t) nthread;
+    }
+
+    std::unique_ptr< leaf_assignment > leaves = (*testFullForest).assignLeaves(
+      &featureData,
+      (unsigned int) seed,
+      threads_to_use,
+      keepWeightMatrix
+    );
+
+    Rcpp::XPtr< leaf_assignment > ptr(leaves.release(), true) ;
+    return ptr;
+
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return NULL;
+}
+
+// [[Rcpp::export]]
+Rcpp::List rcpp_cppPredictLeavesInterface(
+  SEXP forest,
+  SEXP leaves,
+  int nthread,
+  bool returnWeightMatrix,
+  bool sparseWeightMatrix,
+  bool use_weights,
+  Rcpp::NumericVector tree_weights
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    Rcpp::XPtr< leaf_assignment > leafAssignment(leaves) ;
+    size_t numObservations = leafAssignment->terminalNodes.n_rows - 1;
+
+    arma::Mat<double> weightMatrix;
+    arma::Mat<double> coefficients;
+
+    sparseWeightMatrix = returnWeightMatrix && sparseWeightMatrix;
+    std::vector< std::vector<size_t> > weightColumns;
+    std::vector< std::vector<double> > weightValues;
+    weight_row_consumer collectWeightRows = [&](
+      size_t row,
+      const std::vector<size_t> &columns,
+      const std::vector<double> &weights
+    ) {
+      weightColumns[row] = columns;
+      weightValues[row] = weights;
+    };
+
+    if (sparseWeightMatrix) {
+      weightColumns.resize(numObservations);
+      weightValues.resize(numObservations);
+    } else if (returnWeightMatrix) {
+      weightMatrix.zeros(numObservations, (*testFullForest).getNtrain());
+    }
+
+    std::vector<size_t> weights = Rcpp::as< std::vector<size_t> >(tree_weights);
+
+    size_t threads_to_use;
+    if (nthread == 0) {
+      threads_to_use = testFullForest->getNthread();
+    } else {
+      threads_to_use = (size_t) nthread;
+    }
+
+    std::unique_ptr< std::vector<double> > testForestPrediction =
+      (*testFullForest).predictLeaves(
+        *leafAssignment,
+        returnWeightMatrix && !sparseWeightMatrix ? &weightMatrix : NULL,
+        threads_to_use,
+        use_weights,
+        use_weights ? &weights : NULL,
+        sparseWeightMatrix ? &collectWeightRows : NULL
+      );
+
+    Rcpp::NumericVector predictions = Rcpp::wrap(*testForestPrediction);
+
+    if (sparseWeightMatrix) {
+      return Rcpp::List::create(Rcpp::Named("predictions") = predictions,
+                                Rcpp::Named("weightMatrix") = wrapSparseWeightMatrix(
+                                  weightColumns,
+                                  weightValues,
+                                  (*testFullForest).getNtrain()
+                                ),
+                                Rcpp::Named("terminalNodes") = leafAssignment->terminalNodes,
+                                Rcpp::Named("coef") = coefficients);
+    }
+
+    return Rcpp::List::create(Rcpp::Named("predictions") = predictions,
+                              Rcpp::Named("weightMatrix") = weightMatrix,
+                              Rcpp::Named("terminalNodes") = leafAssignment->terminalNodes,
+                              Rcpp::Named("coef") = coefficients);
+
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::List::create(NA_REAL);
+}
+
 // [[Rcpp::export]]
 double rcpp_OBBPredictInterface(
     SEXP forest
@@ -557,6 +1005,41 @@ double rcpp_OBBPredictInterface(
   return Rcpp::NumericVector::get_na();
 }
 
+// [[Rcpp::export]]
+double rcpp_getRunningOOBInterface(
+    SEXP forest
+){
+
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    return (*testFullForest).getRunningOOBError();
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::NumericVector::get_na();
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericVector rcpp_getVIInterface(
+    SEXP forest,
+    int seed
+){
+
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    std::vector<double> importance =
+      (*testFullForest).getVariableImportance((unsigned int) seed);
+    return Rcpp::wrap(importance);
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::NumericVector::get_na();
+}
+
 // [[Rcpp::export]]
 Rcpp::List rcpp_OBBPredictionsInterface(
     SEXP forest,
@@ -564,14 +1047,17 @@ Rcpp::List rcpp_OBBPredictionsInterface(
     bool existing_df,
     bool doubleOOB,
     bool returnWeightMatrix,
+    bool sparseWeightMatrix,
     bool exact,
     bool use_training_idx,
     Rcpp::IntegerVector training_idx
 ){
   // Then we predict with the feature.new data
   if (existing_df) {
-    std::vector< std::vector<double> > featureData =
-      Rcpp::as< std::vector< std::vector<double> > >(x);
+    // Predict directly from the columns of x instead of copying them
+    std::shared_ptr<rcppFeatureData> featureDataOwner;
+    std::vector<column_view> featureData =
+      rcppColumnViews(x, featureDataOwner, false);
 
     std::vector<size_t> training_idx_cpp;
     if (use_training_idx){
@@ -584,7 +1070,40 @@ Rcpp::List rcpp_OBBPredictionsInterface(
       arma::Mat<double> weightMatrix;
       std::vector<size_t> treeCounts(1);
 
-      if (returnWeightMatrix) {
+      if (returnWeightMatrix && sparseWeightMatrix) {
+        size_t nrow = use_training_idx ? training_idx.size() : (*testFullForest).getNtrain(); // number of features to be predicted
+        treeCounts.resize(nrow);
+        std::fill(treeCounts.begin(), treeCounts.end(), 0);
+
+        // The rows are collected one by one, the dense matrix is never built
+        std::vector< std::vector<size_t> > weightColumns(nrow);
+        std::vector< std::vector<double> > weightValues(nrow);
+        weight_row_consumer collectWeightRows = [&](
+          size_t row,
+          const std::vector<size_t> &columns,
+          const std::vector<double> &weights
+        ) {
+          weightColumns[row] = columns;
+          weightValues[row] = weights;
+        };
+
+        std::vector<double> OOBpreds = (*testFullForest).predictOOB(&featureData,
+                                        NULL,
+                                        &treeCounts,
+                                        doubleOOB,
+                                        exact,
+                                        training_idx_cpp,
+                                        &collectWeightRows);
+        Rcpp::NumericVector wrapped_preds = Rcpp::wrap(OOBpreds);
+
+        return Rcpp::List::create(Rcpp::Named("predictions") = wrapped_preds,
+                                  Rcpp::Named("weightMatrix") = wrapSparseWeightMatrix(
+                                    weightColumns,
+                                    weightValues,
+                                    (*testFullForest).getNtrain()
+                                  ),
+                                  Rcpp::Named("treeCounts") = treeCounts);
+      } else if (returnWeightMatrix) {
         size_t nrow = use_training_idx ? training_idx.size() : (*testFullForest).getNtrain(); // number of features to be predicted
         size_t ncol = (*testFullForest).getNtrain(); // number of train data
         weightMatrix.resize(nrow, ncol); // initialize the space for the matrix
@@ -672,6 +1191,104 @@ void rcpp_AddTreeInterface(
   }
 }
 
+// [[Rcpp::export]]
+void rcpp_mergeForestsInterface(
+    SEXP forest,
+    Rcpp::List shards
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    std::vector< forestry* > shardForests;
+    for (int i = 0; i < shards.size(); i++) {
+      Rcpp::XPtr< forestry > shard(Rcpp::as<SEXP>(shards[i])) ;
+      shardForests.push_back(shard.get());
+    }
+    (*testFullForest).mergeForests(shardForests);
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+}
+
+// [[Rcpp::export]]
+void rcpp_slimForestInterface(
+    SEXP forest
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    (*testFullForest).slim();
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+}
+
+// [[Rcpp::export]]
+double rcpp_getMemoryUsageInterface(
+    SEXP forest
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    return (double) (*testFullForest).getTotalMemoryUsage();
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::NumericVector::get_na();
+}
+
+// [[Rcpp::export]]
+void rcpp_setInstrumentationInterface(
+    bool enabled
+){
+  setInstrumentationEnabled(enabled);
+}
+
+// [[Rcpp::export]]
+Rcpp::List rcpp_getInstrumentationInterface(
+    SEXP forest,
+    bool reset
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    forestry_instrumentation* stats = (*testFullForest).getInstrumentation();
+
+    Rcpp::CharacterVector phase(NUM_INSTRUMENTED_PHASES);
+    Rcpp::NumericVector calls(NUM_INSTRUMENTED_PHASES);
+    Rcpp::NumericVector seconds(NUM_INSTRUMENTED_PHASES);
+    for (size_t i = 0; i < NUM_INSTRUMENTED_PHASES; i++) {
+      phase[i] = instrumentedPhaseName(i);
+      calls[i] = (double) stats->phaseCalls[i];
+      seconds[i] = (double) stats->phaseNanoseconds[i] / 1e9;
+    }
+
+    Rcpp::List instrumentation = Rcpp::List::create(
+      Rcpp::Named("phase") = phase,
+      Rcpp::Named("calls") = calls,
+      Rcpp::Named("seconds") = seconds,
+      Rcpp::Named("trees") = (double) stats->treesGrown,
+      Rcpp::Named("nodes") = (double) stats->nodesGrown,
+      Rcpp::Named("featuresEvaluated") = (double) stats->featuresEvaluated,
+      Rcpp::Named("rowsPredicted") = (double) stats->rowsPredicted,
+      Rcpp::Named("bytesAllocated") = (double) stats->bytesAllocated,
+      Rcpp::Named("treeBytes") =
+        (double) (*testFullForest).getTotalMemoryUsage()
+    );
+    if (reset) {
+      stats->reset();
+    }
+    return instrumentation;
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::List::create(NA_REAL);
+}
+
 // [[Rcpp::export]]
 Rcpp::List rcpp_CppToR_translator(
     SEXP forest
@@ -758,6 +1375,7 @@ Rcpp::List rcpp_reconstructree(
   bool middleSplit,
   int maxObs,
   int minTreesPerFold,
+  int foldSize,
   Rcpp::NumericVector featureWeights,
   Rcpp::NumericVector featureWeightsVariables,
   Rcpp::NumericVector deepFeatureWeights,
@@ -770,79 +1388,63 @@ Rcpp::List rcpp_reconstructree(
   bool naDirection,
   bool linear,
   double overfitPenalty,
-  bool doubleTree
+  bool doubleTree,
+  bool histogramSplit,
+  int nodeParallelSize,
+  bool compactSplits,
+  bool inBagCounts
 ){
 
-  // Decode the R_forest data and create appropriate pointers to pointers:
-  std::unique_ptr< std::vector< std::vector<int> > > var_ids(
-      new std::vector< std::vector<int> >
-  );
-  std::unique_ptr< std::vector< std::vector<double> > > split_vals(
-      new  std::vector< std::vector<double> >
-  );
-  std::unique_ptr< std::vector< std::vector<int> > > naLeftCounts(
-      new std::vector< std::vector<int> >
-  );
-  std::unique_ptr< std::vector< std::vector<int> > > naRightCounts(
-      new std::vector< std::vector<int> >
-  );
-  std::unique_ptr< std::vector< std::vector<int> > > naDefaultDirections(
-      new std::vector< std::vector<int> >
-  );
-  std::unique_ptr< std::vector< std::vector<size_t> > > averagingSampleIndex(
-      new  std::vector< std::vector<size_t> >
-  );
-  std::unique_ptr< std::vector< std::vector<size_t> > > splittingSampleIndex(
-      new  std::vector< std::vector<size_t> >
-  );
-  std::unique_ptr< std::vector<unsigned int> > tree_seeds(
-      new std::vector<unsigned int>
-  );
-  std::unique_ptr< std::vector< std::vector<double> > > predictWeights(
-          new  std::vector< std::vector<double> >
-  );
+  // Decode the R_forest data. The trees are reconstructed straight from the
+  // vectors of R_forest, so they are only held here to keep vectors which had
+  // to be coerced alive.
+  std::vector< Rcpp::IntegerVector > intHolders;
+  std::vector< Rcpp::NumericVector > numericHolders;
+  std::vector< tree_info_view > treeArrays;
+  treeArrays.reserve(R_forest.size());
 
-    // Reserve space for each of the vectors equal to R_forest.size()
-  var_ids->reserve(R_forest.size());
-  split_vals->reserve(R_forest.size());
-  averagingSampleIndex->reserve(R_forest.size());
-  splittingSampleIndex->reserve(R_forest.size());
-  naLeftCounts->reserve(R_forest.size());
-  naRightCounts->reserve(R_forest.size());
-  naDefaultDirections->reserve(R_forest.size());
-  tree_seeds->reserve(R_forest.size());
-  predictWeights->reserve(R_forest.size());
-
-
-  // Now actually populate the vectors
   for(int i=0; i!=R_forest.size(); i++){
-    var_ids->push_back(
-        Rcpp::as< std::vector<int> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[0])
-      );
-    split_vals->push_back(
-        Rcpp::as< std::vector<double> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[1])
-      );
-    averagingSampleIndex->push_back(
-        Rcpp::as< std::vector<size_t> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[2])
-      );
-    splittingSampleIndex->push_back(
-        Rcpp::as< std::vector<size_t> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[3])
-      );
-    naLeftCounts->push_back(
-        Rcpp::as< std::vector<int> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[4])
-    );
-    naRightCounts->push_back(
-        Rcpp::as< std::vector<int> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[5])
-    );
-    naDefaultDirections->push_back(
-        Rcpp::as< std::vector<int> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[6])
-    );
-    tree_seeds->push_back(
-        Rcpp::as< unsigned int > ((Rcpp::as<Rcpp::List>(R_forest[i]))[7])
-    );
-    predictWeights->push_back(
-            Rcpp::as< std::vector<double> > ((Rcpp::as<Rcpp::List>(R_forest[i]))[8])
-    );
+    Rcpp::List tree_i = Rcpp::as<Rcpp::List>(R_forest[i]);
+    Rcpp::IntegerVector var_ids = tree_i[0];
+    Rcpp::NumericVector split_vals = tree_i[1];
+    Rcpp::IntegerVector averagingSampleIndex = tree_i[2];
+    Rcpp::IntegerVector splittingSampleIndex = tree_i[3];
+    Rcpp::IntegerVector naLeftCounts = tree_i[4];
+    Rcpp::IntegerVector naRightCounts = tree_i[5];
+    Rcpp::IntegerVector naDefaultDirections = tree_i[6];
+    Rcpp::NumericVector predictWeights = tree_i[8];
+
+    if (naLeftCounts.size() != split_vals.size() ||
+        naRightCounts.size() != split_vals.size() ||
+        naDefaultDirections.size() != split_vals.size()) {
+      throw std::runtime_error("The NA counts of a tree do not match its split values.");
+    }
+
+    tree_info_view treeView;
+    treeView.var_id = var_ids.begin();
+    treeView.numVarIds = var_ids.size();
+    treeView.split_val = split_vals.begin();
+    treeView.naLeftCount = naLeftCounts.begin();
+    treeView.naRightCount = naRightCounts.begin();
+    treeView.naDefaultDirection = naDefaultDirections.begin();
+    treeView.numSplitVals = split_vals.size();
+    treeView.values = predictWeights.begin();
+    treeView.numValues = predictWeights.size();
+    treeView.averagingSampleIndex = averagingSampleIndex.begin();
+    treeView.numAveraging = averagingSampleIndex.size();
+    treeView.splittingSampleIndex = splittingSampleIndex.begin();
+    treeView.numSplitting = splittingSampleIndex.size();
+    treeView.seed = Rcpp::as< unsigned int > (tree_i[7]);
+    treeArrays.push_back(treeView);
+
+    intHolders.push_back(var_ids);
+    intHolders.push_back(averagingSampleIndex);
+    intHolders.push_back(splittingSampleIndex);
+    intHolders.push_back(naLeftCounts);
+    intHolders.push_back(naRightCounts);
+    intHolders.push_back(naDefaultDirections);
+    numericHolders.push_back(split_vals);
+    numericHolders.push_back(predictWeights);
   }
 
   // Decode catCols and R_forest
@@ -861,9 +1463,11 @@ Rcpp::List rcpp_reconstructree(
         (*categoricalFeatureColsRcpp)[i]);
   }
 
-  std::unique_ptr<std::vector< std::vector<double> > > featureDataRcpp (
-      new std::vector< std::vector<double> >(
-          Rcpp::as< std::vector< std::vector<double> > >(x)
+  // The feature columns point straight into x instead of copying it
+  std::shared_ptr<rcppFeatureData> featureDataOwner;
+  std::unique_ptr< std::vector<column_view> > featureDataRcpp (
+      new std::vector<column_view>(
+          rcppColumnViews(x, featureDataOwner, true)
       )
   );
 
@@ -921,6 +1525,7 @@ Rcpp::List rcpp_reconstructree(
 
   DataFrame* trainingData = new DataFrame(
     std::move(featureDataRcpp),
+    featureDataOwner,
     std::move(outcomeDataRcpp),
     std::move(categoricalFeatureColsRcpp),
     std::move(linearFeats),
@@ -933,7 +1538,9 @@ Rcpp::List rcpp_reconstructree(
     std::move(observationWeightsRcpp),
     std::move(monotonicConstraintsRcpp),
     std::move(groupMembershipsRcpp),
-    (bool) monotoneAvg
+    (bool) monotoneAvg,
+    true,
+    compactSplits
   );
 
   forestry* testFullForest = new forestry(
@@ -958,25 +1565,21 @@ Rcpp::List rcpp_reconstructree(
     (bool) middleSplit,
     (int) maxObs,
     (size_t) minTreesPerFold,
-    1,
+    (size_t) foldSize,
     (bool) hasNas,
     (bool) naDirection,
     (bool) linear,
     (double) overfitPenalty,
-    doubleTree
+    doubleTree,
+    histogramSplit,
+    (size_t) nodeParallelSize,
+    compactSplits,
+    inBagCounts,
+    0
   );
 
   testFullForest->reconstructTrees(categoricalFeatureColsRcpp_copy,
-                                   tree_seeds,
-                                   var_ids,
-                                   split_vals,
-                                   naLeftCounts,
-                                   naRightCounts,
-                                   naDefaultDirections,
-                                   averagingSampleIndex,
-                                   splittingSampleIndex,
-                                   predictWeights
-                                   );
+                                   treeArrays);
 
   Rcpp::XPtr<forestry> ptr(testFullForest, true);
   R_RegisterCFinalizerEx(
@@ -989,50 +1592,74 @@ Rcpp::List rcpp_reconstructree(
                             Rcpp::Named("data_frame_ptr") = df_ptr);
 }
 
+// [[Rcpp::export]]
+void rcpp_saveForestBinary(
+    SEXP forest,
+    std::string filename,
+    Rcpp::RawVector metadata
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    (*testFullForest).saveBinaryForest(
+      filename,
+      (const char*) RAW(metadata),
+      (size_t) metadata.size()
+    );
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+}
+
+// [[Rcpp::export]]
+Rcpp::RawVector rcpp_readForestBinaryMetadata(
+    std::string filename
+){
+  try {
+    std::vector<char> metadata = forestry::readBinaryForestMetadata(filename);
+    Rcpp::RawVector metadataR(metadata.size());
+    std::copy(metadata.begin(), metadata.end(), (char*) RAW(metadataR));
+    return metadataR;
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+  return Rcpp::RawVector(0);
+}
+
+// [[Rcpp::export]]
+void rcpp_loadForestBinary(
+    SEXP forest,
+    std::string filename
+){
+  try {
+    Rcpp::XPtr< forestry > testFullForest(forest) ;
+    (*testFullForest).loadBinaryForest(filename);
+  } catch(std::runtime_error const& err) {
+    forward_exception_to_r(err);
+  } catch(...) {
+    ::Rf_error("c++ exception (unknown reason)");
+  }
+}
+
 // [[Rcpp::export]]
 std::vector< std::vector<double> > rcpp_cppImputeInterface(
     SEXP forest,
     Rcpp::List x,
     int seed
 ){
-  // There is code duplication with rcpp_cppPredictInterface here. Really the
-  // predict member function should be refactored so that the boilerplate
-  // happens inside it.
   Rcpp::XPtr< forestry > testFullForest(forest);
   std::vector< std::vector<double> > featureData =
     Rcpp::as< std::vector< std::vector<double> > >(x);
 
-  std::unique_ptr< std::vector<double> > testForestPrediction;
-  arma::Mat<double> weightMatrix;
-
-  size_t nrow = featureData[0].size(); // number of features to be predicted
-  size_t ncol = (*testFullForest).getNtrain(); // number of train data
-  weightMatrix.resize(nrow, ncol); // initialize the space for the matrix
-  weightMatrix.zeros(nrow, ncol); // set it all to 0
-
-  testForestPrediction = (*testFullForest).predict(&featureData,
-                                                   &weightMatrix,
-                                                   NULL,
-                                                   NULL,
-                                                   seed,
-                                                   testFullForest->getNthread(),
-                                                   false,
-                                                   false,
-                                                   NULL);
-
-  std::vector<double>* testForestPrediction_ =
-    new std::vector<double>(*testForestPrediction.get());
-
-  Rcpp::NumericVector predictions = Rcpp::wrap(*testForestPrediction_);
-  arma::Mat<double> weightMatrixT = weightMatrix;
-
-  // Take tranpose because we want to access by row and armadillo uses column
-  // major ordering.
-  arma::inplace_trans(weightMatrixT);
-
-  std::vector<std::vector<double>>* imputedX = testFullForest->neighborhoodImpute(
-    &featureData,
-    &weightMatrixT
-  );
+  std::vector<column_view> featureColumns = make_column_views(featureData);
+  std::unique_ptr< std::vector< std::vector<double> > > imputedX =
+    testFullForest->neighborhoodImpute(
+      &featureColumns,
+      seed,
+      testFullForest->getNthread()
+    );
   return *imputedX;
 }
@@ -6,6 +6,8 @@
 #include <random>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <stdexcept>
 
 // Given a number of groups, we assign each group to a
 // fold of size foldSize (if numGroups % foldSize != 0, one
@@ -47,6 +49,114 @@ void assign_groups_to_folds(
     foldMemberships[numFolds-1].resize(group_vector.size() - (numFolds-1)*foldSize);
 }
 
+// Sets isMarked[g] for every group g in groupIdx
+void mark_groups(
+        const std::vector<size_t>& groupIdx,
+        std::vector<char>& isMarked
+) {
+    isMarked.clear();
+    for (size_t i = 0; i < groupIdx.size(); i++) {
+        if (groupIdx[i] >= isMarked.size()) {
+            isMarked.resize(groupIdx[i] + 1, 0);
+        }
+        isMarked[groupIdx[i]] = 1;
+    }
+}
+
+// Counts how often each observation appears in sampleIndex
+void count_sample_indices(
+        const std::vector<size_t>& sampleIndex,
+        size_t numRows,
+        std::vector<unsigned int>& inBagCounts
+) {
+    inBagCounts.assign(numRows, 0);
+    for (size_t i = 0; i < sampleIndex.size(); i++) {
+        inBagCounts[sampleIndex[i]]++;
+    }
+}
+
+void count_sample_rows(
+        const std::vector<size_t>& sampleIndex,
+        size_t numRows,
+        sample_counts& counts
+) {
+    std::vector<unsigned int> inBagCounts;
+    count_sample_indices(sampleIndex, numRows, inBagCounts);
+    unsigned int maxCount = 0;
+    for (size_t i = 0; i < inBagCounts.size(); i++) {
+        maxCount = std::max(maxCount, inBagCounts[i]);
+    }
+    if (maxCount > std::numeric_limits<uint16_t>::max()) {
+        throw std::runtime_error(
+            "inBagCounts is not available when a row is drawn more than "
+            "65535 times."
+        );
+    }
+
+    counts.wide = maxCount > std::numeric_limits<uint8_t>::max();
+    counts.narrowCounts.clear();
+    counts.wideCounts.clear();
+    if (counts.wide) {
+        counts.wideCounts.assign(inBagCounts.begin(), inBagCounts.end());
+    } else {
+        counts.narrowCounts.assign(inBagCounts.begin(), inBagCounts.end());
+    }
+}
+
+void counted_rows(
+        const sample_counts& counts,
+        std::vector<size_t>& countedRows
+) {
+    countedRows.clear();
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] > 0) {
+            countedRows.push_back(i);
+        }
+    }
+}
+
+void counted_sample_index(
+        const sample_counts& counts,
+        std::vector<size_t>& sampleIndex
+) {
+    sampleIndex.clear();
+    for (size_t i = 0; i < counts.size(); i++) {
+        sampleIndex.insert(sampleIndex.end(), counts[i], i);
+    }
+}
+
+size_t counted_size(
+        const std::vector<size_t>* sampleIndex,
+        const sample_counts* counts
+) {
+    if (!counts) {
+        return (*sampleIndex).size();
+    }
+    size_t totalCount = 0;
+    for (size_t i = 0; i < (*sampleIndex).size(); i++) {
+        totalCount += (*counts)[(*sampleIndex)[i]];
+    }
+    return totalCount;
+}
+
+double counted_mean(
+        DataFrame* trainingData,
+        std::vector<size_t>* sampleIndex,
+        const sample_counts* counts
+) {
+    if (!counts) {
+        return (*trainingData).partitionMean(sampleIndex);
+    }
+    double accummulatedSum = 0;
+    size_t totalCount = 0;
+    for (size_t i = 0; i < (*sampleIndex).size(); i++) {
+        size_t row = (*sampleIndex)[i];
+        accummulatedSum += (*counts)[row] * (*trainingData).getOutcomePoint(row);
+        totalCount += (*counts)[row];
+    }
+    return accummulatedSum / ((double) totalCount);
+}
+
 // Does a bootstrap sample from the observations which do not fall into
 // the removedGroupIdx group, this puts the resulting sample into outputIdx
 void group_out_sample(
@@ -66,9 +176,13 @@ void group_out_sample(
     // Get observation weights to use
     std::vector<double>* sampleWeights = (trainingData->getobservationWeights());
 
+    // Mark the removed groups, so each observation is checked in constant time
+    std::vector<char> isRemovedGroup;
+    mark_groups(removedGroupIdx, isRemovedGroup);
+
     // First get all observations not in groupIdx
     for (size_t i = 0; i < groupMemberships.size(); i++) {
-        if (std::find(removedGroupIdx.begin(), removedGroupIdx.end(), groupMemberships[i]) == removedGroupIdx.end()) {
+        if (!is_marked_group(isRemovedGroup, groupMemberships[i])) {
             out_of_group_indices.push_back(i);
             index_sampling_weights.push_back(sampleWeights->at(i));
         }
@@ -79,16 +193,11 @@ void group_out_sample(
             index_sampling_weights.begin(), index_sampling_weights.end()
     );
 
-    std::vector<size_t> sampledIndices;
-
-    while (sampledIndices.size() < index_sampling_weights.size()) {
+    outputIdx.reserve(outputIdx.size() + index_sampling_weights.size());
+    for (size_t i = 0; i < index_sampling_weights.size(); i++) {
         size_t randomIndex = weighted_dist(random_number_generator);
         // Push back the out of group index at that position
-        sampledIndices.push_back(out_of_group_indices[randomIndex]);
-    }
-
-    for (size_t i = 0; i < sampledIndices.size(); i++) {
-        outputIdx.push_back(sampledIndices[i]);
+        outputIdx.push_back(out_of_group_indices[randomIndex]);
     }
 }
 
@@ -373,17 +482,15 @@ void generate_sample_indices(
                 0, (size_t) (*trainingData).getNumRows() - 1
         );
 
-        // Generate index without replacement
+        // Generate index without replacement, the sampled observations are
+        // marked so that a draw is checked in constant time
+        std::vector<char> isSampled((*trainingData).getNumRows(), 0);
+        sampleIndex.reserve(sampleSize);
         while (sampleIndex.size() < sampleSize) {
             size_t randomIndex = unif_dist(random_number_generator);
 
-            if (sampleIndex.size() == 0 ||
-                    std::find(
-                            sampleIndex.begin(),
-                            sampleIndex.end(),
-                            randomIndex
-                    ) == sampleIndex.end()
-                    ) {
+            if (!isSampled[randomIndex]) {
+                isSampled[randomIndex] = 1;
                 sampleIndex.push_back(randomIndex);
             }
         }
@@ -397,39 +504,38 @@ void generate_sample_indices(
         std::vector<size_t> splitSampleIndex_;
         std::vector<size_t> averageSampleIndex_;
 
-        std::sort(
-                sampleIndex.begin(),
-                sampleIndex.end()
+        // The in bag counts of the observations give the sample in
+        // increasing order and the OOB observations without sorting
+        std::vector<unsigned int> inBagCounts;
+        count_sample_indices(
+                sampleIndex,
+                std::max((size_t) (*trainingData).getNumRows(), sampleSize),
+                inBagCounts
         );
 
-        std::vector<size_t> allIndex;
-        for (size_t i = 0; i < sampleSize; i++) {
-            // If we are doing leave a group out sampling, we make sure the
-            // allIndex vector doesn't include observations in the currently
-            // left out group
-            if (minTreesPerFold == 0) {
-                allIndex.push_back(i);
-            } else if (std::find(groups_to_remove.begin(),
-                                 groups_to_remove.end(),
-                                 (*(trainingData->getGroups()))[i]) == groups_to_remove.end()) {
-                allIndex.push_back(i);
-            }
+        sampleIndex.clear();
+        for (size_t i = 0; i < inBagCounts.size(); i++) {
+            sampleIndex.insert(sampleIndex.end(), inBagCounts[i], i);
         }
 
-        std::vector<size_t> OOBIndex(sampleSize);
-
-        // First we get the set of all possible
-        // OOB index is the set difference between sampleIndex and all_idx
-        std::vector<size_t>::iterator it = std::set_difference (
-                allIndex.begin(),
-                allIndex.end(),
-                sampleIndex.begin(),
-                sampleIndex.end(),
-                OOBIndex.begin()
-        );
+        std::vector<char> isRemovedGroup;
+        if (minTreesPerFold != 0) {
+            mark_groups(groups_to_remove, isRemovedGroup);
+        }
 
-        // resize OOB index
-        OOBIndex.resize((unsigned long) (it - OOBIndex.begin()));
+        // The OOB index holds the observations among the first sampleSize
+        // which are not in the sample. If we are doing leave a group out
+        // sampling, we make sure it doesn't include observations in the
+        // currently left out group
+        std::vector<size_t> OOBIndex;
+        for (size_t i = 0; i < sampleSize; i++) {
+            if (inBagCounts[i] == 0 &&
+                (minTreesPerFold == 0 ||
+                 !is_marked_group(isRemovedGroup,
+                                  (*(trainingData->getGroups()))[i]))) {
+                OOBIndex.push_back(i);
+            }
+        }
         std::vector< size_t > AvgIndices;
 
         // Check the double bootstrap, if true, we take another sample
@@ -8,6 +8,7 @@
 #include <random>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 
 void assign_groups_to_folds(
         size_t numGroups,
@@ -16,6 +17,83 @@ void assign_groups_to_folds(
         std::mt19937_64& random_number_generator
 );
 
+// Sets isMarked[g] for every group g in groupIdx
+void mark_groups(
+        const std::vector<size_t>& groupIdx,
+        std::vector<char>& isMarked
+);
+
+inline bool is_marked_group(
+        const std::vector<char>& isMarked,
+        size_t group
+) {
+    return group < isMarked.size() && isMarked[group];
+}
+
+// Counts how often each of the numRows observations appears in sampleIndex
+void count_sample_indices(
+        const std::vector<size_t>& sampleIndex,
+        size_t numRows,
+        std::vector<unsigned int>& inBagCounts
+);
+
+// The in bag counts of the rows of one sample of a tree, kept in 8 bits while
+// no row is drawn more than 255 times and in 16 bits otherwise
+struct sample_counts {
+    bool wide;
+    std::vector<uint8_t> narrowCounts;
+    std::vector<uint16_t> wideCounts;
+
+    sample_counts(): wide(false) {}
+
+    unsigned int operator[](size_t row) const {
+        return wide ? wideCounts[row] : narrowCounts[row];
+    }
+
+    size_t size() const {
+        return wide ? wideCounts.size() : narrowCounts.size();
+    }
+
+    size_t getMemoryUsage() const {
+        return narrowCounts.size() * sizeof(uint8_t) +
+          wideCounts.size() * sizeof(uint16_t);
+    }
+};
+
+// Counts the rows of sampleIndex among the numRows observations, which throws
+// when a row is drawn more than 65535 times
+void count_sample_rows(
+        const std::vector<size_t>& sampleIndex,
+        size_t numRows,
+        sample_counts& counts
+);
+
+// The rows which are in the sample in increasing order, each given once
+// (countedRows) or as often as it was drawn (sampleIndex)
+void counted_rows(
+        const sample_counts& counts,
+        std::vector<size_t>& countedRows
+);
+
+void counted_sample_index(
+        const sample_counts& counts,
+        std::vector<size_t>& sampleIndex
+);
+
+// The number of observations of a node and the mean of their outcomes. With
+// counts every row of sampleIndex stands for as many observations as it was
+// drawn, without them the rows are counted as they are listed.
+size_t counted_size(
+        const std::vector<size_t>* sampleIndex,
+        const sample_counts* counts
+);
+
+double counted_mean(
+        DataFrame* trainingData,
+        std::vector<size_t>* sampleIndex,
+        const sample_counts* counts
+);
+
 void group_out_sample(
         std::vector<size_t>& removedGroupIdx,
         std::vector<size_t>& groupMemberships,
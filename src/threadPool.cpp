@@ -0,0 +1,202 @@
+#include "threadPool.h"
+#include <algorithm>
+
+// The slot of the current thread within the running parallelFor call
+static thread_local size_t poolSlot = 0;
+
+forestryThreadPool::forestryThreadPool():
+  _shutdown(false) {}
+
+forestryThreadPool::~forestryThreadPool() {
+  shutdown();
+}
+
+void forestryThreadPool::shutdown() {
+  std::vector<std::thread> workers;
+  {
+    std::lock_guard<std::mutex> lock(_stateMutex);
+    _shutdown = true;
+    workers.swap(_workers);
+  }
+  _jobStarted.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  std::lock_guard<std::mutex> lock(_stateMutex);
+  _shutdown = false;
+}
+
+void forestryThreadPool::parallelFor(
+  size_t begin,
+  size_t end,
+  size_t nthread,
+  const std::function<void(size_t)>& task
+) {
+  if (begin >= end) {
+    return;
+  }
+
+  if (nthread == 0) {
+    nthread = std::thread::hardware_concurrency();
+  }
+  if (nthread > end - begin) {
+    nthread = end - begin;
+  }
+
+  size_t outerSlot = poolSlot;
+
+  if (nthread <= 1) {
+    poolSlot = 0;
+    try {
+      for (size_t i = begin; i < end; i++) {
+        task(i);
+      }
+    } catch (...) {
+      poolSlot = outerSlot;
+      throw;
+    }
+    poolSlot = outerSlot;
+    return;
+  }
+
+  job currentJob;
+  currentJob.task = &task;
+  currentJob.nextIndex = begin;
+  currentJob.endIndex = end;
+  currentJob.nthread = nthread;
+  // The calling thread works as well, so nthread - 1 workers can join
+  currentJob.openSlots = nthread - 1;
+  currentJob.runningWorkers = 0;
+  currentJob.error = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(_stateMutex);
+    while (_workers.size() < nthread - 1) {
+      _workers.emplace_back(&forestryThreadPool::workerLoop, this);
+    }
+    _jobs.push_back(&currentJob);
+  }
+  _jobStarted.notify_all();
+
+  poolSlot = 0;
+  runTasks(currentJob);
+  poolSlot = outerSlot;
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(_stateMutex);
+    // All indices have been handed out, so no more workers can join
+    _jobs.erase(std::find(_jobs.begin(), _jobs.end(), &currentJob));
+    _jobFinished.wait(lock, [&currentJob] {
+      return currentJob.runningWorkers == 0;
+    });
+    error = currentJob.error;
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+forestryThreadPool::job* forestryThreadPool::findOpenJob() {
+  for (size_t k = _jobs.size(); k > 0; k--) {
+    job* candidate = _jobs[k - 1];
+    if (candidate->openSlots > 0 &&
+        candidate->nextIndex.load() < candidate->endIndex) {
+      return candidate;
+    }
+  }
+  return nullptr;
+}
+
+void forestryThreadPool::workerLoop() {
+  while (true) {
+    job* currentJob;
+    {
+      std::unique_lock<std::mutex> lock(_stateMutex);
+      _jobStarted.wait(lock, [this] {
+        return _shutdown || findOpenJob() != nullptr;
+      });
+      if (_shutdown) {
+        return;
+      }
+      currentJob = findOpenJob();
+      poolSlot = currentJob->nthread - currentJob->openSlots;
+      currentJob->openSlots--;
+      currentJob->runningWorkers++;
+    }
+
+    runTasks(*currentJob);
+
+    {
+      std::lock_guard<std::mutex> lock(_stateMutex);
+      currentJob->runningWorkers--;
+      if (currentJob->runningWorkers == 0) {
+        _jobFinished.notify_all();
+      }
+    }
+  }
+}
+
+void forestryThreadPool::runTasks(job &currentJob) {
+  while (true) {
+    size_t i = currentJob.nextIndex.fetch_add(1);
+    if (i >= currentJob.endIndex) {
+      return;
+    }
+    try {
+      (*currentJob.task)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(_stateMutex);
+      if (!currentJob.error) {
+        currentJob.error = std::current_exception();
+      }
+      // Stop handing out the remaining indices
+      currentJob.nextIndex = currentJob.endIndex;
+    }
+  }
+}
+
+size_t forestryThreadPool::getSlot() {
+  return poolSlot;
+}
+
+forestryThreadPool& getThreadPool() {
+  static forestryThreadPool* threadPool = new forestryThreadPool();
+  return *threadPool;
+}
+
+orderedFold::orderedFold(
+  size_t begin,
+  size_t window,
+  const std::function<void(size_t)>& fold
+):
+  _fold(fold), _nextIndex(begin), _window(std::max(window, (size_t) 1)),
+  _finished(_window, 0), _folding(false) {}
+
+void orderedFold::start(size_t index) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _folded.wait(lock, [this, index] {
+    return index < _nextIndex + _window;
+  });
+}
+
+void orderedFold::finish(size_t index) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _finished[index % _window] = 1;
+  if (_folding) {
+    return;
+  }
+  _folding = true;
+  while (_finished[_nextIndex % _window]) {
+    _finished[_nextIndex % _window] = 0;
+    size_t foldIndex = _nextIndex;
+    lock.unlock();
+    _fold(foldIndex);
+    lock.lock();
+    // The slot of foldIndex can only be reused once it has been folded
+    _nextIndex++;
+    _folded.notify_all();
+  }
+  _folding = false;
+}
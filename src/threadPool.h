@@ -0,0 +1,120 @@
+#ifndef FORESTRYCPP_THREADPOOL_H
+#define FORESTRYCPP_THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+// A pool of worker threads which is shared by all forests and reused across
+// calls. Work is handed out one index at a time from a shared counter, so a
+// thread which finishes a cheap task immediately picks up the next one instead
+// of waiting on a static chunk of the range.
+class forestryThreadPool {
+
+public:
+  forestryThreadPool();
+  virtual ~forestryThreadPool();
+
+  // Runs task(i) for every i in [begin, end) using at most nthread threads,
+  // the calling thread included, and returns once all calls have finished.
+  // The first exception thrown by a task is rethrown to the caller. Calls
+  // made from inside a task are shared with the workers which are idle, so
+  // the tasks of a few long calls can be split up further.
+  void parallelFor(
+    size_t begin,
+    size_t end,
+    size_t nthread,
+    const std::function<void(size_t)>& task
+  );
+
+  // Stops and joins the workers. It must not be called while a parallelFor
+  // call is running. Later calls start new workers.
+  void shutdown();
+
+  // Returns the slot of the calling thread within the current parallelFor
+  // call, between 0 and nthread - 1. The calling thread of parallelFor always
+  // gets slot 0, so tasks can keep per thread state without locking.
+  static size_t getSlot();
+
+private:
+  // The state of one parallelFor call, which lives on the stack of the
+  // calling thread until all tasks have finished
+  struct job {
+    const std::function<void(size_t)>* task;
+    std::atomic<size_t> nextIndex;
+    size_t endIndex;
+    size_t nthread;
+    // Slots still free for workers joining the call
+    size_t openSlots;
+    // Workers currently running tasks of the call
+    size_t runningWorkers;
+    std::exception_ptr error;
+  };
+
+  void workerLoop();
+
+  // Returns the newest call which still has tasks and free slots, or nullptr
+  job* findOpenJob();
+
+  void runTasks(job &currentJob);
+
+  std::vector<std::thread> _workers;
+  // The calls which are running, from the oldest to the newest. Idle workers
+  // join the newest first, which finishes nested calls before new outer tasks
+  // are started.
+  std::vector<job*> _jobs;
+  // Protects the job state
+  std::mutex _stateMutex;
+  std::condition_variable _jobStarted;
+  std::condition_variable _jobFinished;
+  bool _shutdown;
+};
+
+// Returns the thread pool shared by all forests. The pool is never destroyed,
+// since joining its workers while the library is detached can hang (Windows
+// holds the loader lock then, which the exiting workers wait for), so its
+// workers are stopped with shutdown when the package is unloaded instead.
+forestryThreadPool& getThreadPool();
+
+// Hands the results of the tasks of a parallelFor call to fold in the order of
+// their indices, so they are combined as by a serial loop while only a few of
+// them are kept. A task calls start before it computes its result, which waits
+// until the index is less than window indices ahead of the next index to fold,
+// and finish once the result is stored, for example at index % window. The
+// finished results which are next in order are then folded on the calling
+// thread. parallelFor hands out the indices in increasing order, so the task
+// of the next index to fold is always running and never waits.
+class orderedFold {
+
+public:
+  orderedFold(
+    size_t begin,
+    size_t window,
+    const std::function<void(size_t)>& fold
+  );
+
+  void start(size_t index);
+
+  // Has to be called for every started index, also when its task failed
+  void finish(size_t index);
+
+  size_t getWindow() const {
+    return _window;
+  }
+
+private:
+  const std::function<void(size_t)>& _fold;
+  size_t _nextIndex;
+  size_t _window;
+  std::vector<char> _finished;
+  // Set while a thread folds, the results finished meanwhile are left to it
+  bool _folding;
+  std::mutex _mutex;
+  std::condition_variable _folded;
+};
+
+#endif //FORESTRYCPP_THREADPOOL_H
@@ -79,9 +79,11 @@ double calculateRSS(
     arma::Mat<double> y(outcomePoints.size(), 1);
     y.col(0) = arma::conv_to<arma::Col<double> >::from(outcomePoints);
 
-    // Compute XtX + lambda * I * Y = C
-    arma::Mat<double> coefficients = (xTrain.t() * xTrain +
-      identity * overfitPenalty).i() * xTrain.t() * y;
+    // Solve (XtX + lambda * I) * C = XtY
+    arma::Mat<double> coefficients = solveRidgeSystem(
+      xTrain.t() * xTrain + identity * overfitPenalty,
+      xTrain.t() * y
+    );
 
     // Compute test matrix
     arma::Mat<double> xTest(testIndex.size(), dimension + 1);
@@ -204,7 +206,7 @@ void updateBestSplitS(
   }
 
   //Sort indices of observations ascending by currentFeature
-  std::vector<double>* featureData = trainingData->getFeatureData(bestSplitFeature);
+  column_view* featureData = trainingData->getFeatureData(bestSplitFeature);
 
   std::sort(splittingIndices.begin(),
             splittingIndices.end(),
@@ -256,7 +258,7 @@ void updateBestSplitG(
   }
 
   //Sort indices of observations ascending by currentFeature
-  std::vector<double>* featureData = trainingData->getFeatureData(bestSplitFeature);
+  column_view* featureData = trainingData->getFeatureData(bestSplitFeature);
 
   std::sort(splittingIndices.begin(),
             splittingIndices.end(),
@@ -301,10 +303,10 @@ void updateAArmadillo(
 
   //Update A using Sherman–Morrison formula corresponding to right or left side
   if (leftNode) {
-    a_k = a_k - ((z_K) * (z_K).t()) /
+    a_k -= ((z_K) * (z_K).t()) /
       (1 + as_scalar(new_x.t() * z_K));
   } else {
-    a_k = a_k + ((z_K) * (z_K).t()) /
+    a_k += ((z_K) * (z_K).t()) /
       (1 - as_scalar(new_x.t() * z_K));
   }
 }
@@ -316,24 +318,30 @@ void updateSkArmadillo(
     bool left
 ) {
   if (left) {
-    s_k = s_k + (next_y * (next));
+    s_k += next_y * next;
   } else {
-    s_k = s_k - (next_y * (next));
+    s_k -= next_y * next;
   }
 }
 
-double computeRSSArmadillo(
-    arma::Mat<double>& A_r,
-    arma::Mat<double>& A_l,
-    arma::Mat<double>& S_r,
-    arma::Mat<double>& S_l,
-    arma::Mat<double>& G_r,
-    arma::Mat<double>& G_l
+double computeRidgeSplitLoss(
+    const arma::Mat<double>& beta_r,
+    const arma::Mat<double>& beta_l,
+    const arma::Mat<double>& S_r,
+    const arma::Mat<double>& S_l,
+    double overfitPenalty
 ) {
-  return (as_scalar((S_l.t() * A_l) * (G_l * (A_l * S_l))) +
-          as_scalar((S_r.t() * A_r) * (G_r * (A_r * S_r))) -
-          as_scalar(2.0 * S_l.t() * (A_l * S_l)) -
-          as_scalar(2.0 * S_r.t() * (A_r * S_r)));
+  // The coefficients solve (G + lambda * I) * beta = S with an unpenalized
+  // intercept, so the split dependent part of the residual sum of squares
+  // beta' * G * beta - 2 * beta' * S of each side equals
+  // -beta' * S - lambda * beta' * I * beta, and G is not needed
+  size_t intercept = beta_l.n_rows - 1;
+  double penaltyLeft = arma::dot(beta_l, beta_l) -
+    beta_l(intercept, 0) * beta_l(intercept, 0);
+  double penaltyRight = arma::dot(beta_r, beta_r) -
+    beta_r(intercept, 0) * beta_r(intercept, 0);
+  return -arma::dot(beta_l, S_l) - arma::dot(beta_r, S_r) -
+    overfitPenalty * (penaltyLeft + penaltyRight);
 }
 
 
@@ -345,19 +353,10 @@ void updateRSSComponents(
     arma::Mat<double>& aRight,
     arma::Mat<double>& sLeft,
     arma::Mat<double>& sRight,
-    arma::Mat<double>& gLeft,
-    arma::Mat<double>& gRight,
-    arma::Mat<double>& crossingObservation,
-    arma::Mat<double>& obOuter
+    arma::Mat<double>& crossingObservation
 ) {
-  //Get observation that will cross the partition
-  std::vector<double> newLeftObservation =
-    trainingData->getLinObsData(nextIndex);
-
-  newLeftObservation.push_back(1.0);
-
-  crossingObservation.col(0) =
-    arma::conv_to<arma::Col<double> >::from(newLeftObservation);
+  //Get observation that will cross the partition, the intercept stays 1
+  trainingData->getLinObsData(crossingObservation.memptr(), nextIndex);
 
   double crossingOutcome = trainingData->getOutcomePoint(nextIndex);
 
@@ -365,10 +364,7 @@ void updateRSSComponents(
   updateSkArmadillo(sLeft, crossingObservation, crossingOutcome, true);
   updateSkArmadillo(sRight, crossingObservation, crossingOutcome, false);
 
-  obOuter = crossingObservation * crossingObservation.t();
-  gLeft = gLeft + obOuter;
-  gRight = gRight - obOuter;
-
+  //Rank one updates of the inverses of both penalized Gram matrices
   updateAArmadillo(aLeft, crossingObservation, true);
   updateAArmadillo(aRight, crossingObservation, false);
 }
@@ -427,6 +423,160 @@ double calcMuBarVar(
   return muBarVarSum/totalCount;
 }
 
+void calcMuBarVarBatch(
+    const double* leftSums,
+    const double* leftCounts,
+    size_t numCandidates,
+    double totalSum,
+    double totalCount,
+    double* losses
+) {
+  // The same arithmetic as calcMuBarVar in the same order, so the losses are
+  // identical, written as one branch free loop over contiguous arrays which
+  // compilers vectorize for the instruction set R was built for
+  double parentMean = totalSum/totalCount;
+  for (size_t i = 0; i < numCandidates; i++) {
+    double leftCount = leftCounts[i];
+    double rightCount = totalCount - leftCount;
+    double leftMeanCentered  = leftSums[i]/leftCount - parentMean;
+    double rightMeanCentered = (totalSum - leftSums[i])/rightCount - parentMean;
+    double muBarVarSum = leftCount * leftMeanCentered * leftMeanCentered +
+      rightCount * rightMeanCentered * rightMeanCentered;
+    losses[i] = muBarVarSum/totalCount;
+  }
+}
+
+void calculatePrefixSums(
+    const double* values,
+    size_t numValues,
+    double* prefixSums
+) {
+  double runningSum = 0;
+  prefixSums[0] = 0;
+  for (size_t i = 0; i < numValues; i++) {
+    runningSum += values[i];
+    prefixSums[i + 1] = runningSum;
+  }
+}
+
+
+void buildCategoryTable(
+    category_table &table,
+    DataFrame* trainingData,
+    size_t currentFeature,
+    std::vector<size_t>* averagingSampleIndex,
+    std::vector<size_t>* splittingSampleIndex,
+    const sample_counts* averagingCounts,
+    const sample_counts* splittingCounts
+) {
+  size_t splitSize = (*splittingSampleIndex).size();
+  size_t avgSize = (*averagingSampleIndex).size();
+
+  // Order the splitting samples by category, keeping their order within a
+  // category, and the averaging categories
+  std::vector<double> splitCategory(splitSize);
+  std::vector<size_t> splitOrder(splitSize);
+  for (size_t j = 0; j < splitSize; j++) {
+    splitCategory[j] =
+      (*trainingData).getPoint((*splittingSampleIndex)[j], currentFeature);
+    splitOrder[j] = j;
+  }
+  std::stable_sort(
+    splitOrder.begin(),
+    splitOrder.end(),
+    [&](size_t lhs, size_t rhs) {
+      return splitCategory[lhs] < splitCategory[rhs];
+    }
+  );
+
+  std::vector<double> avgCategory(avgSize);
+  for (size_t j = 0; j < avgSize; j++) {
+    avgCategory[j] =
+      (*trainingData).getPoint((*averagingSampleIndex)[j], currentFeature);
+  }
+
+  // The counts of the averaging rows are sorted along with their categories
+  std::vector<unsigned int> avgRowCount;
+  if (averagingCounts) {
+    std::vector<size_t> avgOrder(avgSize);
+    for (size_t j = 0; j < avgSize; j++) {
+      avgOrder[j] = j;
+    }
+    std::sort(
+      avgOrder.begin(),
+      avgOrder.end(),
+      [&](size_t lhs, size_t rhs) {
+        return avgCategory[lhs] < avgCategory[rhs];
+      }
+    );
+    std::vector<double> sortedCategory(avgSize);
+    avgRowCount.resize(avgSize);
+    for (size_t j = 0; j < avgSize; j++) {
+      sortedCategory[j] = avgCategory[avgOrder[j]];
+      avgRowCount[j] = (*averagingCounts)[(*averagingSampleIndex)[avgOrder[j]]];
+    }
+    std::swap(avgCategory, sortedCategory);
+  } else {
+    std::sort(avgCategory.begin(), avgCategory.end());
+  }
+
+  table.category.clear();
+  table.splitCount.clear();
+  table.avgCount.clear();
+  table.splitSum.clear();
+  table.splitSamples.clear();
+  table.splitSamples.reserve(splitSize);
+
+  // Walk both orders at once, one category at a time
+  size_t splitPosition = 0;
+  size_t avgPosition = 0;
+  while (splitPosition < splitSize || avgPosition < avgSize) {
+    double currentCategory;
+    if (splitPosition == splitSize) {
+      currentCategory = avgCategory[avgPosition];
+    } else if (avgPosition == avgSize) {
+      currentCategory = splitCategory[splitOrder[splitPosition]];
+    } else {
+      currentCategory = std::min(
+        splitCategory[splitOrder[splitPosition]],
+        avgCategory[avgPosition]
+      );
+    }
+
+    size_t splitCount = 0;
+    double splitSum = 0;
+    while (
+        splitPosition < splitSize &&
+          splitCategory[splitOrder[splitPosition]] == currentCategory
+    ) {
+      size_t currentSample = (*splittingSampleIndex)[splitOrder[splitPosition]];
+      if (splittingCounts) {
+        unsigned int rowCount = (*splittingCounts)[currentSample];
+        splitSum += rowCount * (*trainingData).getOutcomePoint(currentSample);
+        splitCount += rowCount;
+      } else {
+        splitSum += (*trainingData).getOutcomePoint(currentSample);
+        splitCount++;
+      }
+      table.splitSamples.push_back(currentSample);
+      splitPosition++;
+    }
+
+    size_t avgCount = 0;
+    while (
+        avgPosition < avgSize &&
+          avgCategory[avgPosition] == currentCategory
+    ) {
+      avgCount += averagingCounts ? avgRowCount[avgPosition] : 1;
+      avgPosition++;
+    }
+
+    table.category.push_back(currentCategory);
+    table.splitCount.push_back(splitCount);
+    table.avgCount.push_back(avgCount);
+    table.splitSum.push_back(splitSum);
+  }
+}
 
 void findBestSplitRidgeCategorical(
     std::vector<size_t>* averagingSampleIndex,
@@ -445,127 +595,101 @@ void findBestSplitRidgeCategorical(
     std::shared_ptr< arma::Mat<double> > gtotal,
     std::shared_ptr< arma::Mat<double> > stotal
 ) {
-  /* Put all categories in a set
-   * aggregate G_k matrices to put in left node when splitting
-   * aggregate S_k and G_k matrices at each step
-   *
-   * linearly iterate through averaging indices adding count to total set count
+  /* Build the table of the categories of the node in one pass, with the
+   * splitting samples grouped by category
    *
-   * linearly iterate thought splitting indices and add G_k to the matrix mapped
-   * to each index, then put in the all categories set
+   * For each category which leaves enough observations on both sides,
+   * aggregate the G_k and S_k matrices of its splitting samples to put in the
+   * left node
    *
    * Left is aggregated, right is total - aggregated
    * subtract and feed to RSS calculator for each partition
    * call updateBestSplitRidge with correct G_k matrices
    */
-
-  // Set to hold all different categories
-  std::set<double> all_categories;
   std::vector<double> temp;
 
   // temp matrices for RSS components
+  arma::Mat<double> gLeftTemp(size((*gtotal)));
+  arma::Mat<double> sLeftTemp(size((*stotal)));
   arma::Mat<double> gRightTemp(size((*gtotal)));
   arma::Mat<double> sRightTemp(size((*stotal)));
-  arma::Mat<double> aRightTemp(size((*gtotal)));
-  arma::Mat<double> aLeftTemp(size((*gtotal)));
   arma::Mat<double> crossingObservation(size((*stotal)));
   arma::Mat<double> identity(size((*gtotal)));
 
   identity.eye();
   identity(identity.n_rows-1, identity.n_cols-1) = 0.0;
-  size_t splitTotalCount = 0;
-  size_t averageTotalCount = 0;
-
-  // Create map to track the count and RSS components
-  std::map<double, size_t> splittingCategoryCount;
-  std::map<double, size_t> averagingCategoryCount;
-  std::map<double, arma::Mat<double> > gMatrices;
-  std::map<double, arma::Mat<double> > sMatrices;
-
-  for (size_t j=0; j<averagingSampleIndex->size(); j++) {
-    all_categories.insert(
-      (*trainingData).getPoint((*averagingSampleIndex)[j], currentFeature)
-    );
-    averageTotalCount++;
-  }
+  size_t splitTotalCount = splittingSampleIndex->size();
+  size_t averageTotalCount = averagingSampleIndex->size();
 
-  for (size_t j=0; j<splittingSampleIndex->size(); j++) {
-    all_categories.insert(
-      (*trainingData).getPoint((*splittingSampleIndex)[j], currentFeature)
-    );
-    splitTotalCount++;
-  }
-
-  for (
-      std::set<double>::iterator it=all_categories.begin();
-      it != all_categories.end();
-      ++it
-  ) {
-    splittingCategoryCount[*it] = 0;
-    averagingCategoryCount[*it] = 0;
-    gMatrices[*it] = arma::Mat<double>(size(*gtotal)).zeros();
-    sMatrices[*it] = arma::Mat<double>(size(*stotal)).zeros();
-  }
-
-  // Put all matrices in map
-  for (size_t j = 0; j<splittingSampleIndex->size(); j++) {
-    // Add each observation to correct matrix in map
-    double currentCategory = trainingData->getPoint((*splittingSampleIndex)[j],
-                                                    currentFeature);
-    double currentOutcome =
-      trainingData->getOutcomePoint((*splittingSampleIndex)[j]);
-
-    temp = trainingData->getLinObsData((*splittingSampleIndex)[j]);
-    temp.push_back(1);
-    crossingObservation.col(0) = arma::conv_to<arma::Col<double> >::from(temp);
-
-    updateSkArmadillo(sMatrices[currentCategory],
-                      crossingObservation,
-                      currentOutcome,
-                      true);
-
-    gMatrices[currentCategory] = gMatrices[currentCategory]
-    +crossingObservation * crossingObservation.t();
-    splittingCategoryCount[currentCategory]++;
-  }
-
-  for (size_t j=0; j<(*averagingSampleIndex).size(); j++) {
-    double currentCategory = (*trainingData).
-    getPoint((*averagingSampleIndex)[j], currentFeature);
-    averagingCategoryCount[currentCategory]++;
-  }
+  category_table categories;
+  buildCategoryTable(
+    categories,
+    trainingData,
+    currentFeature,
+    averagingSampleIndex,
+    splittingSampleIndex,
+    nullptr,
+    nullptr
+  );
 
   // Evaluate possible splits using associated RSS components
-  for (
-      std::set<double>::iterator it=all_categories.begin();
-      it != all_categories.end();
-      ++it
-  ) {
+  size_t groupEnd = 0;
+  for (size_t c = 0; c < categories.category.size(); c++) {
+    size_t splitCategoryCount = categories.splitCount[c];
+    size_t avgCategoryCount = categories.avgCount[c];
+    size_t groupBegin = groupEnd;
+    groupEnd += splitCategoryCount;
+
     // Check leaf size at least nodesize
     if (
         std::min(
-          splittingCategoryCount[*it],
-                                splitTotalCount - splittingCategoryCount[*it]
+          splitCategoryCount,
+          splitTotalCount - splitCategoryCount
         ) < splitNodeSize ||
           std::min(
-            averagingCategoryCount[*it],
-                                  averageTotalCount - averagingCategoryCount[*it]
+            avgCategoryCount,
+            averageTotalCount - avgCategoryCount
           ) < averageNodeSize
     ) {
       continue;
     }
-    gRightTemp = (*gtotal) - gMatrices[*it];
-    sRightTemp = (*stotal) - sMatrices[*it];
 
-    aRightTemp = (gRightTemp + overfitPenalty * identity).i();
-    aLeftTemp = (gMatrices[*it] + overfitPenalty * identity).i();
+    // Add each observation of the category to the left matrices
+    gLeftTemp.zeros();
+    sLeftTemp.zeros();
+    for (size_t j = groupBegin; j < groupEnd; j++) {
+      size_t currentSample = categories.splitSamples[j];
+      double currentOutcome = trainingData->getOutcomePoint(currentSample);
+
+      temp = trainingData->getLinObsData(currentSample);
+      temp.push_back(1);
+      crossingObservation.col(0) = arma::conv_to<arma::Col<double> >::from(temp);
+
+      updateSkArmadillo(sLeftTemp,
+                        crossingObservation,
+                        currentOutcome,
+                        true);
+
+      gLeftTemp = gLeftTemp + crossingObservation * crossingObservation.t();
+    }
+
+    gRightTemp = (*gtotal) - gLeftTemp;
+    sRightTemp = (*stotal) - sLeftTemp;
 
-    double currentSplitLoss = computeRSSArmadillo(aRightTemp,
-                                                  aLeftTemp,
-                                                  sRightTemp,
-                                                  sMatrices[*it],
-                                                           gRightTemp,
-                                                           gMatrices[*it]);
+    arma::Mat<double> betaRight = solveRidgeSystem(
+      gRightTemp + overfitPenalty * identity,
+      sRightTemp
+    );
+    arma::Mat<double> betaLeft = solveRidgeSystem(
+      gLeftTemp + overfitPenalty * identity,
+      sLeftTemp
+    );
+
+    double currentSplitLoss = computeRidgeSplitLoss(betaRight,
+                                                    betaLeft,
+                                                    sRightTemp,
+                                                    sLeftTemp,
+                                                    overfitPenalty);
 
     updateBestSplit(
       bestSplitLossAll,
@@ -573,7 +697,7 @@ void findBestSplitRidgeCategorical(
       bestSplitFeatureAll,
       bestSplitCountAll,
       -currentSplitLoss,
-      (double) *it,
+      categories.category[c],
       currentFeature,
       bestSplitTableIndex,
       random_number_generator
@@ -584,6 +708,8 @@ void findBestSplitRidgeCategorical(
 void findBestSplitValueCategorical(
     std::vector<size_t>* averagingSampleIndex,
     std::vector<size_t>* splittingSampleIndex,
+    const sample_counts* averagingCounts,
+    const sample_counts* splittingCounts,
     size_t bestSplitTableIndex,
     size_t currentFeature,
     double* bestSplitLossAll,
@@ -598,115 +724,114 @@ void findBestSplitValueCategorical(
 ) {
 
   // Count total number of observations for different categories
-  std::set<double> all_categories;
   double splitTotalSum = 0;
   size_t splitTotalCount = 0;
   size_t averageTotalCount = 0;
 
-  //EDITED
-  //Move indices to vectors so we can downsample if needed
-  std::vector<size_t> splittingIndices;
-  std::vector<size_t> averagingIndices;
-
-  for (size_t y = 0; y < (*splittingSampleIndex).size(); y++) {
-    splittingIndices.push_back((*splittingSampleIndex)[y]);
-  }
-
-  for (size_t y = 0; y < (*averagingSampleIndex).size(); y++) {
-    averagingIndices.push_back((*averagingSampleIndex)[y]);
-  }
-
+  std::vector<size_t>* splittingIndices = splittingSampleIndex;
+  std::vector<size_t>* averagingIndices = averagingSampleIndex;
 
   //If maxObs is smaller, randomly downsample
-  if (maxObs < (*splittingSampleIndex).size()) {
-    std::vector<size_t> newSplittingIndices;
-    std::vector<size_t> newAveragingIndices;
-
-    std::shuffle(splittingIndices.begin(), splittingIndices.end(),
+  std::vector<size_t> newSplittingIndices;
+  std::vector<size_t> newAveragingIndices;
+  bool downsampled = maxObs < (*splittingSampleIndex).size();
+  if (downsampled) {
+    std::vector<size_t> shuffledSplittingIndices(*splittingSampleIndex);
+    std::vector<size_t> shuffledAveragingIndices(*averagingSampleIndex);
+
+    std::shuffle(shuffledSplittingIndices.begin(),
+                 shuffledSplittingIndices.end(),
                  random_number_generator);
-    std::shuffle(averagingIndices.begin(), averagingIndices.end(),
+    std::shuffle(shuffledAveragingIndices.begin(),
+                 shuffledAveragingIndices.end(),
                  random_number_generator);
 
     for (size_t q = 0; q < maxObs; q++) {
-      newSplittingIndices.push_back(splittingIndices[q]);
-      newAveragingIndices.push_back(averagingIndices[q]);
+      newSplittingIndices.push_back(shuffledSplittingIndices[q]);
+      newAveragingIndices.push_back(shuffledAveragingIndices[q]);
     }
 
-    std::swap(newSplittingIndices, splittingIndices);
-    std::swap(newAveragingIndices, averagingIndices);
-  }
-
-  for (size_t j=0; j<splittingIndices.size(); j++) {
-    all_categories.insert(
-      (*trainingData).getPoint(splittingIndices[j], currentFeature)
-    );
-    splitTotalSum +=
-      (*trainingData).getOutcomePoint(splittingIndices[j]);
-    splitTotalCount++;
+    splittingIndices = &newSplittingIndices;
+    averagingIndices = &newAveragingIndices;
   }
 
-  for (size_t j=0; j<averagingIndices.size(); j++) {
-    all_categories.insert(
-      (*trainingData).getPoint(averagingIndices[j], currentFeature)
-    );
-    averageTotalCount++;
+  for (size_t j=0; j<(*splittingIndices).size(); j++) {
+    size_t currentRow = (*splittingIndices)[j];
+    if (splittingCounts) {
+      unsigned int rowCount = (*splittingCounts)[currentRow];
+      splitTotalSum += rowCount * (*trainingData).getOutcomePoint(currentRow);
+      splitTotalCount += rowCount;
+    } else {
+      splitTotalSum += (*trainingData).getOutcomePoint(currentRow);
+      splitTotalCount++;
+    }
   }
+  averageTotalCount = counted_size(averagingIndices, averagingCounts);
 
-  // Create map to track the count and sum of y squares
-  std::map<double, size_t> splittingCategoryCount;
-  std::map<double, size_t> averagingCategoryCount;
-  std::map<double, double> splittingCategoryYSum;
+  // Count the observations and sum the outcomes of every category in one pass
+  category_table categories;
+  buildCategoryTable(
+    categories,
+    trainingData,
+    currentFeature,
+    averagingSampleIndex,
+    splittingSampleIndex,
+    averagingCounts,
+    splittingCounts
+  );
 
-  for (
-      std::set<double>::iterator it=all_categories.begin();
-      it != all_categories.end();
-      ++it
-  ) {
-    splittingCategoryCount[*it] = 0;
-    averagingCategoryCount[*it] = 0;
-    splittingCategoryYSum[*it] = 0;
+  // When down sampling, only the categories of the sampled observations are
+  // candidates
+  std::vector<double> sampledCategories;
+  if (downsampled) {
+    for (size_t j=0; j<(*splittingIndices).size(); j++) {
+      sampledCategories.push_back(
+        (*trainingData).getPoint((*splittingIndices)[j], currentFeature)
+      );
+    }
+    for (size_t j=0; j<(*averagingIndices).size(); j++) {
+      sampledCategories.push_back(
+        (*trainingData).getPoint((*averagingIndices)[j], currentFeature)
+      );
+    }
+    std::sort(sampledCategories.begin(), sampledCategories.end());
   }
 
-  for (size_t j=0; j<(*splittingSampleIndex).size(); j++) {
-    double currentXValue = (*trainingData).
-    getPoint((*splittingSampleIndex)[j], currentFeature);
-    double currentYValue = (*trainingData).
-    getOutcomePoint((*splittingSampleIndex)[j]);
-    splittingCategoryCount[currentXValue] += 1;
-    splittingCategoryYSum[currentXValue] += currentYValue;
-  }
+  // Go through the sums and determine the best partition
+  for (size_t c = 0; c < categories.category.size(); c++) {
+    if (
+        downsampled &&
+          !std::binary_search(
+            sampledCategories.begin(),
+            sampledCategories.end(),
+            categories.category[c]
+          )
+    ) {
+      continue;
+    }
 
-  for (size_t j=0; j<(*averagingSampleIndex).size(); j++) {
-    double currentXValue = (*trainingData).
-    getPoint((*averagingSampleIndex)[j], currentFeature);
-    averagingCategoryCount[currentXValue] += 1;
-  }
+    size_t splitCategoryCount = categories.splitCount[c];
+    size_t avgCategoryCount = categories.avgCount[c];
 
-  // Go through the sums and determine the best partition
-  for (
-      std::set<double>::iterator it=all_categories.begin();
-      it != all_categories.end();
-      ++it
-  ) {
     // Check leaf size at least nodesize
     if (
         std::min(
-          splittingCategoryCount[*it],
-                                splitTotalCount - splittingCategoryCount[*it]
+          splitCategoryCount,
+          splitTotalCount - splitCategoryCount
         ) < splitNodeSize ||
         std::min(
-          averagingCategoryCount[*it],
-                                averageTotalCount - averagingCategoryCount[*it]
+          avgCategoryCount,
+          averageTotalCount - avgCategoryCount
         ) < averageNodeSize
     ) {
       continue;
     }
 
     double currentSplitLoss = calcMuBarVar(
-      splittingCategoryYSum[*it],
-                           splittingCategoryCount[*it],
-                                                 splitTotalSum,
-                                                 splitTotalCount
+      categories.splitSum[c],
+      splitCategoryCount,
+      splitTotalSum,
+      splitTotalCount
     );
 
     updateBestSplit(
@@ -715,7 +840,7 @@ void findBestSplitValueCategorical(
       bestSplitFeatureAll,
       bestSplitCountAll,
       currentSplitLoss,
-      *it,
+      categories.category[c],
       currentFeature,
       bestSplitTableIndex,
       random_number_generator
@@ -756,7 +881,7 @@ void findBestSplitRidge(
   }
 
   //Sort indexes of observations ascending by currentFeature
-  std::vector<double>* featureData = trainingData->getFeatureData(currentFeature);
+  column_view* featureData = trainingData->getFeatureData(currentFeature);
 
   sort(splittingIndexes.begin(),
        splittingIndexes.end(),
@@ -815,9 +940,6 @@ void findBestSplitRidge(
   arma::Mat<double> crossingObservation(firstOb.size(),
                                         1);
 
-  arma::Mat<double> obOuter(numLinearFeatures + 1,
-                            numLinearFeatures + 1);
-
   crossingObservation.col(0) = arma::conv_to<arma::Col<double> >::from(firstOb);
 
   arma::Mat<double> aLeft(numLinearFeatures + 1, numLinearFeatures + 1),
@@ -825,7 +947,9 @@ void findBestSplitRidge(
   gLeft(numLinearFeatures + 1, numLinearFeatures + 1),
   gRight(numLinearFeatures + 1, numLinearFeatures + 1),
   sLeft(numLinearFeatures + 1, 1),
-  sRight(numLinearFeatures + 1, 1);
+  sRight(numLinearFeatures + 1, 1),
+  betaLeft(numLinearFeatures + 1, 1),
+  betaRight(numLinearFeatures + 1, 1);
 
   initializeRSSComponents(
     trainingData,
@@ -862,10 +986,7 @@ void findBestSplitRidge(
         aRight,
         sLeft,
         sRight,
-        gLeft,
-        gRight,
-        crossingObservation,
-        obOuter
+        crossingObservation
       );
 
       splitLeftCount++;
@@ -932,12 +1053,13 @@ void findBestSplitRidge(
     }
 
     //Sum of RSS's of models fit on left and right partitions
-    double currentRSS = computeRSSArmadillo(aRight,
-                                            aLeft,
-                                            sRight,
-                                            sLeft,
-                                            gRight,
-                                            gLeft);
+    betaRight = aRight * sRight;
+    betaLeft = aLeft * sLeft;
+    double currentRSS = computeRidgeSplitLoss(betaRight,
+                                              betaLeft,
+                                              sRight,
+                                              sLeft,
+                                              overfitPenalty);
 
     double currentSplitValue;
 
@@ -978,9 +1100,41 @@ void findBestSplitRidge(
 }
 
 
-void findBestSplitValueNonCategorical(
+// Returns the split value between two consecutive feature values, which is
+// their midpoint with splitMiddle and drawn uniformly between them otherwise
+template <bool splitMiddle>
+inline double drawSplitValue(
+    double featureValue,
+    double newFeatureValue,
+    std::mt19937_64& random_number_generator
+) {
+  if (splitMiddle) {
+    return (newFeatureValue + featureValue) / 2.0;
+  }
+  std::uniform_real_distribution<double> unif_dist;
+  double tmp_random = unif_dist(random_number_generator) *
+    (newFeatureValue - featureValue);
+  double epsilon_lower = std::nextafter(featureValue, newFeatureValue);
+  double epsilon_upper = std::nextafter(newFeatureValue, featureValue);
+  double currentSplitValue = tmp_random + featureValue;
+  if (currentSplitValue > epsilon_upper) {
+    currentSplitValue = epsilon_upper;
+  }
+  if (currentSplitValue < epsilon_lower) {
+    currentSplitValue = epsilon_lower;
+  }
+  return currentSplitValue;
+}
+
+// The split kernels are instantiated for every combination of monotonic
+// constraints and middle splits, so the scans over the candidate splits do
+// not test these options. The functions below pick the instantiation.
+template <bool monotone, bool splitMiddle>
+void findBestSplitValueNonCategoricalKernel(
     std::vector<size_t>* averagingSampleIndex,
     std::vector<size_t>* splittingSampleIndex,
+    const sample_counts* averagingCounts,
+    const sample_counts* splittingCounts,
     size_t bestSplitTableIndex,
     size_t currentFeature,
     double* bestSplitLossAll,
@@ -991,254 +1145,758 @@ void findBestSplitValueNonCategorical(
     size_t splitNodeSize,
     size_t averageNodeSize,
     std::mt19937_64& random_number_generator,
-    bool splitMiddle,
     size_t maxObs,
-    bool monotone_splits,
-    monotonic_info monotone_details
+    monotonic_info &monotone_details,
+    objectArena< presort_counts >* presortArena
 ) {
 
   // Create specific vectors to holddata
   typedef std::tuple<double,double> dataPair;
   std::vector<dataPair> splittingData;
   std::vector<dataPair> averagingData;
+  // The sorted feature values and outcomes of both sets, kept in separate
+  // contiguous arrays for the split scan
+  std::vector<double> splitFeature;
+  std::vector<double> splitOutcome;
+  std::vector<double> avgFeature;
+  std::vector<double> avgOutcome;
   double splitTotalSum = 0;
   double avgTotalSum = 0;
 
-  for (size_t j=0; j<(*splittingSampleIndex).size(); j++){
-    // Retrieve the current feature value
-    double tmpFeatureValue = (*trainingData).
-    getPoint((*splittingSampleIndex)[j], currentFeature);
-    double tmpOutcomeValue = (*trainingData).
-    getOutcomePoint((*splittingSampleIndex)[j]);
-    splitTotalSum += tmpOutcomeValue;
-
-    // Adding data to the internal data vector (Note: R index)
-    splittingData.push_back(
-      std::make_tuple(
-        tmpFeatureValue,
-        tmpOutcomeValue
-      )
-    );
+  // With in bag counts every row of the node is read once, its outcome is
+  // multiplied by its count and the counts are kept alongside
+  bool weighted = splittingCounts != nullptr;
+  std::vector<double> splitWeight;
+  std::vector<double> avgWeight;
+
+  // When the node holds a large share of the training data, walking the
+  // pre-sorted row order of the feature once is cheaper than sorting the
+  // node's samples. Down sampling with maxObs and missing values in the
+  // feature still go through the sorting path. The order is only asked for
+  // once the node is large enough, since it is built on first use.
+  size_t numRows = (*trainingData).getNumRows();
+  double nodeSampleSize = (double) ((*splittingSampleIndex).size() +
+    (*averagingSampleIndex).size());
+  std::vector<size_t>* sortedRowIndex = nullptr;
+  bool usePresortedIndex =
+    maxObs >= (*splittingSampleIndex).size() &&
+    nodeSampleSize * std::log2(nodeSampleSize + 1) > (double) numRows;
+  if (usePresortedIndex) {
+    sortedRowIndex = (*trainingData).getSortedRowIndex(currentFeature);
+    usePresortedIndex = (*sortedRowIndex).size() == numRows;
   }
 
+  if (usePresortedIndex) {
+    column_view* featureCol =
+      (*trainingData).getFeatureData(currentFeature);
+    std::vector<double>* outcomeCol = (*trainingData).getOutcomeData();
+
+    // Count how often each row appears in the node, since bootstrap samples
+    // can contain the same observation several times. The counts come from
+    // the scratch space of the tree when it has one.
+    presort_counts localCounts;
+    std::unique_ptr< arenaObject< presort_counts > > arenaCounts;
+    presort_counts* counts = &localCounts;
+    if (presortArena) {
+      arenaCounts.reset(new arenaObject< presort_counts >(presortArena, 0));
+      counts = arenaCounts->get();
+    }
+    if (counts->split.size() != numRows) {
+      counts->split.assign(numRows, 0);
+      counts->avg.assign(numRows, 0);
+    }
+    std::vector<unsigned int> &splitRowCounts = counts->split;
+    std::vector<unsigned int> &avgRowCounts = counts->avg;
+
+    for (size_t j=0; j<(*splittingSampleIndex).size(); j++){
+      size_t currentRow = (*splittingSampleIndex)[j];
+      if (weighted) {
+        splitRowCounts[currentRow] = (*splittingCounts)[currentRow];
+        splitTotalSum += splitRowCounts[currentRow] *
+          (*trainingData).getOutcomePoint(currentRow);
+      } else {
+        splitTotalSum += (*trainingData).getOutcomePoint(currentRow);
+        splitRowCounts[currentRow]++;
+      }
+    }
 
+    for (size_t j=0; j<(*averagingSampleIndex).size(); j++){
+      size_t currentRow = (*averagingSampleIndex)[j];
+      if (weighted) {
+        avgRowCounts[currentRow] = (*averagingCounts)[currentRow];
+        avgTotalSum += avgRowCounts[currentRow] *
+          (*trainingData).getOutcomePoint(currentRow);
+      } else {
+        avgTotalSum += (*trainingData).getOutcomePoint(currentRow);
+        avgRowCounts[currentRow]++;
+      }
+    }
 
-  for (size_t j=0; j<(*averagingSampleIndex).size(); j++){
-    // Retrieve the current feature value
-    double tmpFeatureValue = (*trainingData).
-    getPoint((*averagingSampleIndex)[j], currentFeature);
-    double tmpOutcomeValue = (*trainingData).
-    getOutcomePoint((*averagingSampleIndex)[j]);
-    avgTotalSum += tmpOutcomeValue;
-
-    // Adding data to the internal data vector (Note: R index)
-    averagingData.push_back(
-      std::make_tuple(
-        tmpFeatureValue,
-        tmpOutcomeValue
-      )
-    );
-  }
-  // If there are more than maxSplittingObs, randomly downsample maxObs samples
-  if (maxObs < splittingData.size()) {
+    splitFeature.reserve((*splittingSampleIndex).size());
+    splitOutcome.reserve((*splittingSampleIndex).size());
+    avgFeature.reserve((*averagingSampleIndex).size());
+    avgOutcome.reserve((*averagingSampleIndex).size());
+
+    // Read out the node's samples in feature order
+    for (auto currentRow : *sortedRowIndex) {
+      if (weighted) {
+        if (splitRowCounts[currentRow] > 0) {
+          splitFeature.push_back((*featureCol)[currentRow]);
+          splitOutcome.push_back(
+            splitRowCounts[currentRow] * (*outcomeCol)[currentRow]);
+          splitWeight.push_back(splitRowCounts[currentRow]);
+        }
+        if (avgRowCounts[currentRow] > 0) {
+          avgFeature.push_back((*featureCol)[currentRow]);
+          avgOutcome.push_back(
+            avgRowCounts[currentRow] * (*outcomeCol)[currentRow]);
+          avgWeight.push_back(avgRowCounts[currentRow]);
+        }
+        continue;
+      }
+      for (unsigned int k = 0; k < splitRowCounts[currentRow]; k++) {
+        splitFeature.push_back((*featureCol)[currentRow]);
+        splitOutcome.push_back((*outcomeCol)[currentRow]);
+      }
+      for (unsigned int k = 0; k < avgRowCounts[currentRow]; k++) {
+        avgFeature.push_back((*featureCol)[currentRow]);
+        avgOutcome.push_back((*outcomeCol)[currentRow]);
+      }
+    }
 
-    std::vector<dataPair> newSplittingData;
-    std::vector<dataPair> newAveragingData;
+    // Only the rows of the node are cleared again
+    for (auto currentRow : *splittingSampleIndex) {
+      splitRowCounts[currentRow] = 0;
+    }
+    for (auto currentRow : *averagingSampleIndex) {
+      avgRowCounts[currentRow] = 0;
+    }
 
-    std::shuffle(splittingData.begin(), splittingData.end(),
-                 random_number_generator);
-    std::shuffle(averagingData.begin(), averagingData.end(),
-                 random_number_generator);
+  } else if (weighted) {
 
-    for (size_t q = 0; q < maxObs; q++) {
-      newSplittingData.push_back(splittingData[q]);
-      newAveragingData.push_back(averagingData[q]);
+    // The rows are sorted with their weighted outcomes and counts
+    typedef std::tuple<double,double,double> weightedDataPair;
+    std::vector<weightedDataPair> weightedSplittingData;
+    std::vector<weightedDataPair> weightedAveragingData;
+
+    for (size_t j=0; j<(*splittingSampleIndex).size(); j++){
+      size_t currentRow = (*splittingSampleIndex)[j];
+      double rowCount = (*splittingCounts)[currentRow];
+      double tmpOutcomeValue =
+        rowCount * (*trainingData).getOutcomePoint(currentRow);
+      splitTotalSum += tmpOutcomeValue;
+      weightedSplittingData.push_back(
+        std::make_tuple(
+          (*trainingData).getPoint(currentRow, currentFeature),
+          tmpOutcomeValue,
+          rowCount
+        )
+      );
     }
 
-    std::swap(newSplittingData, splittingData);
-    std::swap(newAveragingData, averagingData);
+    for (size_t j=0; j<(*averagingSampleIndex).size(); j++){
+      size_t currentRow = (*averagingSampleIndex)[j];
+      double rowCount = (*averagingCounts)[currentRow];
+      double tmpOutcomeValue =
+        rowCount * (*trainingData).getOutcomePoint(currentRow);
+      avgTotalSum += tmpOutcomeValue;
+      weightedAveragingData.push_back(
+        std::make_tuple(
+          (*trainingData).getPoint(currentRow, currentFeature),
+          tmpOutcomeValue,
+          rowCount
+        )
+      );
+    }
 
-  }
+    // If there are more than maxObs rows, randomly downsample maxObs rows
+    if (maxObs < weightedSplittingData.size()) {
+      std::shuffle(weightedSplittingData.begin(), weightedSplittingData.end(),
+                   random_number_generator);
+      std::shuffle(weightedAveragingData.begin(), weightedAveragingData.end(),
+                   random_number_generator);
+      weightedSplittingData.resize(maxObs);
+      weightedAveragingData.resize(
+        std::min(maxObs, weightedAveragingData.size()));
+
+      splitTotalSum = 0;
+      for (auto &row : weightedSplittingData) {
+        splitTotalSum += std::get<1>(row);
+      }
+      avgTotalSum = 0;
+      for (auto &row : weightedAveragingData) {
+        avgTotalSum += std::get<1>(row);
+      }
+    }
 
-  // Sort both splitting and averaging dataset
-  sort(
-    splittingData.begin(),
-    splittingData.end(),
-    [](const dataPair &lhs, const dataPair &rhs) {
+    auto byFeature = [](const weightedDataPair &lhs,
+                        const weightedDataPair &rhs) {
       return std::get<0>(lhs) < std::get<0>(rhs);
+    };
+    sort(weightedSplittingData.begin(), weightedSplittingData.end(), byFeature);
+    sort(weightedAveragingData.begin(), weightedAveragingData.end(), byFeature);
+
+    for (auto &row : weightedSplittingData) {
+      splitFeature.push_back(std::get<0>(row));
+      splitOutcome.push_back(std::get<1>(row));
+      splitWeight.push_back(std::get<2>(row));
     }
-  );
-  sort(
-    averagingData.begin(),
-    averagingData.end(),
-    [](const dataPair &lhs, const dataPair &rhs) {
-      return std::get<0>(lhs) < std::get<0>(rhs);
+    for (auto &row : weightedAveragingData) {
+      avgFeature.push_back(std::get<0>(row));
+      avgOutcome.push_back(std::get<1>(row));
+      avgWeight.push_back(std::get<2>(row));
     }
-  );
 
-  size_t splitLeftPartitionCount = 0;
-  size_t averageLeftPartitionCount = 0;
-  size_t splitTotalCount = splittingData.size();
-  size_t averageTotalCount = averagingData.size();
+  } else {
 
-  double splitLeftPartitionRunningSum = 0;
-  double avgLeftPartitionRunningSum = 0;
+    for (size_t j=0; j<(*splittingSampleIndex).size(); j++){
+      // Retrieve the current feature value
+      double tmpFeatureValue = (*trainingData).
+      getPoint((*splittingSampleIndex)[j], currentFeature);
+      double tmpOutcomeValue = (*trainingData).
+      getOutcomePoint((*splittingSampleIndex)[j]);
+      splitTotalSum += tmpOutcomeValue;
 
-  std::vector<dataPair>::iterator splittingDataIter = splittingData.begin();
-  std::vector<dataPair>::iterator averagingDataIter = averagingData.begin();
+      // Adding data to the internal data vector (Note: R index)
+      splittingData.push_back(
+        std::make_tuple(
+          tmpFeatureValue,
+          tmpOutcomeValue
+        )
+      );
+    }
 
-  // Initialize the split value to be minimum of first value in two datasets
-  double featureValue = std::min(
-    std::get<0>(*splittingDataIter),
-    std::get<0>(*averagingDataIter)
-  );
+    for (size_t j=0; j<(*averagingSampleIndex).size(); j++){
+      // Retrieve the current feature value
+      double tmpFeatureValue = (*trainingData).
+      getPoint((*averagingSampleIndex)[j], currentFeature);
+      double tmpOutcomeValue = (*trainingData).
+      getOutcomePoint((*averagingSampleIndex)[j]);
+      avgTotalSum += tmpOutcomeValue;
 
-  double newFeatureValue;
-  bool oneValueDistinctFlag = true;
+      // Adding data to the internal data vector (Note: R index)
+      averagingData.push_back(
+        std::make_tuple(
+          tmpFeatureValue,
+          tmpOutcomeValue
+        )
+      );
+    }
+    // If there are more than maxSplittingObs, randomly downsample maxObs samples
+    if (maxObs < splittingData.size()) {
 
-  while (
-      splittingDataIter < splittingData.end() ||
-        averagingDataIter < averagingData.end()
-  ){
+      std::vector<dataPair> newSplittingData;
+      std::vector<dataPair> newAveragingData;
+
+      std::shuffle(splittingData.begin(), splittingData.end(),
+                   random_number_generator);
+      std::shuffle(averagingData.begin(), averagingData.end(),
+                   random_number_generator);
+
+      for (size_t q = 0; q < maxObs; q++) {
+        newSplittingData.push_back(splittingData[q]);
+        newAveragingData.push_back(averagingData[q]);
+      }
+
+      std::swap(newSplittingData, splittingData);
+      std::swap(newAveragingData, averagingData);
+
+    }
+
+    // Sort both splitting and averaging dataset
+    sort(
+      splittingData.begin(),
+      splittingData.end(),
+      [](const dataPair &lhs, const dataPair &rhs) {
+        return std::get<0>(lhs) < std::get<0>(rhs);
+      }
+    );
+    sort(
+      averagingData.begin(),
+      averagingData.end(),
+      [](const dataPair &lhs, const dataPair &rhs) {
+        return std::get<0>(lhs) < std::get<0>(rhs);
+      }
+    );
+
+    splitFeature.resize(splittingData.size());
+    splitOutcome.resize(splittingData.size());
+    for (size_t j = 0; j < splittingData.size(); j++) {
+      splitFeature[j] = std::get<0>(splittingData[j]);
+      splitOutcome[j] = std::get<1>(splittingData[j]);
+    }
+    avgFeature.resize(averagingData.size());
+    avgOutcome.resize(averagingData.size());
+    for (size_t j = 0; j < averagingData.size(); j++) {
+      avgFeature[j] = std::get<0>(averagingData[j]);
+      avgOutcome[j] = std::get<1>(averagingData[j]);
+    }
+  }
 
+  // The scan walks the entries of both sets. Without counts every sample is
+  // an entry, with them an entry stands for as many samples as its count.
+  size_t splitEntries = splitFeature.size();
+  size_t avgEntries = avgFeature.size();
+
+  // Running sums of the outcomes of both sets in feature order, the sums of
+  // the first j entries are at position j
+  std::vector<double> splitPrefixSum(splitEntries + 1);
+  std::vector<double> avgPrefixSum(avgEntries + 1);
+  calculatePrefixSums(splitOutcome.data(), splitEntries,
+                      splitPrefixSum.data());
+  calculatePrefixSums(avgOutcome.data(), avgEntries,
+                      avgPrefixSum.data());
+
+  // The numbers of samples among the first j entries
+  std::vector<double> splitPrefixCount;
+  std::vector<double> avgPrefixCount;
+  if (weighted) {
+    splitPrefixCount.resize(splitEntries + 1);
+    avgPrefixCount.resize(avgEntries + 1);
+    calculatePrefixSums(splitWeight.data(), splitEntries,
+                        splitPrefixCount.data());
+    calculatePrefixSums(avgWeight.data(), avgEntries,
+                        avgPrefixCount.data());
+  }
+  auto splitCountAt = [&](size_t position) -> size_t {
+    return weighted ? (size_t) splitPrefixCount[position] : position;
+  };
+  auto avgCountAt = [&](size_t position) -> size_t {
+    return weighted ? (size_t) avgPrefixCount[position] : position;
+  };
+  size_t splitTotalCount = splitCountAt(splitEntries);
+  size_t averageTotalCount = avgCountAt(avgEntries);
+
+  // Collect the splits between consecutive distinct feature values which
+  // leave enough observations on both sides. Only the partition counts are
+  // compared here, the losses of all these candidates are computed at once
+  // afterwards.
+  std::vector<double> candidateLeftSum;
+  std::vector<double> candidateLeftCount;
+  std::vector<size_t> candidateAvgLeftPosition;
+  std::vector<double> candidateLower;
+  std::vector<double> candidateUpper;
+
+  size_t splitLeftPosition = 0;
+  size_t averageLeftPosition = 0;
+
+  // Initialize the split value to be minimum of first value in two datasets
+  double featureValue = std::min(splitFeature[0], avgFeature[0]);
+  double newFeatureValue;
+
+  while (true) {
     // Exhaust all current feature value in both datasets as partitioning
     while (
-        splittingDataIter < splittingData.end() &&
-          std::get<0>(*splittingDataIter) == featureValue
+        splitLeftPosition < splitEntries &&
+          splitFeature[splitLeftPosition] == featureValue
     ) {
-      splitLeftPartitionCount++;
-      splitLeftPartitionRunningSum += std::get<1>(*splittingDataIter);
-      splittingDataIter++;
+      splitLeftPosition++;
     }
-
     while (
-        averagingDataIter < averagingData.end() &&
-          std::get<0>(*averagingDataIter) == featureValue
+        averageLeftPosition < avgEntries &&
+          avgFeature[averageLeftPosition] == featureValue
     ) {
-      averageLeftPartitionCount++;
-      avgLeftPartitionRunningSum += std::get<1>(*averagingDataIter);
-      averagingDataIter++;
+      averageLeftPosition++;
     }
 
-    // Test if the all the values for the feature are the same, then proceed
-    if (oneValueDistinctFlag) {
-      oneValueDistinctFlag = false;
-      if (
-          splittingDataIter == splittingData.end() &&
-            averagingDataIter == averagingData.end()
-      ) {
-        break;
-      }
-    }
-
-    // Make partitions on the current feature and value in both splitting
-    // and averaging dataset. `averageLeftPartitionCount` and
-    // `splitLeftPartitionCount` already did the partition after we sort the
-    // array.
     // Get new feature value
     if (
-        splittingDataIter == splittingData.end() &&
-          averagingDataIter == averagingData.end()
+        splitLeftPosition == splitEntries &&
+          averageLeftPosition == avgEntries
     ) {
       break;
-    } else if (splittingDataIter == splittingData.end()) {
-      newFeatureValue = std::get<0>(*averagingDataIter);
-    } else if (averagingDataIter == averagingData.end()) {
-      newFeatureValue = std::get<0>(*splittingDataIter);
+    } else if (splitLeftPosition == splitEntries) {
+      newFeatureValue = avgFeature[averageLeftPosition];
+    } else if (averageLeftPosition == avgEntries) {
+      newFeatureValue = splitFeature[splitLeftPosition];
     } else {
       newFeatureValue = std::min(
-        std::get<0>(*splittingDataIter),
-        std::get<0>(*averagingDataIter)
+        splitFeature[splitLeftPosition],
+        avgFeature[averageLeftPosition]
       );
     }
 
+    size_t splitLeftPartitionCount = splitCountAt(splitLeftPosition);
+    size_t averageLeftPartitionCount = avgCountAt(averageLeftPosition);
+
     // Check leaf size at least nodesize
     if (
         std::min(
           splitLeftPartitionCount,
           splitTotalCount - splitLeftPartitionCount
-        ) < splitNodeSize ||
+        ) >= splitNodeSize &&
           std::min(
             averageLeftPartitionCount,
             averageTotalCount - averageLeftPartitionCount
-          ) < averageNodeSize
+          ) >= averageNodeSize
     ) {
-      // Update the oldFeature value before proceeding
-      featureValue = newFeatureValue;
-      continue;
+      candidateLeftSum.push_back(splitPrefixSum[splitLeftPosition]);
+      candidateLeftCount.push_back((double) splitLeftPartitionCount);
+      candidateAvgLeftPosition.push_back(averageLeftPosition);
+      candidateLower.push_back(featureValue);
+      candidateUpper.push_back(newFeatureValue);
     }
 
+    featureValue = newFeatureValue;
+  }
+
+  size_t numCandidates = candidateLeftSum.size();
+  std::vector<double> candidateLoss(numCandidates);
+  calcMuBarVarBatch(
+    candidateLeftSum.data(),
+    candidateLeftCount.data(),
+    numCandidates,
+    splitTotalSum,
+    (double) splitTotalCount,
+    candidateLoss.data()
+  );
+
+  // The monotonic constraints, the split values and the ties draw from the
+  // random number generator, so the candidates are visited in feature order
+  for (size_t c = 0; c < numCandidates; c++) {
+    featureValue = candidateLower[c];
+    newFeatureValue = candidateUpper[c];
+
     // If we are using monotonic constraints, we need to work out whether
     // the monotone constraints will reject a split
-    if (monotone_splits) {
+    if (monotone) {
+      size_t splitLeftCount = (size_t) candidateLeftCount[c];
+      double splitLeftSum = candidateLeftSum[c];
       bool keepMonotoneSplit = acceptMonotoneSplit(monotone_details,
                                                    currentFeature,
-                                                   splitLeftPartitionRunningSum / splitLeftPartitionCount,
-                                                   (splitTotalSum - splitLeftPartitionRunningSum)
-                                                     / (splitTotalCount - splitLeftPartitionCount));
+                                                   splitLeftSum / splitLeftCount,
+                                                   (splitTotalSum - splitLeftSum)
+                                                     / (splitTotalCount - splitLeftCount));
 
       bool avgKeepMonotoneSplit = true;
       // If monotoneAvg, we also need to check the monotonicity of the avg set
       if (monotone_details.monotoneAvg) {
+        size_t avgLeftPosition = candidateAvgLeftPosition[c];
+        size_t avgLeftCount = avgCountAt(avgLeftPosition);
+        double avgLeftSum = avgPrefixSum[avgLeftPosition];
         avgKeepMonotoneSplit = acceptMonotoneSplit(monotone_details,
                                                    currentFeature,
-                                                   avgLeftPartitionRunningSum / averageLeftPartitionCount,
-                                                   (avgTotalSum - avgLeftPartitionRunningSum)
-                                                     / (averageTotalCount - averageLeftPartitionCount));
+                                                   avgLeftSum / avgLeftCount,
+                                                   (avgTotalSum - avgLeftSum)
+                                                     / (averageTotalCount - avgLeftCount));
 
       }
 
       if (!(keepMonotoneSplit && avgKeepMonotoneSplit)) {
-        // Update the oldFeature value before proceeding
-        featureValue = newFeatureValue;
         continue;
       }
     }
 
-    // Calculate the variance of the splitting
-    double currentSplitLoss = calcMuBarVar(
-      splitLeftPartitionRunningSum,
-      splitLeftPartitionCount,
-      splitTotalSum,
-      splitTotalCount);
-
-
-    double currentSplitValue;
-    if (splitMiddle) {
-      currentSplitValue = (newFeatureValue + featureValue) / 2.0;
-    } else {
-      std::uniform_real_distribution<double> unif_dist;
-      double tmp_random = unif_dist(random_number_generator) *
-        (newFeatureValue - featureValue);
-      double epsilon_lower = std::nextafter(featureValue, newFeatureValue);
-      double epsilon_upper = std::nextafter(newFeatureValue, featureValue);
-      currentSplitValue = tmp_random + featureValue;
-      if (currentSplitValue > epsilon_upper) {
-        currentSplitValue = epsilon_upper;
-      }
-      if (currentSplitValue < epsilon_lower) {
-        currentSplitValue = epsilon_lower;
-      }
-    }
+    double currentSplitValue = drawSplitValue<splitMiddle>(
+      featureValue,
+      newFeatureValue,
+      random_number_generator
+    );
 
     updateBestSplit(
       bestSplitLossAll,
       bestSplitValueAll,
       bestSplitFeatureAll,
       bestSplitCountAll,
-      currentSplitLoss,
+      candidateLoss[c],
       currentSplitValue,
       currentFeature,
       bestSplitTableIndex,
       random_number_generator
     );
+  }
+}
 
-    // Update the old feature value
-    featureValue = newFeatureValue;
+void buildHistogram(
+    histogram_info &histogram,
+    DataFrame* trainingData,
+    size_t currentFeature,
+    std::vector<size_t>* averagingSampleIndex,
+    std::vector<size_t>* splittingSampleIndex
+) {
+  // Accumulate the outcome sums and counts of the node in each feature bin
+  std::vector<unsigned char>* bins =
+    (*trainingData).getHistogramBins(currentFeature);
+  std::vector<double>* outcomeCol = (*trainingData).getOutcomeData();
+  size_t numBins = (*trainingData).getHistogramBinLower(currentFeature)->size();
+
+  histogram.splitSum.assign(numBins, 0.0);
+  histogram.splitCount.assign(numBins, 0);
+  histogram.avgSum.assign(numBins, 0.0);
+  histogram.avgCount.assign(numBins, 0);
+
+  for (auto currentRow : *splittingSampleIndex) {
+    unsigned char currentBin = (*bins)[currentRow];
+    histogram.splitSum[currentBin] += (*outcomeCol)[currentRow];
+    histogram.splitCount[currentBin]++;
+  }
+
+  for (auto currentRow : *averagingSampleIndex) {
+    unsigned char currentBin = (*bins)[currentRow];
+    histogram.avgSum[currentBin] += (*outcomeCol)[currentRow];
+    histogram.avgCount[currentBin]++;
   }
 }
 
-void findBestSplitImpute(
+void subtractHistogram(
+    histogram_info &histogram,
+    const histogram_info &parentHistogram,
+    const histogram_info &siblingHistogram
+) {
+  size_t numBins = parentHistogram.splitSum.size();
+
+  histogram.splitSum.resize(numBins);
+  histogram.splitCount.resize(numBins);
+  histogram.avgSum.resize(numBins);
+  histogram.avgCount.resize(numBins);
+
+  for (size_t b = 0; b < numBins; b++) {
+    histogram.splitSum[b] =
+      parentHistogram.splitSum[b] - siblingHistogram.splitSum[b];
+    histogram.splitCount[b] =
+      parentHistogram.splitCount[b] - siblingHistogram.splitCount[b];
+    histogram.avgSum[b] =
+      parentHistogram.avgSum[b] - siblingHistogram.avgSum[b];
+    histogram.avgCount[b] =
+      parentHistogram.avgCount[b] - siblingHistogram.avgCount[b];
+  }
+}
+
+histogram_info* getNodeHistogram(
+    histogram_node* histograms,
+    DataFrame* trainingData,
+    size_t currentFeature
+) {
+  // Return the histogram if this node already has it, this happens when the
+  // sibling node derived it for us
+  std::map<size_t, histogram_info>::iterator found =
+    histograms->featureHistograms.find(currentFeature);
+  if (found != histograms->featureHistograms.end()) {
+    return &(found->second);
+  }
+
+  histogram_info* histogram = &(histograms->featureHistograms[currentFeature]);
+  histogram_node* parent = histograms->parent;
+  histogram_node* sibling = histograms->sibling;
+
+  std::map<size_t, histogram_info>::iterator parentFound;
+  if (parent) {
+    parentFound = parent->featureHistograms.find(currentFeature);
+  }
+
+  if (!parent || !sibling ||
+      parentFound == parent->featureHistograms.end()) {
+    buildHistogram(
+      *histogram,
+      trainingData,
+      currentFeature,
+      histograms->averagingSampleIndex,
+      histograms->splittingSampleIndex
+    );
+    return histogram;
+  }
+
+  // The parent has the histogram, so only the smaller of the two children
+  // has to be binned directly and the other one is the difference
+  size_t nodeSize = histograms->averagingSampleIndex->size() +
+    histograms->splittingSampleIndex->size();
+  size_t siblingSize = sibling->averagingSampleIndex->size() +
+    sibling->splittingSampleIndex->size();
+
+  std::map<size_t, histogram_info>::iterator siblingFound =
+    sibling->featureHistograms.find(currentFeature);
+
+  if (siblingFound == sibling->featureHistograms.end() &&
+      nodeSize <= siblingSize) {
+    buildHistogram(
+      *histogram,
+      trainingData,
+      currentFeature,
+      histograms->averagingSampleIndex,
+      histograms->splittingSampleIndex
+    );
+    subtractHistogram(
+      sibling->featureHistograms[currentFeature],
+      parentFound->second,
+      *histogram
+    );
+  } else {
+    if (siblingFound == sibling->featureHistograms.end()) {
+      buildHistogram(
+        sibling->featureHistograms[currentFeature],
+        trainingData,
+        currentFeature,
+        sibling->averagingSampleIndex,
+        sibling->splittingSampleIndex
+      );
+    }
+    subtractHistogram(
+      *histogram,
+      parentFound->second,
+      sibling->featureHistograms[currentFeature]
+    );
+  }
+  return histogram;
+}
+
+template <bool monotone, bool splitMiddle>
+void findBestSplitValueHistogramKernel(
+    std::vector<size_t>* averagingSampleIndex,
+    std::vector<size_t>* splittingSampleIndex,
+    size_t bestSplitTableIndex,
+    size_t currentFeature,
+    double* bestSplitLossAll,
+    double* bestSplitValueAll,
+    size_t* bestSplitFeatureAll,
+    size_t* bestSplitCountAll,
+    DataFrame* trainingData,
+    size_t splitNodeSize,
+    size_t averageNodeSize,
+    std::mt19937_64& random_number_generator,
+    size_t maxObs,
+    monotonic_info &monotone_details,
+    histogram_node* histograms,
+    objectArena< presort_counts >* presortArena
+) {
+
+  // Features which could not be binned are split exactly
+  if ((*trainingData).getHistogramBinLower(currentFeature)->size() == 0) {
+    findBestSplitValueNonCategoricalKernel<monotone, splitMiddle>(
+      averagingSampleIndex,
+      splittingSampleIndex,
+      nullptr,
+      nullptr,
+      bestSplitTableIndex,
+      currentFeature,
+      bestSplitLossAll,
+      bestSplitValueAll,
+      bestSplitFeatureAll,
+      bestSplitCountAll,
+      trainingData,
+      splitNodeSize,
+      averageNodeSize,
+      random_number_generator,
+      maxObs,
+      monotone_details,
+      presortArena
+    );
+    return;
+  }
+
+  histogram_info* histogram = getNodeHistogram(
+    histograms,
+    trainingData,
+    currentFeature
+  );
+  std::vector<double>* binLower =
+    (*trainingData).getHistogramBinLower(currentFeature);
+  std::vector<double>* binUpper =
+    (*trainingData).getHistogramBinUpper(currentFeature);
+  size_t numBins = binLower->size();
+
+  size_t splitTotalCount = (*splittingSampleIndex).size();
+  size_t averageTotalCount = (*averagingSampleIndex).size();
+  double splitTotalSum = 0;
+  double avgTotalSum = 0;
+  for (size_t b = 0; b < numBins; b++) {
+    splitTotalSum += histogram->splitSum[b];
+    avgTotalSum += histogram->avgSum[b];
+  }
+
+  size_t splitLeftPartitionCount = 0;
+  size_t averageLeftPartitionCount = 0;
+  double splitLeftPartitionRunningSum = 0;
+  double avgLeftPartitionRunningSum = 0;
+
+  // Candidate splits lie between two consecutive bins which are not empty in
+  // the node, in the same way as the exact split considers consecutive
+  // distinct feature values
+  size_t previousBin = numBins;
+  for (size_t b = 0; b < numBins; b++) {
+    if (histogram->splitCount[b] == 0 && histogram->avgCount[b] == 0) {
+      continue;
+    }
+
+    if (previousBin != numBins) {
+      double featureValue = (*binUpper)[previousBin];
+      double newFeatureValue = (*binLower)[b];
+
+      bool feasibleSplit = true;
+
+      // Check leaf size at least nodesize
+      if (
+          std::min(
+            splitLeftPartitionCount,
+            splitTotalCount - splitLeftPartitionCount
+          ) < splitNodeSize ||
+            std::min(
+              averageLeftPartitionCount,
+              averageTotalCount - averageLeftPartitionCount
+            ) < averageNodeSize
+      ) {
+        feasibleSplit = false;
+      }
+
+      // If we are using monotonic constraints, we need to work out whether
+      // the monotone constraints will reject a split
+      if (monotone && feasibleSplit) {
+        bool keepMonotoneSplit = acceptMonotoneSplit(monotone_details,
+                                                     currentFeature,
+                                                     splitLeftPartitionRunningSum / splitLeftPartitionCount,
+                                                     (splitTotalSum - splitLeftPartitionRunningSum)
+                                                       / (splitTotalCount - splitLeftPartitionCount));
+
+        bool avgKeepMonotoneSplit = true;
+        // If monotoneAvg, we also need to check the monotonicity of the avg set
+        if (monotone_details.monotoneAvg) {
+          avgKeepMonotoneSplit = acceptMonotoneSplit(monotone_details,
+                                                     currentFeature,
+                                                     avgLeftPartitionRunningSum / averageLeftPartitionCount,
+                                                     (avgTotalSum - avgLeftPartitionRunningSum)
+                                                       / (averageTotalCount - averageLeftPartitionCount));
+        }
+
+        feasibleSplit = keepMonotoneSplit && avgKeepMonotoneSplit;
+      }
+
+      if (feasibleSplit) {
+        // Calculate the variance of the splitting
+        double currentSplitLoss = calcMuBarVar(
+          splitLeftPartitionRunningSum,
+          splitLeftPartitionCount,
+          splitTotalSum,
+          splitTotalCount);
+
+        double currentSplitValue = drawSplitValue<splitMiddle>(
+          featureValue,
+          newFeatureValue,
+          random_number_generator
+        );
+
+        updateBestSplit(
+          bestSplitLossAll,
+          bestSplitValueAll,
+          bestSplitFeatureAll,
+          bestSplitCountAll,
+          currentSplitLoss,
+          currentSplitValue,
+          currentFeature,
+          bestSplitTableIndex,
+          random_number_generator
+        );
+      }
+    }
+
+    splitLeftPartitionCount += histogram->splitCount[b];
+    splitLeftPartitionRunningSum += histogram->splitSum[b];
+    averageLeftPartitionCount += histogram->avgCount[b];
+    avgLeftPartitionRunningSum += histogram->avgSum[b];
+    previousBin = b;
+  }
+}
+
+template <bool monotone, bool splitMiddle>
+void findBestSplitImputeKernel(
     std::vector<size_t>* averagingSampleIndex,
     std::vector<size_t>* splittingSampleIndex,
     size_t bestSplitTableIndex,
@@ -1252,10 +1910,8 @@ void findBestSplitImpute(
     size_t splitNodeSize,
     size_t averageNodeSize,
     std::mt19937_64& random_number_generator,
-    bool splitMiddle,
     size_t maxObs,
-    bool monotone_splits,
-    monotonic_info monotone_details
+    monotonic_info &monotone_details
 ) {
 
   // Create specific vectors to holddata
@@ -1473,23 +2129,11 @@ void findBestSplitImpute(
       continue;
     }
 
-    double currentSplitValue;
-    if (splitMiddle) {
-      currentSplitValue = (newFeatureValue + featureValue) / 2.0;
-    } else {
-      std::uniform_real_distribution<double> unif_dist;
-      double tmp_random = unif_dist(random_number_generator) *
-        (newFeatureValue - featureValue);
-      double epsilon_lower = std::nextafter(featureValue, newFeatureValue);
-      double epsilon_upper = std::nextafter(newFeatureValue, featureValue);
-      currentSplitValue = tmp_random + featureValue;
-      if (currentSplitValue > epsilon_upper) {
-        currentSplitValue = epsilon_upper;
-      }
-      if (currentSplitValue < epsilon_lower) {
-        currentSplitValue = epsilon_lower;
-      }
-    }
+    double currentSplitValue = drawSplitValue<splitMiddle>(
+      featureValue,
+      newFeatureValue,
+      random_number_generator
+    );
 
     // For monotonicity with missing data, we need to to check both left and right
     // handling of NA's respects monotonicity
@@ -1498,7 +2142,7 @@ void findBestSplitImpute(
     bool keepMonotoneSplitLeft = true;
     bool keepMonotoneSplitRight = true;
 
-    if (monotone_splits) {
+    if (monotone) {
       // First check left
       keepMonotoneSplitLeft =
         acceptMonotoneSplit(monotone_details,
@@ -1590,6 +2234,161 @@ void findBestSplitImpute(
   }
 }
 
+void findBestSplitValueNonCategorical(
+    std::vector<size_t>* averagingSampleIndex,
+    std::vector<size_t>* splittingSampleIndex,
+    const sample_counts* averagingCounts,
+    const sample_counts* splittingCounts,
+    size_t bestSplitTableIndex,
+    size_t currentFeature,
+    double* bestSplitLossAll,
+    double* bestSplitValueAll,
+    size_t* bestSplitFeatureAll,
+    size_t* bestSplitCountAll,
+    DataFrame* trainingData,
+    size_t splitNodeSize,
+    size_t averageNodeSize,
+    std::mt19937_64& random_number_generator,
+    bool splitMiddle,
+    size_t maxObs,
+    bool monotone_splits,
+    monotonic_info &monotone_details,
+    objectArena< presort_counts >* presortArena
+) {
+  typedef void (*kernel)(
+      std::vector<size_t>*, std::vector<size_t>*, const sample_counts*,
+      const sample_counts*, size_t, size_t, double*, double*, size_t*,
+      size_t*, DataFrame*, size_t, size_t, std::mt19937_64&, size_t,
+      monotonic_info&, objectArena< presort_counts >*
+  );
+  static const kernel kernels[2][2] = {
+    {findBestSplitValueNonCategoricalKernel<false, false>,
+     findBestSplitValueNonCategoricalKernel<false, true>},
+    {findBestSplitValueNonCategoricalKernel<true, false>,
+     findBestSplitValueNonCategoricalKernel<true, true>}
+  };
+  kernels[monotone_splits][splitMiddle](
+    averagingSampleIndex,
+    splittingSampleIndex,
+    averagingCounts,
+    splittingCounts,
+    bestSplitTableIndex,
+    currentFeature,
+    bestSplitLossAll,
+    bestSplitValueAll,
+    bestSplitFeatureAll,
+    bestSplitCountAll,
+    trainingData,
+    splitNodeSize,
+    averageNodeSize,
+    random_number_generator,
+    maxObs,
+    monotone_details,
+    presortArena
+  );
+}
+
+void findBestSplitValueHistogram(
+    std::vector<size_t>* averagingSampleIndex,
+    std::vector<size_t>* splittingSampleIndex,
+    size_t bestSplitTableIndex,
+    size_t currentFeature,
+    double* bestSplitLossAll,
+    double* bestSplitValueAll,
+    size_t* bestSplitFeatureAll,
+    size_t* bestSplitCountAll,
+    DataFrame* trainingData,
+    size_t splitNodeSize,
+    size_t averageNodeSize,
+    std::mt19937_64& random_number_generator,
+    bool splitMiddle,
+    size_t maxObs,
+    bool monotone_splits,
+    monotonic_info &monotone_details,
+    histogram_node* histograms,
+    objectArena< presort_counts >* presortArena
+) {
+  typedef void (*kernel)(
+      std::vector<size_t>*, std::vector<size_t>*, size_t, size_t, double*,
+      double*, size_t*, size_t*, DataFrame*, size_t, size_t,
+      std::mt19937_64&, size_t, monotonic_info&, histogram_node*,
+      objectArena< presort_counts >*
+  );
+  static const kernel kernels[2][2] = {
+    {findBestSplitValueHistogramKernel<false, false>,
+     findBestSplitValueHistogramKernel<false, true>},
+    {findBestSplitValueHistogramKernel<true, false>,
+     findBestSplitValueHistogramKernel<true, true>}
+  };
+  kernels[monotone_splits][splitMiddle](
+    averagingSampleIndex,
+    splittingSampleIndex,
+    bestSplitTableIndex,
+    currentFeature,
+    bestSplitLossAll,
+    bestSplitValueAll,
+    bestSplitFeatureAll,
+    bestSplitCountAll,
+    trainingData,
+    splitNodeSize,
+    averageNodeSize,
+    random_number_generator,
+    maxObs,
+    monotone_details,
+    histograms,
+    presortArena
+  );
+}
+
+void findBestSplitImpute(
+    std::vector<size_t>* averagingSampleIndex,
+    std::vector<size_t>* splittingSampleIndex,
+    size_t bestSplitTableIndex,
+    size_t currentFeature,
+    double* bestSplitLossAll,
+    double* bestSplitValueAll,
+    size_t* bestSplitFeatureAll,
+    size_t* bestSplitCountAll,
+    int* bestSplitNaDirectionAll,
+    DataFrame* trainingData,
+    size_t splitNodeSize,
+    size_t averageNodeSize,
+    std::mt19937_64& random_number_generator,
+    bool splitMiddle,
+    size_t maxObs,
+    bool monotone_splits,
+    monotonic_info &monotone_details
+) {
+  typedef void (*kernel)(
+      std::vector<size_t>*, std::vector<size_t>*, size_t, size_t, double*,
+      double*, size_t*, size_t*, int*, DataFrame*, size_t, size_t,
+      std::mt19937_64&, size_t, monotonic_info&
+  );
+  static const kernel kernels[2][2] = {
+    {findBestSplitImputeKernel<false, false>,
+     findBestSplitImputeKernel<false, true>},
+    {findBestSplitImputeKernel<true, false>,
+     findBestSplitImputeKernel<true, true>}
+  };
+  kernels[monotone_splits][splitMiddle](
+    averagingSampleIndex,
+    splittingSampleIndex,
+    bestSplitTableIndex,
+    currentFeature,
+    bestSplitLossAll,
+    bestSplitValueAll,
+    bestSplitFeatureAll,
+    bestSplitCountAll,
+    bestSplitNaDirectionAll,
+    trainingData,
+    splitNodeSize,
+    averageNodeSize,
+    random_number_generator,
+    maxObs,
+    monotone_details
+  );
+}
+
 void findBestSplitImputeCategorical(
     std::vector<size_t>* averagingSampleIndex,
     std::vector<size_t>* splittingSampleIndex,
@@ -1850,7 +2649,7 @@ bool acceptMonotoneSplit(
 ) {
   // If we have the uncle mean equal to infinity, then we enforce a simple
   // monotone split without worrying about the uncle bounds
-  int monotone_direction = monotone_details.monotonic_constraints[currentFeature];
+  int monotone_direction = (*monotone_details.monotonic_constraints)[currentFeature];
   double upper_bound = monotone_details.upper_bound;
   double lower_bound = monotone_details.lower_bound;
 
@@ -77,13 +77,15 @@ void updateSkArmadillo(
         bool left
 );
 
-double computeRSSArmadillo(
-        arma::Mat<double>& A_r,
-        arma::Mat<double>& A_l,
-        arma::Mat<double>& S_r,
-        arma::Mat<double>& S_l,
-        arma::Mat<double>& G_r,
-        arma::Mat<double>& G_l
+// Returns the sum of the residual sums of squares of the ridge fits on both
+// sides of a split, up to a constant, from the coefficients of both sides and
+// the S_k vectors they were solved for
+double computeRidgeSplitLoss(
+        const arma::Mat<double>& beta_r,
+        const arma::Mat<double>& beta_l,
+        const arma::Mat<double>& S_r,
+        const arma::Mat<double>& S_l,
+        double overfitPenalty
 );
 
 void updateRSSComponents(
@@ -93,10 +95,7 @@ void updateRSSComponents(
         arma::Mat<double>& aRight,
         arma::Mat<double>& sLeft,
         arma::Mat<double>& sRight,
-        arma::Mat<double>& gLeft,
-        arma::Mat<double>& gRight,
-        arma::Mat<double>& crossingObservation,
-        arma::Mat<double>& obOuter
+        arma::Mat<double>& crossingObservation
 );
 
 void initializeRSSComponents(
@@ -121,6 +120,40 @@ double calcMuBarVar(
         double totalSum, size_t totalCount
 );
 
+// Calculates calcMuBarVar for numCandidates splits at once. The counts of the
+// left partitions are passed as doubles so the whole computation runs over
+// contiguous double arrays.
+void calcMuBarVarBatch(
+        const double* leftSums,
+        const double* leftCounts,
+        size_t numCandidates,
+        double totalSum,
+        double totalCount,
+        double* losses
+);
+
+// Fills prefixSums with the numValues + 1 running sums of values, so that
+// prefixSums[j] holds the sum of the first j values
+void calculatePrefixSums(
+        const double* values,
+        size_t numValues,
+        double* prefixSums
+);
+
+// Fills table with the categories of currentFeature in the node in increasing
+// order, their numbers of splitting and averaging observations and the sums of
+// the outcomes of their splitting observations. With counts the rows are
+// counted as often as they were drawn.
+void buildCategoryTable(
+        category_table &table,
+        DataFrame* trainingData,
+        size_t currentFeature,
+        std::vector<size_t>* averagingSampleIndex,
+        std::vector<size_t>* splittingSampleIndex,
+        const sample_counts* averagingCounts,
+        const sample_counts* splittingCounts
+);
+
 void findBestSplitRidgeCategorical(
         std::vector<size_t>* averagingSampleIndex,
         std::vector<size_t>* splittingSampleIndex,
@@ -142,6 +175,8 @@ void findBestSplitRidgeCategorical(
 void findBestSplitValueCategorical(
         std::vector<size_t>* averagingSampleIndex,
         std::vector<size_t>* splittingSampleIndex,
+        const sample_counts* averagingCounts,
+        const sample_counts* splittingCounts,
         size_t bestSplitTableIndex,
         size_t currentFeature,
         double* bestSplitLossAll,
@@ -176,6 +211,48 @@ void findBestSplitRidge(
 );
 
 void findBestSplitValueNonCategorical(
+        std::vector<size_t>* averagingSampleIndex,
+        std::vector<size_t>* splittingSampleIndex,
+        const sample_counts* averagingCounts,
+        const sample_counts* splittingCounts,
+        size_t bestSplitTableIndex,
+        size_t currentFeature,
+        double* bestSplitLossAll,
+        double* bestSplitValueAll,
+        size_t* bestSplitFeatureAll,
+        size_t* bestSplitCountAll,
+        DataFrame* trainingData,
+        size_t splitNodeSize,
+        size_t averageNodeSize,
+        std::mt19937_64& random_number_generator,
+        bool splitMiddle,
+        size_t maxObs,
+        bool monotone_splits,
+        monotonic_info &monotone_details,
+        objectArena< presort_counts >* presortArena
+);
+
+void buildHistogram(
+        histogram_info &histogram,
+        DataFrame* trainingData,
+        size_t currentFeature,
+        std::vector<size_t>* averagingSampleIndex,
+        std::vector<size_t>* splittingSampleIndex
+);
+
+void subtractHistogram(
+        histogram_info &histogram,
+        const histogram_info &parentHistogram,
+        const histogram_info &siblingHistogram
+);
+
+histogram_info* getNodeHistogram(
+        histogram_node* histograms,
+        DataFrame* trainingData,
+        size_t currentFeature
+);
+
+void findBestSplitValueHistogram(
         std::vector<size_t>* averagingSampleIndex,
         std::vector<size_t>* splittingSampleIndex,
         size_t bestSplitTableIndex,
@@ -191,7 +268,9 @@ void findBestSplitValueNonCategorical(
         bool splitMiddle,
         size_t maxObs,
         bool monotone_splits,
-        monotonic_info monotone_details
+        monotonic_info &monotone_details,
+        histogram_node* histograms,
+        objectArena< presort_counts >* presortArena
 );
 
 void findBestSplitImpute(
@@ -211,7 +290,7 @@ void findBestSplitImpute(
         bool splitMiddle,
         size_t maxObs,
         bool monotone_splits,
-        monotonic_info monotone_details
+        monotonic_info &monotone_details
 );
 
 void findBestSplitImputeCategorical(
@@ -66,3 +66,53 @@ double square(
   return (x*x);
 }
 
+arma::Mat<double> solveRidgeSystem(
+    const arma::Mat<double> &penalizedGram,
+    const arma::Mat<double> &rhs
+) {
+  arma::Mat<double> upper;
+  if (arma::chol(upper, penalizedGram)) {
+    arma::Mat<double> lowerSolution =
+      arma::solve(arma::trimatl(upper.t()), rhs);
+    return arma::solve(arma::trimatu(upper), lowerSolution);
+  }
+  // Without a penalty the Gram matrix of too few observations is singular
+  return penalizedGram.i() * rhs;
+}
+
+
+const size_t comembership_info::NO_LEAF;
+
+void compress_weight_rows(
+    std::vector< std::vector<size_t> > &rowColumns,
+    std::vector< std::vector<double> > &rowValues,
+    size_t numColumns,
+    sparse_weight_matrix &weightMatrix
+) {
+  size_t numEntries = 0;
+  for (size_t i = 0; i < rowColumns.size(); i++) {
+    numEntries += rowColumns[i].size();
+  }
+
+  weightMatrix.numRows = rowColumns.size();
+  weightMatrix.numColumns = numColumns;
+  weightMatrix.rowPointers.clear();
+  weightMatrix.rowPointers.reserve(rowColumns.size() + 1);
+  weightMatrix.columnIndices.clear();
+  weightMatrix.columnIndices.reserve(numEntries);
+  weightMatrix.values.clear();
+  weightMatrix.values.reserve(numEntries);
+
+  for (size_t i = 0; i < rowColumns.size(); i++) {
+    weightMatrix.rowPointers.push_back(weightMatrix.columnIndices.size());
+    weightMatrix.columnIndices.insert(weightMatrix.columnIndices.end(),
+                                      rowColumns[i].begin(),
+                                      rowColumns[i].end());
+    weightMatrix.values.insert(weightMatrix.values.end(),
+                               rowValues[i].begin(),
+                               rowValues[i].end());
+    std::vector<size_t>().swap(rowColumns[i]);
+    std::vector<double>().swap(rowValues[i]);
+  }
+  weightMatrix.rowPointers.push_back(weightMatrix.columnIndices.size());
+}
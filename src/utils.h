@@ -2,12 +2,15 @@
 #define FORESTRYCPP_UTILS_H
 
 #include "DataFrame.h"
+#include <armadillo>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <random>
 #include <algorithm>
 #include <cmath>
+#include <map>
+#include <functional>
 
 void print_vector(
   std::vector<size_t> v
@@ -29,11 +32,19 @@ double square(
     double x
 );
 
+// Solves the ridge system penalizedGram * coefficients = rhs. The penalized
+// Gram matrix is symmetric, so the system is solved with its Cholesky factor
+// whenever it is positive definite, and with its inverse otherwise.
+arma::Mat<double> solveRidgeSystem(
+    const arma::Mat<double> &penalizedGram,
+    const arma::Mat<double> &rhs
+);
+
 struct tree_info {
   std::vector< int > var_id;
   // contains the variable id for a splitting node and the negative number of
   // observations in a leaf for a leaf node
-  std::vector< long double > split_val;
+  std::vector< double > split_val;
   // contains the split values for regular nodes
   std::vector< double > values;
   // contains the weights used for prediction in each node
@@ -61,13 +72,152 @@ struct tree_info {
   // exact = TRUE as we must aggregate the trees in the right order)
 };
 
+// Read only view of the arrays of a tree_info. The arrays belong either to the
+// R list of a saved forest or to a memory mapped binary forest file, so a tree
+// can be reconstructed from both without copying them first.
+struct tree_info_view {
+  const int* var_id;
+  size_t numVarIds;
+  const double* split_val;
+  const int* naLeftCount;
+  const int* naRightCount;
+  const int* naDefaultDirection;
+  // split_val and the NA arrays all hold numSplitVals entries
+  size_t numSplitVals;
+  const double* values;
+  size_t numValues;
+  const int* averagingSampleIndex;
+  size_t numAveraging;
+  const int* splittingSampleIndex;
+  size_t numSplitting;
+  // the sample indices are one based as in tree_info
+  unsigned int seed;
+};
+
+// Contains a flattened copy of a trained tree which is used for prediction.
+// The nodes are stored in depth first order, so the left child of a split node
+// is the next node and only the position of the right child is kept. The first
+// three arrays are all that is read while no missing values are encountered.
+struct node_table {
+  std::vector< int > splitFeature;
+  // contains the split feature for split nodes and -1 for leaf nodes
+  std::vector< double > splitValue;
+  // contains the split value for split nodes and the prediction weight for
+  // leaf nodes
+  std::vector< size_t > rightChild;
+  // contains the position of the right child for split nodes
+  std::vector< char > categoricalSplit;
+  // indicates if the split feature is categorical
+  std::vector< int > naDefaultDirection;
+  // contains the default direction for NA values when naDirection == TRUE
+  std::vector< size_t > naLeftCount;
+  std::vector< size_t > naRightCount;
+  // contain the counts of NA's which fell to the left and right when splitting
+  std::vector< size_t > averageCount;
+  // contains the number of averaging observations in the leaves below a node
+  std::vector< size_t > nodeId;
+  // contains the node id of leaf nodes
+};
+
+// Contains the leaf co-membership of the observations predicted by one tree,
+// from which the weight matrix is built
+struct comembership_info {
+  std::vector< size_t > leafOfRow;
+  // contains for each row of the weight matrix the position of its leaf in
+  // leafTrainRows, or NO_LEAF if the tree did not predict that row
+  std::vector< std::vector<size_t> > leafTrainRows;
+  // contains the (zero based) averaging observations which reached each leaf,
+  // an observation drawn several times appears several times
+
+  static const size_t NO_LEAF = (size_t) -1;
+};
+
+// Contains the leaves a batch of observations reaches in every tree, from
+// which the predictions of the batch can be aggregated again without routing
+// the observations through the trees
+struct leaf_assignment {
+  arma::Mat<int> terminalNodes;
+  // contains the node id of the leaf of each observation (row) in each tree
+  // (column), followed by a row with the number of nodes of each tree
+  std::vector< comembership_info > treeComembership;
+  // contains the leaf co-membership of each tree when the weight matrix is
+  // kept, and is empty otherwise
+};
+
+// Contains the scratch space a thread reuses for the OOB predictions of all the
+// trees it is handed, so no buffers of the size of the training data are
+// allocated per tree
+struct oob_scratch {
+  std::vector< char > inBag;
+  // marks the training rows in the bag of the current tree, or their groups
+  // when the training data has groups, and is all zero between trees
+  std::vector< size_t > OOBIndex;
+  // contains the positions of the OOB observations of the current tree in the
+  // predicted data
+  std::vector< double > OOBPrediction;
+  // contains the predictions of the current tree for these observations
+  std::vector< std::vector<double> > OOBFeatures;
+  // contains the feature values of these observations by column
+};
+
+// Contains the best split found so far for each feature sampled at a node
+struct feature_splits {
+  std::vector< double > loss;
+  std::vector< double > value;
+  std::vector< size_t > feature;
+  std::vector< size_t > count;
+  // contains how often the best loss has been seen, to break ties uniformly
+  std::vector< int > naDirection;
+  // contains the default direction of missing values of the best split
+};
+
+// Counts how often each training row appears in the splitting and averaging
+// samples of a node, for the split search over the presorted row order. Both
+// are all zero between nodes, so they are only filled once per tree
+struct presort_counts {
+  std::vector< unsigned int > split;
+  std::vector< unsigned int > avg;
+};
+
+// Receives one row of the weight matrix as the (zero based) columns of its
+// nonzero entries in increasing order and their weights. Different rows can be
+// handed over at the same time from different threads.
+typedef std::function<void(
+    size_t,
+    const std::vector<size_t>&,
+    const std::vector<double>&
+)> weight_row_consumer;
+
+// Contains a weight matrix in compressed sparse row format
+struct sparse_weight_matrix {
+  std::vector< size_t > rowPointers;
+  // contains the position of the first entry of each row, followed by the
+  // total number of entries
+  std::vector< size_t > columnIndices;
+  // contains the (zero based) column of each entry
+  std::vector< double > values;
+  // contains the weight of each entry
+  size_t numRows;
+  size_t numColumns;
+};
+
+// Moves rows collected through a weight_row_consumer into a compressed sparse
+// row matrix, releasing each row once it has been copied
+void compress_weight_rows(
+    std::vector< std::vector<size_t> > &rowColumns,
+    std::vector< std::vector<double> > &rowValues,
+    size_t numColumns,
+    sparse_weight_matrix &weightMatrix
+);
+
 // Contains the information to help with monotonic constraints on splitting
 struct monotonic_info {
-  // Contains the monotonic constraints on each variable
+  // Points to the monotonic constraints on each variable, which belong to the
+  // training data and are shared by all the nodes
   // For each continuous variable, we have +1 indicating a positive monotone
   // relationship, -1 indicating a negative monotone relationship, and 0
   // indicates no monotonic relationship
-  std::vector<int> monotonic_constraints;
+  const std::vector<int>* monotonic_constraints;
 
   // These contain the upper and lower bounds on node means for the node
   // currently being split on. These are used to reject potential splits
@@ -81,8 +231,58 @@ struct monotonic_info {
   bool monotoneAvg;
 
   monotonic_info(){
+    monotonic_constraints = nullptr;
     monotoneAvg = false;
   };
 };
 
+// Contains the per bin sufficient statistics of one feature in a node, used
+// when growing trees with histogram splits
+struct histogram_info {
+  // Sum of the outcomes and number of splitting observations in each bin
+  std::vector<double> splitSum;
+  std::vector<size_t> splitCount;
+
+  // Sum of the outcomes and number of averaging observations in each bin
+  std::vector<double> avgSum;
+  std::vector<size_t> avgCount;
+};
+
+// Contains the counts and outcome sums of the categories of a categorical
+// feature in a node, which are gathered in one pass so the split search does
+// not have to look the categories up once per observation
+struct category_table {
+  std::vector<double> category;
+  // contains the categories in increasing order
+  std::vector<size_t> splitCount;
+  std::vector<size_t> avgCount;
+  // contain the numbers of splitting and averaging observations of each
+  // category
+  std::vector<double> splitSum;
+  // contains the sum of the outcomes of the splitting observations of each
+  // category
+  std::vector<size_t> splitSamples;
+  // contains the splitting observations grouped by category in the order of
+  // the categories, and in the order of the node within a category
+};
+
+// Contains the histograms which have been computed for a node so far. The
+// parent and sibling links let a child derive the histogram of a feature as
+// the parent histogram minus the sibling histogram, so that only the smaller
+// of the two children has to be binned directly.
+struct histogram_node {
+  std::map<size_t, histogram_info> featureHistograms;
+  histogram_node* parent;
+  histogram_node* sibling;
+  std::vector<size_t>* averagingSampleIndex;
+  std::vector<size_t>* splittingSampleIndex;
+
+  histogram_node(){
+    parent = nullptr;
+    sibling = nullptr;
+    averagingSampleIndex = nullptr;
+    splittingSampleIndex = nullptr;
+  };
+};
+
 #endif //FORESTRYCPP_UTILS_H